@@ -36,16 +36,25 @@ private:
   std::vector<uint8_t> data;
   std::vector<uint16_t> offsets;
   size_t capacity;
+  // 零拷贝解码时数据段直接引用外部内存(如 mmap 区域), 此时 data 为空
+  const uint8_t *view_ = nullptr;
+  size_t view_size_ = 0;
+  // 持有外部内存的所有者, 保证 block 存活期间 view_ 有效
+  std::shared_ptr<const void> view_owner_;
+
+  const uint8_t *data_ptr() const {
+    return view_ != nullptr ? view_ : data.data();
+  }
+  size_t data_size() const {
+    return view_ != nullptr ? view_size_ : data.size();
+  }
+  // 校验编码并解析偏移数组, 返回数据段的长度
+  static size_t decode_offsets(const uint8_t *encoded, size_t size,
+                               bool with_hash, Block &block);
 
-  struct Entry {
-    std::string key;
-    std::string value;
-    uint64_t tranc_id;
-  };
-  Entry get_entry_at(size_t offset) const;
   std::string get_key_at(size_t offset) const;
   std::string get_value_at(size_t offset) const;
-  uint16_t get_tranc_id_at(size_t offset) const;
+  uint64_t get_tranc_id_at(size_t offset) const;
   int compare_key_at(size_t offset, const std::string &target) const;
 
   // 根据id的可见性调整位置
@@ -54,6 +63,12 @@ private:
   bool is_same_key(size_t idx, const std::string &target_key) const;
 
 public:
+  struct Entry {
+    std::string key;
+    std::string value;
+    uint64_t tranc_id;
+  };
+
   Block() = default;
   Block(size_t capacity);
   // ! 这里的编码函数不包括 hash
@@ -61,8 +76,18 @@ public:
   // ! 这里的解码函数可指定切片是否包括 hash
   static std::shared_ptr<Block> decode(const std::vector<uint8_t> &encoded,
                                        bool with_hash = false);
+  // 接管 encoded 的内存作为数据段, 不再复制
+  static std::shared_ptr<Block> decode(std::vector<uint8_t> &&encoded,
+                                       bool with_hash = false);
+  // 数据段直接引用 [encoded, encoded + size), 不复制,
+  // owner 需要保证这段内存在 block 销毁之前有效
+  static std::shared_ptr<Block> decode_view(const uint8_t *encoded,
+                                            size_t size, bool with_hash,
+                                            std::shared_ptr<const void> owner);
   std::string get_first_key();
   size_t get_offset_at(size_t idx) const;
+  // 读取偏移量处的完整 entry, 不做事务可见性过滤
+  Entry get_entry_at(size_t offset) const;
   bool add_entry(const std::string &key, const std::string &value,
                  uint64_t tranc_id, bool force_write);
   std::optional<std::string> get_value_binary(const std::string &key,
@@ -70,6 +95,8 @@ public:
 
   size_t size() const;
   size_t cur_size() const;
+  // 解码后常驻内存的字节数, 视图模式引用的外部内存不计入
+  size_t memory_usage() const;
   bool is_empty() const;
   std::optional<size_t> get_idx_binary(const std::string &key,
                                        uint64_t tranc_id);
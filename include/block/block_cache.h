@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../utils/frequency_sketch.h"
 #include "block.h"
 #include <cstdint>
 #include <list>
@@ -12,21 +13,36 @@
 
 namespace toni_lsm {
 
+class SecondaryCache;
+
 // 定义缓存项
 struct CacheItem {
   int sst_id;
   int block_id;
   std::shared_ptr<Block> cache_block;
   uint64_t access_count; // 访问时间戳
+  size_t charge;         // 占用的缓存容量 (字节)
+  uint64_t file_id;      // block 所属 sst 文件的身份, 为 0 时不写入二级缓存
 };
 
+// 64 位整数的混合函数 (splitmix64 的最终化步骤), 输入的每一位都影响所有输出位
+inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
 // 自定义哈希函数
+// 直接异或两个哈希值时 (a, b) 与 (b, a) 以及 a == b 的键都会冲突, 先混合再合并
 struct pair_hash {
   template <class T1, class T2>
   std::size_t operator()(const std::pair<T1, T2> &p) const {
     auto hash1 = std::hash<T1>{}(p.first);
     auto hash2 = std::hash<T2>{}(p.second);
-    return hash1 ^ hash2;
+    return mix64(mix64(hash1) + hash2);
   }
 };
 
@@ -40,39 +56,122 @@ struct pair_equal {
 };
 
 // 定义缓存池
+// 缓存被划分为 2^shard_bits 个分片, 每个分片各自持有锁和 LRU-K 链表,
+// 由 (sst_id, block_id) 的哈希值选择分片, 不同分片上的读取互不阻塞
+// 容量按字节计算, 每个缓存项按 entry_charge 计入占用
+// 开启 TinyLFU 准入时, 缓存已满的情况下只有访问频率高于被淘汰者的 block
+// 才会被放入, 一次性扫描读取的 block 不会挤掉热点数据
+// 设置二级缓存之后, 被淘汰的 block 写入二级缓存, 由 SST 在未命中时查找
 class BlockCache {
 public:
-  BlockCache(size_t capacity, size_t k);
+  // 每个分片至少拥有的字节容量, 容量过小时自动减少分片数,
+  // 避免单个分片小到无法体现 LRU-K 的效果
+  static constexpr size_t kMinShardCapacity = 512 * 1024;
+
+  // 估计 TinyLFU 计数器数量时假定的平均缓存项大小
+  static constexpr size_t kSketchBytesPerEntry = 4096;
+
+  BlockCache(size_t capacity, size_t k, size_t shard_bits = 0,
+             bool tiny_lfu = false);
   ~BlockCache();
 
   // 获取缓存项
   std::shared_ptr<Block> get(int sst_id, int block_id);
 
-  // 插入缓存项
-  void put(int sst_id, int block_id, std::shared_ptr<Block> data);
+  // 插入缓存项, file_id 是 block 所属 sst 文件的身份, 二级缓存据此校验
+  void put(int sst_id, int block_id, std::shared_ptr<Block> data,
+           uint64_t file_id = 0);
 
   // 获取缓存命中率
   double hit_rate() const;
 
+  // 设置接收淘汰 block 的二级缓存, 需要在开始读取之前设置
+  void set_secondary_cache(std::shared_ptr<SecondaryCache> secondary) {
+    secondary_ = std::move(secondary);
+  }
+  const std::shared_ptr<SecondaryCache> &secondary_cache() const {
+    return secondary_;
+  }
+
+  // 实际使用的分片数量
+  size_t num_shards() const { return shards_.size(); }
+
+  // 是否已经缓存, 不计入命中率和访问频率
+  bool contains(int sst_id, int block_id) const;
+
+  // 最热的至多 max_entries 个缓存项的键, 用于持久化之后在重启时预热
+  // 每个分片先取访问次数达到 K 的缓存项, 再取其余的, 各自按最近访问的顺序
+  std::vector<std::pair<int, int>> hot_keys(size_t max_entries) const;
+
+  // 总容量和当前占用的字节数
+  size_t capacity() const { return capacity_; }
+  size_t usage() const;
+
+  // block 放入缓存后占用的字节数: 解码后的数据、偏移量以及缓存项自身的开销
+  static size_t entry_charge(const std::shared_ptr<Block> &block);
+
 private:
-  size_t capacity_;          // 缓存容量
-  size_t k_;                 // LRU-K 中的 K 值
-  mutable std::mutex mutex_; // 互斥锁保护缓存池
+  // 缓存键的哈希, 高位用于选择分片, 分片内的哈希表使用完整的哈希值
+  struct key_hash {
+    std::size_t operator()(const std::pair<int, int> &key) const {
+      return mix64((static_cast<uint64_t>(static_cast<uint32_t>(key.first))
+                    << 32) |
+                   static_cast<uint32_t>(key.second));
+    }
+  };
+
+  // 单个分片, 按缓存行对齐避免相邻分片的锁发生伪共享
+  struct alignas(64) Shard {
+    size_t capacity = 0;       // 分片容量 (字节)
+    size_t usage = 0;          // 已占用的字节数
+    mutable std::mutex mutex_; // 互斥锁保护分片
+
+    // 双向链表存储缓存项
+    std::list<CacheItem> cache_list_greater_k;
+    std::list<CacheItem> cache_list_less_k;
+
+    // 哈希表索引缓存项
+    std::unordered_map<std::pair<int, int>, std::list<CacheItem>::iterator,
+                       key_hash, pair_equal>
+        cache_map_;
+
+    // 记录请求数和命中数
+    size_t total_requests_ = 0;
+    size_t hit_requests_ = 0;
+
+    // 访问频率估计, 未开启 TinyLFU 时为空
+    std::unique_ptr<FrequencySketch> sketch;
+  };
+
+  size_t capacity_;           // 总容量 (字节)
+  size_t k_;                  // LRU-K 中的 K 值
+  size_t shard_mask_;         // 分片数量减一, 用于从哈希值中取出分片下标
+  std::vector<Shard> shards_; // 所有分片
+  std::shared_ptr<SecondaryCache> secondary_;
+
+  Shard &shard_for(size_t hash) {
+    // 哈希表的桶由低位决定, 分片使用高位, 两者互不相关
+    return shards_[(hash >> 32) & shard_mask_];
+  }
+  const Shard &shard_for(size_t hash) const {
+    return shards_[(hash >> 32) & shard_mask_];
+  }
 
-  // 双向链表存储缓存项
-  std::list<CacheItem> cache_list_greater_k;
-  std::list<CacheItem> cache_list_less_k;
+  // 插入或者更新缓存项, 调用方持有分片的锁
+  void put_locked(Shard &shard, const std::pair<int, int> &key, size_t hash,
+                  std::shared_ptr<Block> block, uint64_t file_id,
+                  std::vector<CacheItem> &evicted);
 
-  // 哈希表索引缓存项
-  std::unordered_map<std::pair<int, int>, std::list<CacheItem>::iterator,
-                     pair_hash, pair_equal>
-      cache_map_;
+  // 淘汰缓存项直到占用不超过 target, 调用方持有分片的锁
+  // 设置了二级缓存时被淘汰的缓存项放入 evicted, 由调用方在释放锁之后写入
+  void evict_until(Shard &shard, size_t target,
+                   std::vector<CacheItem> &evicted);
 
-  // 更新缓存项的访问时间
-  void update_access_count(std::list<CacheItem>::iterator it);
+  // TinyLFU 准入: 腾出空间需要淘汰的缓存项中, 只要有一个的访问频率
+  // 不低于新 block, 就拒绝放入; 调用方持有分片的锁
+  bool admit(Shard &shard, size_t hash, size_t charge) const;
 
-  // 记录请求数和命中数
-  mutable size_t total_requests_ = 0;
-  mutable size_t hit_requests_ = 0;
+  // 更新缓存项的访问时间, 调用方持有分片的锁
+  void update_access_count(Shard &shard, std::list<CacheItem>::iterator it);
 };
-} // namespace toni_lsm
\ No newline at end of file
+} // namespace toni_lsm
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "blockmeta.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toni_lsm {
+
+// sst 的 block 索引在内存中的紧凑表示, 由元数据块解码得到, 文件格式不变
+// 每个 block 只保存一个分隔 key, 满足 last_key_i <= sep_i < first_key_{i+1},
+// 取其中最短的一个; 最后一个 block 的分隔 key 就是 sst 的 last_key
+// 所有分隔 key 连续存放在同一块内存中, 二分查找不会访问分散的堆内存
+class BlockIndex {
+public:
+  BlockIndex() = default;
+  explicit BlockIndex(const std::vector<BlockMeta> &meta_entries);
+
+  size_t size() const { return block_offsets_.size(); }
+  bool empty() const { return block_offsets_.empty(); }
+
+  // 第 idx 个 block 在文件中的偏移量
+  size_t offset(size_t idx) const { return block_offsets_[idx]; }
+  // 第 idx 个 block 的分隔 key, 该 block 中的 key 都位于
+  // (separator(idx - 1), separator(idx)] 之间
+  std::string_view separator(size_t idx) const {
+    return std::string_view(arena_).substr(
+        key_offsets_[idx], key_offsets_[idx + 1] - key_offsets_[idx]);
+  }
+  // 第一个 block 的 first_key
+  const std::string &first_key() const { return first_key_; }
+  std::string_view last_key() const { return separator(size() - 1); }
+
+  // 第一个分隔 key >= key 的 block, 也是唯一可能包含 key 的 block
+  // key 大于 sst 的 last_key 时返回 size()
+  // 已知结果不小于 begin 时从 begin 开始查找, 用于按顺序查找多个 key
+  size_t find(std::string_view key, size_t begin = 0) const;
+
+  // 常驻内存的字节数
+  size_t memory_usage() const;
+
+  // 满足 a <= s < b 的最短的 s, 要求 a < b
+  static std::string shortest_separator(std::string_view a,
+                                        std::string_view b);
+
+private:
+  std::string first_key_;
+  std::vector<uint32_t> block_offsets_;
+  std::vector<uint32_t> key_offsets_; // 第 i 个分隔 key 位于 arena_ 中的起点
+  std::string arena_;
+};
+} // namespace toni_lsm
@@ -36,6 +36,8 @@ public:
   bool operator!=(const BlockIterator &other) const;
   value_type operator*() const;
   bool is_end();
+  // 当前记录的事务 id
+  uint64_t get_cur_tranc_id() const;
 
 private:
   void update_current() const;
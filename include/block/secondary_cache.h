@@ -0,0 +1,127 @@
+#pragma once
+
+#include "../utils/posix_file.h"
+#include "block.h"
+#include "block_cache.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace toni_lsm {
+
+// 位于本地 SSD 文件中的二级 block 缓存, 保存被 BlockCache 淘汰的 block
+// 文件按日志方式循环写入, 写到容量末尾后回到文件头部覆盖最旧的记录
+// 内存中只保存 (sst_id, block_id) 到记录位置的索引, 重启时扫描文件重建
+// 写入由后台线程完成, 淘汰 block 的读取线程只把 block 放入有界的队列
+//
+// 记录按 kAlignment 对齐, 结构如下:
+// ---------------------------------------------------------------------
+// | magic(32) | sst_id(32) | block_id(32) | size(32) | seq(64) |
+// | file_id(64) | checksum(32) | header_hash(32) | block data(size) |
+// | padding |
+// ---------------------------------------------------------------------
+// file_id 是 block 所属 sst 文件的身份, 重启后 sst_id 被复用时据此区分
+// checksum 校验 block 数据, header_hash 校验前面的字段
+class SecondaryCache {
+public:
+  static constexpr size_t kAlignment = 4096;
+  static constexpr uint32_t kMagic = 0x5343424c;
+  static constexpr size_t kHeaderSize = 40;
+  // 等待写入的 block 编码后的总字节数上限, 超过时直接丢弃新淘汰的 block
+  static constexpr size_t kMaxPendingBytes = 16 * 1024 * 1024;
+
+  // 打开或者创建缓存文件, 已有的记录在重启后仍然可以命中
+  SecondaryCache(const std::string &path, size_t capacity);
+  ~SecondaryCache();
+
+  SecondaryCache(const SecondaryCache &) = delete;
+  SecondaryCache &operator=(const SecondaryCache &) = delete;
+
+  // 放入被淘汰的 block, 由后台线程写入文件, 已经存在或者队列已满时忽略
+  void insert(int sst_id, int block_id, uint64_t file_id,
+              std::shared_ptr<Block> block);
+
+  // 查找 block, 未命中、file_id 不一致或者记录已经损坏时返回空
+  // encoded_size 不为 0 时还要求 block 编码后的长度一致
+  std::shared_ptr<Block> lookup(int sst_id, int block_id, uint64_t file_id,
+                                size_t encoded_size = 0);
+
+  // 阻塞直到队列中的 block 都已写入文件
+  void wait_for_pending();
+
+  // 丢弃所有记录以及尚未写入的 block, 并重新创建文件
+  void clear();
+
+  size_t capacity() const { return capacity_; }
+  // 有效记录占用的文件字节数
+  size_t usage() const;
+  size_t entries() const;
+  double hit_rate() const;
+  // 因为队列已满而丢弃的 block 数量
+  size_t dropped() const { return dropped_.load(); }
+
+private:
+  struct Location {
+    size_t offset;
+    size_t length; // 对齐之后的记录长度
+    uint32_t size; // block 数据长度
+    uint64_t seq;
+    uint64_t file_id;
+    bool ready; // 写入完成之前不能被读取
+  };
+
+  struct PendingWrite {
+    int sst_id;
+    int block_id;
+    uint64_t file_id;
+    std::shared_ptr<Block> block;
+    size_t size; // 计入 pending_bytes_ 的字节数
+  };
+
+  std::string path_;
+  size_t capacity_;
+  PosixFile file_;
+
+  mutable std::mutex mutex_; // 保护以下成员
+  std::unordered_map<std::pair<int, int>, Location, pair_hash, pair_equal>
+      index_;
+  std::map<size_t, std::pair<int, int>> by_offset_; // 记录起始位置 -> 键
+  size_t write_offset_ = 0;
+  uint64_t next_seq_ = 1;
+  size_t usage_ = 0;
+
+  std::atomic<size_t> total_requests_ = 0;
+  std::atomic<size_t> hit_requests_ = 0;
+  std::atomic<size_t> dropped_ = 0;
+
+  std::mutex queue_mtx_; // 保护以下写入队列的状态
+  std::condition_variable queue_cv_;
+  std::condition_variable idle_cv_;
+  std::deque<PendingWrite> queue_;
+  size_t pending_bytes_ = 0;
+  bool writing_ = false; // 后台线程正在写入从队列中取出的 block
+  bool stop_ = false;
+  std::thread writer_thread_;
+
+  // 后台线程的主循环, 停止时写完队列中剩余的 block 再退出
+  void writer_worker();
+  // 把一个 block 写入文件并登记到索引中
+  void write_record(const PendingWrite &write);
+  // 扫描文件重建索引, 写入位置接在序号最大的记录之后
+  void recover();
+  // 移除与 [offset, offset + length) 重叠的记录, 调用方持有锁
+  void evict_range_locked(size_t offset, size_t length);
+  // 移除一条记录, 返回 by_offset_ 中的下一条, 调用方持有锁
+  std::map<size_t, std::pair<int, int>>::iterator
+  erase_locked(std::map<size_t, std::pair<int, int>>::iterator it);
+};
+} // namespace toni_lsm
@@ -17,10 +17,38 @@ private:
   long long lsm_per_mem_size_limit_;
   int lsm_block_size_;
   int lsm_sst_level_ratio_;
+  int lsm_max_immutable_memtables_;
+  int lsm_compaction_threads_;
+  int lsm_max_subcompactions_;
+  int lsm_multiget_threads_;
+  int lsm_multiget_min_keys_per_task_;
+  int lsm_l0_slowdown_writes_trigger_;
+  int lsm_l0_stop_writes_trigger_;
+  long long lsm_soft_pending_compaction_bytes_;
+  long long lsm_hard_pending_compaction_bytes_;
+  long long lsm_delayed_write_rate_;
+  long long lsm_max_manifest_file_size_;
 
   // --- LSM Cache ---
-  int lsm_block_cache_capacity_;
+  long long lsm_block_cache_capacity_;
   int lsm_block_cache_k_;
+  int lsm_block_cache_shard_bits_;
+  bool lsm_block_cache_tiny_lfu_;
+  long long lsm_row_cache_capacity_;
+  long long lsm_secondary_cache_capacity_;
+  std::string lsm_secondary_cache_path_;
+  int lsm_hot_blocks_max_entries_;
+  int lsm_hot_blocks_persist_interval_;
+  int lsm_table_cache_max_open_files_;
+  long long lsm_table_cache_capacity_;
+  int lsm_pin_index_filter_max_level_;
+  bool lsm_sst_use_mmap_;
+
+  // --- LSM IO ---
+  int lsm_io_uring_queue_depth_;
+  int lsm_readahead_blocks_;
+  bool lsm_sst_use_direct_io_;
+  long long lsm_direct_io_buffer_pool_size_;
 
   // --- Redis Headers/Separators ---
   std::string redis_expire_header_;
@@ -58,9 +86,36 @@ public:
   long long getLsmPerMemSizeLimit() const;
   int getLsmBlockSize() const;
   int getLsmSstLevelRatio() const;
-
-  int getLsmBlockCacheCapacity() const;
+  int getLsmMaxImmutableMemtables() const;
+  int getLsmCompactionThreads() const;
+  int getLsmMaxSubcompactions() const;
+  int getLsmMultiGetThreads() const;
+  int getLsmMultiGetMinKeysPerTask() const;
+  int getLsmL0SlowdownWritesTrigger() const;
+  int getLsmL0StopWritesTrigger() const;
+  long long getLsmSoftPendingCompactionBytes() const;
+  long long getLsmHardPendingCompactionBytes() const;
+  long long getLsmDelayedWriteRate() const;
+  long long getLsmMaxManifestFileSize() const;
+
+  long long getLsmBlockCacheCapacity() const;
   int getLsmBlockCacheK() const;
+  int getLsmBlockCacheShardBits() const;
+  bool getLsmBlockCacheTinyLfu() const;
+  long long getLsmRowCacheCapacity() const;
+  long long getLsmSecondaryCacheCapacity() const;
+  const std::string &getLsmSecondaryCachePath() const;
+  int getLsmHotBlocksMaxEntries() const;
+  int getLsmHotBlocksPersistInterval() const;
+  int getLsmTableCacheMaxOpenFiles() const;
+  long long getLsmTableCacheCapacity() const;
+  int getLsmPinIndexFilterMaxLevel() const;
+  bool getLsmSstUseMmap() const;
+
+  int getLsmIoUringQueueDepth() const;
+  int getLsmReadaheadBlocks() const;
+  bool getLsmSstUseDirectIo() const;
+  long long getLsmDirectIoBufferPoolSize() const;
 
   const std::string &getRedisExpireHeader() const;
   const std::string &getRedisHashValuePreffix() const;
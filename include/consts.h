@@ -15,8 +15,8 @@ namespace toni_lsm {
 // #define LSM_PER_MEM_SIZE_LIMIT (1 * 1024) // 内存表的大小限制, 1KB
 // #define LSM_BLOCK_SIZE (256)               // BLOCK的大小, 1KB
 
-#define LSMmm_BLOCK_CACHE_CAPACITY 1024 // 缓存池的块缓存容量
-#define LSMmm_BLOCK_CACHE_K 8           // 缓存池的LRU-K的K值
+#define LSMmm_BLOCK_CACHE_CAPACITY (32 * 1024 * 1024) // 块缓存的字节容量
+#define LSMmm_BLOCK_CACHE_K 8                         // 缓存池的LRU-K的K值
 
 // Redis HEADER
 #define REDIS_EXPIRE_HEADER "REDIS_EXPIRE_"          // 过期时间的前缀
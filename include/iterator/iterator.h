@@ -60,7 +60,9 @@ class HeapIterator : public BaseIterator {
 
 public:
   HeapIterator() = default;
-  HeapIterator(std::vector<SearchItem> item_vec, uint64_t max_tranc_id);
+  // skip_delete 为 false 时保留删除标记, 供 compact 使用
+  HeapIterator(std::vector<SearchItem> item_vec, uint64_t max_tranc_id,
+               bool skip_delete = true);
   pointer operator->() const;
   virtual value_type operator*() const override;
   BaseIterator &operator++() override;
@@ -87,5 +89,6 @@ private:
       items;
   mutable std::shared_ptr<value_type> current; // 用于存储当前元素
   uint64_t max_tranc_id_ = 0;
+  bool skip_delete_ = true;
 };
 } // namespace toni_lsm
\ No newline at end of file
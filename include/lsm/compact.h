@@ -1,7 +1,30 @@
 #pragma once
 
+#include "../sst/sst.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace toni_lsm {
 enum class CompactType {
-  FullCompact,
+  FullCompact,    // 源 level 的 sst 全部参与, 用于 l0
+  PartialCompact, // 源 level 只挑选一个 sst
+  TrivialMove,    // 输入与下一层没有重叠, 只需重命名文件
+};
+
+// 一次 compact 任务的描述
+// 输入 sst 在调度时从 engine 中快照出来, 执行期间不需要持有 ssts_mtx
+struct CompactionTask {
+  CompactType type = CompactType::FullCompact;
+  size_t src_level = 0;
+  size_t dst_level = 1;
+  double score = 0; // 调度时 src_level 的得分, 仅用于日志
+  // dst_level 之下没有数据, 删除标记不再需要遮挡更旧的版本
+  bool bottommost = false;
+  // 调度时最老的活跃快照, tranc_id 不超过它的版本中只有最新的一个可能被读到
+  uint64_t oldest_snapshot = UINT64_MAX;
+  std::vector<std::shared_ptr<SST>> src_ssts;
+  std::vector<std::shared_ptr<SST>> dst_ssts;
 };
-}
+} // namespace toni_lsm
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../block/block.h"
+#include "../sst/sst.h"
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace toni_lsm {
+
+// compact 使用的多路归并迭代器
+// 输出输入中的所有版本: key 升序, 相同 key 按照 tranc_id 降序,
+// tranc_id 也相同时来自更新的 run 的版本在前
+// 不做去重和可见性过滤, 删除标记也会输出, 由调用方决定保留哪些版本
+class CompactIterator {
+public:
+  using Entry = Block::Entry;
+
+  // runs 按照从新到旧排列, 每个 run 内的 sst 按 key 有序且互不重叠
+  // 只输出 [start_key, end_key) 内的 key, 空值表示该侧无边界
+  CompactIterator(std::vector<std::vector<std::shared_ptr<SST>>> runs,
+                  const std::optional<std::string> &start_key = std::nullopt,
+                  const std::optional<std::string> &end_key = std::nullopt);
+
+  bool is_valid() const;
+  const Entry &operator*() const;
+  const Entry *operator->() const;
+  CompactIterator &operator++();
+
+private:
+  // 单个 run 的读取位置
+  struct RunCursor {
+    std::vector<std::shared_ptr<SST>> ssts;
+    size_t sst_idx = 0;
+    size_t block_idx = 0;
+    std::shared_ptr<Block> block;
+    // 输入按顺序读取, 批量读取之后的 block; compact 的输入只读取一次,
+    // 不放入缓存, 避免挤掉热点 block
+    BlockReadahead readahead{false};
+    size_t entry_idx = 0;
+    Entry entry;
+    bool valid = false;
+  };
+
+  void seek(RunCursor &cursor, const std::optional<std::string> &start_key);
+  // 读取当前位置的 entry, 当前 block 或 sst 读完时移动到下一个
+  void load(RunCursor &cursor);
+  // 堆顶为 key 最小、tranc_id 最大、run 最新的 cursor
+  bool heap_greater(size_t a, size_t b) const;
+
+  std::vector<RunCursor> cursors_;
+  std::vector<size_t> heap_; // cursors_ 的下标
+  std::optional<std::string> end_key_;
+};
+} // namespace toni_lsm
@@ -2,14 +2,26 @@
 
 #include "../memtable/memtable.h"
 #include "../sst/sst.h"
+#include "../utils/thread_pool.h"
 #include "compact.h"
+#include "compact_iterator.h"
+#include "manifest.h"
+#include "row_cache.h"
 #include "transaction.h"
 #include "two_merge_iterator.h"
+#include "version.h"
+#include "write_controller.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -21,11 +33,18 @@ class LSMEngine : public std::enable_shared_from_this<LSMEngine> {
 public:
   std::string data_dir;
   MemTable memtable;
+  // 以下 sst 布局只由刷盘和 compact 修改, 读者使用 current_version()
   std::map<size_t, std::deque<size_t>> level_sst_ids;
   std::unordered_map<size_t, std::shared_ptr<SST>> ssts;
   std::shared_mutex ssts_mtx;
   std::shared_ptr<BlockCache> block_cache;
-  size_t next_sst_id = 0;
+  // 按用户 key 缓存最新版本, 未开启时为空, 见 enable_row_cache
+  std::shared_ptr<RowCache> row_cache;
+  // 限制同时打开的 sst 数量, 所有 sst 都需要登记
+  std::shared_ptr<TableCache> table_cache;
+  // 开启 O_DIRECT 时 sst 读写使用的对齐缓冲区池, 未开启时为空
+  std::shared_ptr<AlignedBufferPool> direct_io_pool;
+  std::atomic<size_t> next_sst_id = 0; // 刷盘与后台 compact 会并发分配
   size_t cur_max_level = 0;
 
 public:
@@ -34,6 +53,9 @@ public:
 
   std::optional<std::pair<std::string, uint64_t>> get(const std::string &key,
                                                       uint64_t tranc_id);
+  // 返回值与 keys 一一对应, 没有找到或者被删除的键为 nullopt
+  // memtable 中没有找到的键排序后逐层查找, 每层需要的 block 一起读取
+  // 键较多时按 key 范围切分, 在 multiget_pool_ 中并行查找 sst
   std::vector<
       std::pair<std::string, std::optional<std::pair<std::string, uint64_t>>>>
   get_batch(const std::vector<std::string> &keys, uint64_t tranc_id);
@@ -41,7 +63,8 @@ public:
   std::optional<std::pair<std::string, uint64_t>>
   sst_get_(const std::string &key, uint64_t tranc_id);
 
-  // 如果触发了刷盘, 返回当前刷入sst的最大事务id
+  // 刷盘由后台线程完成, 写入不会在调用线程上构建 sst, 返回值恒为 0
+  // 冻结表数量超过 LSM_MAX_IMMUTABLE_MEMTABLES 时阻塞, 直到后台刷盘追上
   uint64_t put(const std::string &key, const std::string &value,
                uint64_t tranc_id);
 
@@ -53,31 +76,162 @@ public:
   uint64_t remove_batch(const std::vector<std::string> &keys,
                         uint64_t tranc_id);
   void clear();
+  // 同步地将最老的冻结表刷入 l0, 返回刷入sst的最大事务id
+  // l0 的 compact 交给后台线程池, 不会在这里执行
   uint64_t flush();
+  // 阻塞直到后台没有正在执行或等待执行的 compact 任务
+  void wait_for_compaction();
+  // 阻塞直到启动时的 block 缓存预热完成, 未开启预热时立即返回
+  void wait_for_warm_up();
+
+  // 写入限速的当前状态
+  WriteControllerStats get_write_stall_stats() const;
+
+  // 按给定的容量开启行缓存, 替换配置中的 LSM_ROW_CACHE_CAPACITY
+  // 需要在读写开始之前调用
+  void enable_row_cache(size_t capacity);
+
+  // 设置查询最老的活跃快照的函数, compact 只回收对所有快照都不可见的版本
+  // 未设置时认为没有活跃的快照, 每个 key 只保留最新的版本
+  void set_oldest_snapshot_provider(std::function<uint64_t()> provider);
 
   std::string get_sst_path(size_t sst_id, size_t target_level);
+  // 二级 block 缓存文件的路径, 未配置时位于数据目录中
+  std::string get_secondary_cache_path() const;
+  // 持久化的热点 block 列表的路径
+  std::string get_hot_blocks_path() const;
 
   std::optional<std::pair<TwoMergeIterator, TwoMergeIterator>>
   lsm_iters_monotony_predicate(
       uint64_t tranc_id, std::function<int(const std::string &)> predicate);
 
-  Level_Iterator begin(uint64_t tranc_id);
+  // fill_cache 为 false 时扫描读取的 block 不放入缓存, 用于导出等大范围扫描
+  Level_Iterator begin(uint64_t tranc_id, bool fill_cache = true);
   Level_Iterator end();
 
+  // 当前发布的 sst 布局, 只需一次原子读取, 不会被刷盘和 compact 阻塞
+  // 查询时需要在读取 memtable 之后获取, 否则可能错过刚刷盘的冻结表
+  std::shared_ptr<const Version> current_version() const;
+
   static size_t get_sst_size(size_t level);
 
 private:
-  void full_compact(size_t src_level);
+  // 后台线程: 启动时预热 block 缓存, 之后定期持久化热点 block 列表
+  void hot_blocks_worker();
+  // 按照持久化的列表预读 block, 同一个 sst 中的 block 合并成顺序读取
+  void warm_up_block_cache();
+  // 保存 BlockCache 中最热的 block 的键
+  void persist_hot_blocks();
+
+  // 按从新到旧的顺序在 version 的 sst 中查找 pending 中的键 (已按 key 排序)
+  // 查到的值写入 results 的对应位置, 记录自身的事务 id 写入 found_tranc_ids
+  void multi_get_from_ssts(
+      const Version &version, const std::vector<std::string> &keys,
+      std::vector<size_t> pending, uint64_t tranc_id,
+      std::vector<std::pair<std::string,
+                            std::optional<std::pair<std::string, uint64_t>>>>
+          &results,
+      std::vector<std::optional<uint64_t>> &found_tranc_ids);
+
+  // 从 sst 中查到 key 的值之后放入行缓存, 只放入查询时的最新版本:
+  // 不带事务可见性的查询, 或者快照不早于所有已写入版本的查询
+  void fill_row_cache(const std::string &key, const std::string &value,
+                      uint64_t value_tranc_id, uint64_t tranc_id,
+                      uint64_t row_token);
+
+  // 根据 level_sst_ids 和 ssts 发布新的 Version, 调用方需持有 ssts_mtx 写锁
+  void publish_version_locked();
+
+  // 没有 MANIFEST 时扫描目录, 在线程池中并行打开所有 sst 文件
+  void load_from_directory();
+  // 按照 MANIFEST 恢复 sst 布局, sst 文件在第一次读取时才打开
+  void load_from_manifest();
+  // 以下两个函数调用方需持有 ssts_mtx 写锁
+  // 当前所有存活 sst 组成的快照
+  VersionEdit snapshot_edit_locked();
+  // MANIFEST 超过 LSM_MAX_MANIFEST_FILE_SIZE 时重写为快照
+  void maybe_rewrite_manifest_locked();
+
+  // 后台刷盘线程
+  void flush_worker();
+  // 写入后检查是否需要唤醒后台刷盘, 以及是否需要限速或阻塞写入
+  void notify_flush_or_stall(size_t write_bytes);
+  // 刷盘或 compact 改变 sst 布局后, 重新计算写入限速的依据
+  // 调用方不能持有 ssts_mtx
+  void update_write_stall_condition();
+  // 各 level 超出容量的字节数之和, 调用方需持有 ssts_mtx
+  size_t estimate_pending_compaction_bytes();
+
+  // level 的 compact 得分, >= 1 表示需要 compact, 调用方需持有 ssts_mtx
+  double level_score(size_t level);
+  // 选出得分最高且涉及的 level 都空闲的任务, 调用方需持有 compact_mtx_
+  std::optional<CompactionTask> pick_compaction();
+  // 以下三个函数调用方需持有 ssts_mtx
+  // 按照 compact 指针轮流挑选 level 中的一个 sst, 还需持有 compact_mtx_
+  std::shared_ptr<SST> pick_sst_to_compact(size_t level);
+  // level 中与 [first_key, last_key] 有重叠的 sst
+  std::vector<std::shared_ptr<SST>>
+  overlapping_ssts(size_t level, const std::string &first_key,
+                   const std::string &last_key);
+  // l0 以外的 level 按照 first_key 排序
+  void sort_level_by_key(size_t level);
+  // 把所有可执行的任务提交到线程池, 调用方需持有 compact_mtx_
+  void schedule_compaction_locked();
+  void maybe_schedule_compaction();
+  // 在线程池中执行: 无锁构建输出 sst, 再短暂持有写锁安装结果
+  void run_compaction(const CompactionTask &task);
+  void install_compaction(const CompactionTask &task,
+                          std::vector<std::shared_ptr<SST>> &new_ssts);
+
+  std::vector<std::shared_ptr<SST>> l0_l1_compact(const CompactionTask &task);
+  // 按照输入 sst 的 block 边界把 key 空间切分为若干子区间, 返回切分点
+  std::vector<std::string>
+  subcompaction_boundaries(const std::vector<std::shared_ptr<SST>> &l0_ssts,
+                           const std::vector<std::shared_ptr<SST>> &l1_ssts);
+  // 只合并 [start_key, end_key) 范围内的 key, 空值表示该侧无边界
   std::vector<std::shared_ptr<SST>>
-  full_l0_l1_compact(std::vector<size_t> &l0_ids, std::vector<size_t> &l1_ids);
+  l0_l1_subcompact(const CompactionTask &task,
+                   const std::optional<std::string> &start_key,
+                   const std::optional<std::string> &end_key);
 
+  std::vector<std::shared_ptr<SST>> common_compact(const CompactionTask &task);
+
+  // 同一个 key 的所有版本写入同一个 sst, 只丢弃任何快照都读不到的版本
   std::vector<std::shared_ptr<SST>>
-  full_common_compact(std::vector<size_t> &lx_ids, std::vector<size_t> &ly_ids,
-                      size_t level_y);
+  gen_sst_from_iter(CompactIterator &iter, size_t target_sst_size,
+                    const CompactionTask &task);
+
+private:
+  std::mutex flush_mtx_; // 保证同一时刻只有一个刷盘任务
+  std::mutex flush_cv_mtx_;
+  std::condition_variable flush_cv_;       // 唤醒后台刷盘线程
+  std::condition_variable write_stall_cv_; // 唤醒被阻塞的写入
+  bool stop_flush_ = false;
+  std::thread flush_thread_;
+  // 启动时预热 block 缓存, 之后定期保存热点 block 列表
+  std::mutex hot_blocks_mtx_;
+  std::condition_variable hot_blocks_cv_;
+  bool stop_hot_blocks_ = false;
+  bool warm_up_done_ = false;
+  std::thread hot_blocks_thread_;
+  std::unique_ptr<WriteController> write_controller_;
+  std::atomic<std::shared_ptr<const Version>> current_version_;
+  // 修改 sst 布局之前先记录到 MANIFEST, 由 ssts_mtx 写锁保护
+  std::unique_ptr<Manifest> manifest_;
 
-  std::vector<std::shared_ptr<SST>> gen_sst_from_iter(BaseIterator &iter,
-                                                      size_t target_sst_size,
-                                                      size_t target_level);
+  std::mutex compact_mtx_; // 保护以下 compact 调度状态
+  std::condition_variable compact_cv_;
+  std::set<size_t> compacting_levels_; // 正在参与 compact 的 level
+  // 每个 level 上次 compact 的 sst 的 last_key, 下次从其之后开始挑选
+  std::map<size_t, std::string> compact_pointer_;
+  std::function<uint64_t()> oldest_snapshot_provider_;
+  size_t running_compactions_ = 0;
+  bool stop_compact_ = false;
+  std::unique_ptr<ThreadPool> compact_pool_;
+  // l0->l1 的子区间在这里并行执行, 与 compact_pool_ 分开避免互相等待
+  std::unique_ptr<ThreadPool> subcompact_pool_;
+  // 大批量 get_batch 切分后的 key 范围在这里并行查找 sst
+  std::unique_ptr<ThreadPool> multiget_pool_;
 };
 
 class LSM {
@@ -100,7 +254,7 @@ public:
   void remove_batch(const std::vector<std::string> &keys);
 
   using LSMIterator = Level_Iterator;
-  LSMIterator begin(uint64_t tranc_id);
+  LSMIterator begin(uint64_t tranc_id, bool fill_cache = true);
   LSMIterator end();
   std::optional<std::pair<TwoMergeIterator, TwoMergeIterator>>
   lsm_iters_monotony_predicate(
@@ -108,6 +262,15 @@ public:
   void clear();
   void flush();
   void flush_all();
+  // 阻塞直到后台没有正在执行或等待执行的 compact 任务
+  void wait_for_compaction();
+
+  // 写入限速的当前状态
+  WriteControllerStats get_write_stall_stats() const;
+  // 按给定的容量开启行缓存, 需要在读写开始之前调用
+  void enable_row_cache(size_t capacity);
+  // 行缓存的命中率, 未开启行缓存时为 0
+  double get_row_cache_hit_rate() const;
 
   // 开启一个事务
   std::shared_ptr<TranContext>
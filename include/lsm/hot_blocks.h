@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace toni_lsm {
+
+// 持久化的热点 block 列表, 引擎定期保存 BlockCache 中最热的 block,
+// 重启后按列表在后台预读, 缩短缓存为空时的冷启动阶段
+// 文件格式: [count(32)][sst_id(32) | block_id(32)] * count [hash(32)]
+class HotBlockList {
+public:
+  // 先写入临时文件再重命名, 崩溃时旧的列表仍然可用
+  static void save(const std::string &path,
+                   const std::vector<std::pair<int, int>> &keys);
+  // 文件不存在或者已经损坏时返回空列表
+  static std::vector<std::pair<int, int>> load(const std::string &path);
+};
+} // namespace toni_lsm
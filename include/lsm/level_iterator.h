@@ -1,8 +1,8 @@
 #pragma once
 #include "../iterator/iterator.h"
+#include "version.h"
 #include <memory>
 #include <optional>
-#include <shared_mutex>
 
 namespace toni_lsm {
 class LSMEngine;
@@ -10,7 +10,9 @@ class LSMEngine;
 class Level_Iterator : public BaseIterator {
 public:
   Level_Iterator() = default;
-  Level_Iterator(std::shared_ptr<LSMEngine> engine_, uint64_t max_tranc_id);
+  // fill_cache 为 false 时扫描读取的 block 不放入缓存
+  Level_Iterator(std::shared_ptr<LSMEngine> engine_, uint64_t max_tranc_id,
+                 bool fill_cache = true);
 
   virtual BaseIterator &operator++() override;
   virtual bool operator==(const BaseIterator &other) const override;
@@ -29,7 +31,8 @@ private:
   size_t cur_idx_;
   uint64_t max_tranc_id_;
   mutable std::optional<value_type> cached_value; // 缓存当前值
-  std::shared_lock<std::shared_mutex> rlock_;
+  // 迭代期间引用创建时的 sst 布局, 不会阻塞刷盘和 compact
+  std::shared_ptr<const Version> version_;
 
 private:
   void update_current() const;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../sst/sst.h"
+#include "../utils/files.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace toni_lsm {
+
+// 一次 sst 布局变化: 刷盘新增一个 l0 sst, compact 删除输入并新增输出
+// 一条 edit 要么完整写入 MANIFEST, 要么在恢复时被整体忽略
+struct VersionEdit {
+  std::vector<std::pair<size_t, SSTFileMeta>> added; // (level, sst 元数据)
+  std::vector<std::pair<size_t, size_t>> deleted;    // (level, sst_id)
+  size_t next_sst_id = 0;
+
+  std::vector<uint8_t> encode() const;
+  // 数据不完整时抛出 std::runtime_error
+  static VersionEdit decode(const uint8_t *data, size_t len);
+};
+
+// 重放 MANIFEST 得到的 sst 布局
+struct ManifestState {
+  std::map<size_t, std::map<size_t, SSTFileMeta>> levels; // level -> id -> meta
+  size_t next_sst_id = 0;
+
+  void apply(const VersionEdit &edit);
+};
+
+// 记录 sst 布局变化的日志, 重启时不需要逐个打开 sst 文件读取元数据
+// 文件格式: 若干条 [len(u32)][VersionEdit][hash(u32)],
+// 第一条是当时所有存活 sst 的快照, 之后每条是一次增量变化
+// 调用方需保证 write_snapshot 和 log_edit 不会并发执行
+class Manifest {
+public:
+  explicit Manifest(const std::string &data_dir);
+
+  static bool exists(const std::string &data_dir);
+  // 从头重放 MANIFEST, 遇到写了一半或校验失败的记录时停止
+  static ManifestState recover(const std::string &data_dir);
+
+  // 以 snapshot 为唯一内容重写 MANIFEST, 通过重命名原子地替换旧文件
+  void write_snapshot(const VersionEdit &snapshot);
+  // 追加一条记录并同步到磁盘
+  void log_edit(const VersionEdit &edit);
+
+  // 当前 MANIFEST 的字节数
+  size_t size() const;
+
+private:
+  static std::string get_path(const std::string &data_dir);
+  static std::vector<uint8_t> encode_record(const VersionEdit &edit);
+
+  std::string data_dir_;
+  FileObj file_;
+  size_t size_ = 0;
+};
+} // namespace toni_lsm
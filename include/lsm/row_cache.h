@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace toni_lsm {
+
+// 按用户 key 缓存 sst 中查到的最新版本, 命中时不再查询 memtable 和 sst
+// 缓存项始终是 key 的最新版本: 只有能看到所有已写入版本的查询结果才会放入,
+// 任何写入 memtable 的操作都会先使缓存项失效
+// 与 BlockCache 一样分片加锁, 容量按字节计算, 分片内按 LRU 淘汰
+class RowCache {
+public:
+  RowCache(size_t capacity, size_t shard_bits = 0);
+
+  // 查找 key 的缓存值, 快照读取时缓存的版本必须对 tranc_id 可见
+  // 未命中时通过 fill_token 返回填充令牌, 需要在查询 memtable 之前获取
+  std::optional<std::pair<std::string, uint64_t>>
+  get(const std::string &key, uint64_t tranc_id, uint64_t &fill_token);
+
+  // 放入从 sst 中查到的最新版本, 获取令牌之后同一分片有过写入时放弃,
+  // 避免与并发的写入交错而缓存旧值
+  void put(const std::string &key, const std::string &value, uint64_t tranc_id,
+           uint64_t fill_token);
+
+  // key 被写入时调用
+  void invalidate(const std::string &key);
+  void clear();
+
+  size_t capacity() const { return capacity_; }
+  size_t usage() const;
+  double hit_rate() const;
+
+private:
+  struct Entry {
+    std::string key;
+    std::string value;
+    uint64_t tranc_id;
+    size_t charge;
+  };
+
+  struct alignas(64) Shard {
+    size_t capacity = 0;
+    size_t usage = 0;
+    // 每次失效加一, 用作填充令牌
+    uint64_t epoch = 0;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru; // 头部为最近访问的缓存项
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t total_requests = 0;
+    size_t hit_requests = 0;
+  };
+
+  size_t capacity_;
+  size_t shard_mask_;
+  std::vector<Shard> shards_;
+
+  Shard &shard_for(const std::string &key);
+  // 调用方持有分片的锁
+  void erase_locked(Shard &shard, std::list<Entry>::iterator it);
+};
+} // namespace toni_lsm
@@ -2,11 +2,14 @@
 
 #include "../utils/files.h"
 #include "../wal/wal.h"
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -25,6 +28,30 @@ inline std::string isolation_level_to_string(const IsolationLevel &level);
 class LSMEngine;
 class TranManager;
 
+// 一次非事务读取持有的快照, 析构时释放
+// 读取抛出异常时同样会释放, 不会一直压住 compact 回收旧版本的水位
+class SnapshotGuard {
+  friend class TranManager;
+
+public:
+  SnapshotGuard(SnapshotGuard &&other) noexcept;
+  SnapshotGuard &operator=(SnapshotGuard &&other) noexcept;
+  SnapshotGuard(const SnapshotGuard &) = delete;
+  SnapshotGuard &operator=(const SnapshotGuard &) = delete;
+  ~SnapshotGuard();
+
+  uint64_t tranc_id() const { return tranc_id_; }
+  // 提前释放快照, 之后再调用不做任何事
+  void release();
+
+private:
+  SnapshotGuard(TranManager *manager, size_t slot, uint64_t tranc_id);
+
+  TranManager *manager_; // 不能比 TranManager 存活得更久
+  size_t slot_;
+  uint64_t tranc_id_;
+};
+
 class TranContext {
   friend class TranManager;
 
@@ -32,6 +59,7 @@ public:
   TranContext(uint64_t tranc_id, std::shared_ptr<LSMEngine> engine,
               std::shared_ptr<TranManager> tranManager,
               const enum IsolationLevel &isolation_level);
+  ~TranContext();
   void put(const std::string &key, const std::string &value);
   void remove(const std::string &key);
   std::optional<std::string> get(const std::string &key);
@@ -67,6 +95,16 @@ public:
   void init_new_wal();
   void set_engine(std::shared_ptr<LSMEngine> engine);
   std::shared_ptr<TranContext> new_tranc(const IsolationLevel &isolation_level);
+  // 事务提交、回滚或被丢弃后调用, 不再为它保留旧版本
+  void finish_tranc(uint64_t tranc_id);
+
+  // 为一次不属于事务的读取分配 tranc_id, 返回的 guard 析构时释放
+  // 只占用一个读取槽位, 不获取 mutex_
+  SnapshotGuard acquire_snapshot();
+  // 最老的未结束的事务或读取的 tranc_id, 都没有时为下一个将要分配的 id
+  // compact 只需要为 tranc_id 不小于它的读取保留版本
+  // 由 compact 调用, 需要扫描所有读取槽位
+  uint64_t get_oldest_snapshot();
 
   uint64_t getNextTransactionId();
   uint64_t get_max_flushed_tranc_id();
@@ -85,6 +123,16 @@ public:
   // void flusher();
 
 private:
+  friend class SnapshotGuard;
+  void release_snapshot(size_t slot, uint64_t tranc_id);
+
+  static constexpr size_t kReadSlots = 64;
+  static constexpr uint64_t kFreeSlot = UINT64_MAX;
+  // 每个槽位记录一个正在进行的非事务读取的 tranc_id 下界, 空闲时为 kFreeSlot
+  struct alignas(64) ReadSlot {
+    std::atomic<uint64_t> tranc_id = kFreeSlot;
+  };
+
   mutable std::mutex mutex_;
   std::shared_ptr<LSMEngine> engine_;
   std::shared_ptr<WAL> wal;
@@ -93,7 +141,11 @@ private:
   std::atomic<uint64_t> nextTransactionId_ = 1;
   std::atomic<uint64_t> max_flushed_tranc_id_ = 0;
   std::atomic<uint64_t> max_finished_tranc_id_ = 0;
-  std::map<uint64_t, std::shared_ptr<TranContext>> activeTrans_;
+  // 未结束的事务, 事务对象由调用方持有
+  std::map<uint64_t, std::weak_ptr<TranContext>> activeTrans_;
+  // 读取线程按线程 id 选择起始槽位, 槽位都被占用时退回 read_snapshots_
+  std::array<ReadSlot, kReadSlots> read_slots_;
+  std::multiset<uint64_t> read_snapshots_; // 由 mutex_ 保护
   FileObj tranc_id_file_;
 };
 
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../sst/sst.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace toni_lsm {
+
+// 某一时刻各 level 的 sst 布局, 发布之后不再修改
+// 读者持有引用期间, 其中的 sst 即使被 compact 移除也仍然可以读取
+struct Version {
+  // l0 按照从新到旧排列, 其他 level 按照 first_key 排列
+  std::map<size_t, std::vector<std::shared_ptr<SST>>> levels;
+  size_t max_level = 0;
+
+  // level 不存在时返回空列表
+  const std::vector<std::shared_ptr<SST>> &level(size_t level) const;
+};
+} // namespace toni_lsm
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace toni_lsm {
+
+enum class WriteStallState {
+  Normal,  // 写入不受限制
+  Delayed, // 按照令牌桶限速写入
+  Stopped, // 阻塞写入, 直到刷盘或 compact 追上
+};
+
+std::string to_string(WriteStallState state);
+
+// 写入控制器的当前状态, 作为监控指标对外暴露
+struct WriteControllerStats {
+  WriteStallState state = WriteStallState::Normal;
+  size_t l0_files = 0;
+  size_t immutable_memtables = 0;
+  size_t pending_compaction_bytes = 0;
+  uint64_t delayed_write_rate = 0; // 当前限速, 字节/秒, 仅 Delayed 时有意义
+  uint64_t num_delayed_writes = 0;
+  uint64_t total_delay_us = 0;
+  uint64_t num_stopped_writes = 0;
+};
+
+// 根据 l0 sst 数量、冻结表数量和待 compact 的数据量决定写入是否需要限速:
+// 任一指标超过 slowdown 阈值时进入 Delayed, 越接近 stop 阈值限速越严格;
+// 任一指标达到 stop 阈值时进入 Stopped
+class WriteController {
+public:
+  WriteController(size_t l0_slowdown_trigger, size_t l0_stop_trigger,
+                  size_t immutable_slowdown_trigger,
+                  size_t immutable_stop_trigger,
+                  size_t soft_pending_compaction_bytes,
+                  size_t hard_pending_compaction_bytes,
+                  uint64_t delayed_write_rate);
+
+  // 刷盘或 compact 完成后由 engine 更新
+  void update_lsm_condition(size_t l0_files, size_t pending_compaction_bytes);
+  // 每次写入后由 engine 更新
+  void update_immutable_memtables(size_t immutable_memtables);
+
+  WriteStallState get_state() const;
+
+  // Delayed 状态下写入 bytes 字节需要等待的微秒数, 其他状态返回 0
+  uint64_t get_delay_us(size_t bytes);
+
+  // 记录一次被阻塞的写入
+  void record_stop();
+
+  WriteControllerStats get_stats() const;
+
+private:
+  // 调用方需持有 mtx_
+  void recalc_state_locked();
+
+  const size_t l0_slowdown_trigger_;
+  const size_t l0_stop_trigger_;
+  const size_t immutable_slowdown_trigger_;
+  const size_t immutable_stop_trigger_;
+  const size_t soft_pending_compaction_bytes_;
+  const size_t hard_pending_compaction_bytes_;
+  const uint64_t max_delayed_write_rate_;
+
+  mutable std::mutex mtx_;
+  size_t l0_files_ = 0;
+  // 每次写入都会检查是否变化, 未变化时不加锁
+  std::atomic<size_t> immutable_memtables_ = 0;
+  size_t pending_compaction_bytes_ = 0;
+  uint64_t delayed_write_rate_;
+  // 写入路径只读取状态, 不需要加锁
+  std::atomic<WriteStallState> state_ = WriteStallState::Normal;
+
+  // 令牌桶: 按照 delayed_write_rate_ 补充, 允许为负表示已经透支
+  double available_bytes_ = 0;
+  std::chrono::steady_clock::time_point last_refill_;
+
+  uint64_t num_delayed_writes_ = 0;
+  uint64_t total_delay_us_ = 0;
+  uint64_t num_stopped_writes_ = 0;
+};
+} // namespace toni_lsm
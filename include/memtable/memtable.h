@@ -2,6 +2,7 @@
 
 #include "../iterator/iterator.h"
 #include "../skiplist/skiplist.h"
+#include <atomic>
 #include <cstddef>
 #include <functional>
 #include <iostream>
@@ -36,6 +37,7 @@ private:
   SkipListIterator frozen_get_(const std::string &key, uint64_t tranc_id);
 
   void remove_(const std::string &key, uint64_t tranc_id);
+  void update_max_write_tranc_id(uint64_t tranc_id);
   void frozen_cur_table_(); // _ 表示不需要锁的版本
 
 public:
@@ -47,6 +49,7 @@ public:
                  uint64_t tranc_id);
 
   SkipListIterator get(const std::string &key, uint64_t tranc_id);
+  // 没有找到的键返回 nullopt, 被删除的键返回空值
   std::vector<
       std::pair<std::string, std::optional<std::pair<std::string, uint64_t>>>>
   get_batch(const std::vector<std::string> &keys, uint64_t tranc_id);
@@ -54,12 +57,16 @@ public:
   void remove_batch(const std::vector<std::string> &keys, uint64_t tranc_id);
 
   void clear();
+  // 将最老的冻结表构建为 sst, 构建期间该表仍保留在冻结链表中供读者查询
   std::shared_ptr<SST> flush_last(SSTBuilder &builder, std::string &sst_path,
                                   size_t sst_id,
                                   std::shared_ptr<BlockCache> block_cache);
+  // flush_last 生成的 sst 对读者可见后, 移除已经刷盘的最老的冻结表
+  void remove_last_frozen();
   void frozen_cur_table();
   size_t get_cur_size();
   size_t get_frozen_size();
+  size_t get_frozen_table_num();
   size_t get_total_size();
   HeapIterator begin(uint64_t tranc_id);
   HeapIterator iters_preffix(const std::string &preffix, uint64_t tranc_id);
@@ -70,11 +77,20 @@ public:
 
   HeapIterator end();
 
+  // 设置写入回调, 每个 key 写入活跃表之后以该 key 调用, 用于使行缓存失效
+  // 需要在写入开始之前设置
+  void set_write_callback(std::function<void(const std::string &)> callback);
+  // 写入过的最大事务 id, 不随刷盘和 clear 重置
+  uint64_t get_max_write_tranc_id() const;
+
 private:
   std::shared_ptr<SkipList> current_table;
   std::list<std::shared_ptr<SkipList>> frozen_tables;
   size_t frozen_bytes;
   std::shared_mutex frozen_mtx; // 冻结表的锁
   std::shared_mutex cur_mtx;    // 活跃表的锁
+  std::function<void(const std::string &)> write_callback_;
+  // 在写入回调之前更新, 行缓存据此判断快照是否覆盖了所有已写入的版本
+  std::atomic<uint64_t> max_write_tranc_id_ = 0;
 };
 } // namespace toni_lsm
\ No newline at end of file
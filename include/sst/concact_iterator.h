@@ -12,9 +12,11 @@ private:
   size_t cur_idx; // 不是真实的sst_id, 而是在需要连接的sst数组中的索引
   std::vector<std::shared_ptr<SST>> ssts;
   uint64_t max_tranc_id_;
+  bool fill_cache_;
 
 public:
-  ConcactIterator(std::vector<std::shared_ptr<SST>> ssts, uint64_t tranc_id);
+  ConcactIterator(std::vector<std::shared_ptr<SST>> ssts, uint64_t tranc_id,
+                  bool fill_cache = true);
 
   std::string key();
   std::string value();
@@ -2,12 +2,17 @@
 
 #include "../block/block.h"
 #include "../block/block_cache.h"
+#include "../block/block_index.h"
 #include "../block/blockmeta.h"
 #include "../utils/bloom_filter.h"
 #include "../utils/files.h"
+#include "table_cache.h"
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -16,6 +21,34 @@ namespace toni_lsm {
 
 class SstIterator;
 
+// 不需要打开文件就能获得的 sst 元数据, 由 MANIFEST 记录
+struct SSTFileMeta {
+  size_t sst_id = 0;
+  size_t file_size = 0;
+  std::string first_key;
+  std::string last_key;
+  uint64_t min_tranc_id = UINT64_MAX;
+  uint64_t max_tranc_id = 0;
+};
+
+// sst 打开之后才有的状态: 文件句柄、block 索引和布隆过滤器
+// 可能被 TableCache 关闭, 使用期间需要持有引用
+struct SSTReader {
+  FileObj file;
+  BlockIndex index;
+  uint32_t bloom_offset = 0;
+  uint32_t meta_block_offset = 0;
+  std::shared_ptr<BloomFilter> bloom_filter;
+  // mmap 读取模式下整个文件的只读映射, 数据块直接引用其中的内存
+  std::shared_ptr<MmapFile> mapped;
+  // 文件的身份, 由元数据块的哈希以及 inode 和修改时间混合得到, 不为 0
+  // 重启后 sst_id 可能被新文件复用, 二级缓存据此区分新旧文件的 block
+  uint64_t file_id = 0;
+
+  // 第 block_idx 个 block 在文件中的偏移量和长度(包括 hash)
+  std::pair<size_t, size_t> block_range(size_t block_idx) const;
+};
+
 /**
  * SST文件的结构, 参考自 https://skyzh.github.io/mini-lsm/week1-04-sst.html
  * ------------------------------------------------------------------------
@@ -47,32 +80,92 @@ class SST : public std::enable_shared_from_this<SST> {
       std::function<int(const std::string &)> predicate);
 
 private:
-  FileObj file;
-  std::vector<BlockMeta> meta_entries;
-  uint32_t bloom_offset;
-  uint32_t meta_block_offset;
   size_t sst_id;
   std::string first_key;
   std::string last_key;
-  std::shared_ptr<BloomFilter> bloom_filter;
+  size_t file_size_ = 0;
   std::shared_ptr<BlockCache> block_cache;
   uint64_t min_tranc_id_ = UINT64_MAX;
   uint64_t max_tranc_id_ = 0;
+  std::shared_ptr<TableCache> table_cache_;
+
+  // 为空表示还没有打开, 或者已经被 TableCache 关闭
+  mutable std::atomic<std::shared_ptr<SSTReader>> reader_;
+  mutable std::mutex open_mtx_; // 保护打开和关闭, 以及以下两个字段
+  std::string path_;
+  bool pinned_ = false; // 文件已被删除, 不能再关闭
+  // block 索引和布隆过滤器常驻内存, 不由 TableCache 关闭
+  bool pin_reader_ = false;
+  bool use_mmap_ = false;
+  // 不为空时以 O_DIRECT 打开文件
+  std::shared_ptr<AlignedBufferPool> direct_io_pool_;
+
+  // 读取文件末尾的元数据块和布隆过滤器, use_mmap 时同时映射整个文件
+  static std::shared_ptr<SSTReader> load_reader(FileObj file, size_t file_size,
+                                                bool use_mmap);
+  // 返回打开状态, 还没有打开或已经被关闭时重新打开文件
+  std::shared_ptr<SSTReader> get_reader() const;
+  // 打开状态常驻内存的字节数
+  size_t reader_charge(const SSTReader &reader) const;
+  // 从 BlockCache 的二级缓存中查找 block, 没有设置二级缓存或者未命中时返回空
+  std::shared_ptr<Block> read_secondary(size_t block_idx,
+                                        const SSTReader &reader);
 
 public:
+  // prefetch_blocks 单次顺序读取的最大字节数, 以及合并读取时允许读过的间隙
+  static constexpr size_t kPrefetchMaxBytes = 4 * 1024 * 1024;
+  static constexpr size_t kPrefetchMaxGap = 64 * 1024;
+
+  ~SST();
+
   // 从文件中打开sst
   static std::shared_ptr<SST> open(size_t sst_id, FileObj file,
                                    std::shared_ptr<BlockCache> block_cache);
+  // 只记录元数据, 文件在第一次读取数据时才打开
+  static std::shared_ptr<SST>
+  open_lazy(const SSTFileMeta &meta, const std::string &path,
+            std::shared_ptr<BlockCache> block_cache);
+  // 之后由 table_cache 限制打开状态的数量, 已经打开的 sst 立即登记
+  void attach_table_cache(std::shared_ptr<TableCache> table_cache);
+  // 关闭文件并释放 block 索引和布隆过滤器, 由 TableCache 调用
+  void release_reader() const;
+  // 设置打开状态是否常驻内存, 常驻时从 TableCache 中移除, 取消后重新登记
+  // 用于访问最频繁的 l0 和 l1
+  void set_pin_reader(bool pin);
+  bool is_reader_pinned() const;
+  // 切换数据块的读取方式, 已经打开的文件会被关闭, 下次读取时按新方式打开
+  void set_use_mmap(bool use_mmap);
+  // 设置后以 O_DIRECT 读取, 由 BlockCache 作为唯一的缓存; 为空时使用页缓存
+  // 与 set_use_mmap 相同, 已经打开的文件在下次读取时重新打开
+  void set_direct_io(std::shared_ptr<AlignedBufferPool> pool);
+  // 删除文件, 已经持有该 sst 的读者仍然可以继续读取
   void del_sst();
+  // 将sst文件移动到新的路径, 不改写文件内容
+  void rename_sst(const std::string &new_path);
   // 创建一个sst, 只包含首尾key的元数据
   static std::shared_ptr<SST> create_sst_with_meta_only(
       size_t sst_id, size_t file_size, const std::string &first_key,
       const std::string &last_key, std::shared_ptr<BlockCache> block_cache);
   // 根据索引读取block
-  std::shared_ptr<Block> read_block(size_t block_idx);
+  // fill_cache 为 false 时仍然会查找缓存, 但从磁盘读取的 block 不放入缓存,
+  // 用于一次性的扫描和 compact 读取
+  // BlockCache 未命中时先查找二级缓存, 再读取 sst 文件
+  std::shared_ptr<Block> read_block(size_t block_idx, bool fill_cache = true);
+  // 批量读取多个 sst 中的 block, 返回值与 blocks 一一对应
+  // 未缓存的 block 通过当前线程的 io_uring 一次提交, 由设备并发读取
+  static std::vector<std::shared_ptr<Block>> read_blocks(
+      const std::vector<std::pair<std::shared_ptr<SST>, size_t>> &blocks,
+      bool fill_cache = true);
+
+  // 预读一组 block 放入缓存, 返回实际读取的数量
+  // 已经缓存的 block 被跳过, 相邻的 block 合并成一次顺序读取
+  size_t prefetch_blocks(std::vector<size_t> block_idxs);
 
   // 找到key所在的block的idx
   size_t find_block_idx(const std::string &key);
+  // 批量定位多个 key 所在的 block, keys 需要有序, 返回值与 keys 一一对应
+  // 只获取一次打开状态, 布隆过滤器排除或者超出范围的 key 返回 -1
+  std::vector<size_t> find_block_idxs(std::span<const std::string> keys);
 
   // 根据key返回迭代器
   SstIterator get(const std::string &key, uint64_t tranc_id);
@@ -80,6 +173,13 @@ public:
   // 返回sst中block的数量
   size_t num_blocks() const;
 
+  // 返回 block 索引, 返回值持有打开状态, 不会因为 sst 被关闭而失效
+  std::shared_ptr<const BlockIndex> get_block_index() const;
+
+  // 完整的 first_key 和 last_key 只保存在文件中, 每次调用都会重新读取并解码
+  // 元数据块, 只用于测试和调试, 查询路径使用 get_block_index
+  std::shared_ptr<const std::vector<BlockMeta>> get_meta_entries() const;
+
   // 返回sst的首key
   std::string get_first_key() const;
 
@@ -95,10 +195,28 @@ public:
   std::optional<std::pair<SstIterator, SstIterator>>
   iters_monotony_predicate(std::function<bool(const std::string &)> predicate);
 
-  SstIterator begin(uint64_t tranc_id);
+  SstIterator begin(uint64_t tranc_id, bool fill_cache = true);
   SstIterator end();
 
   std::pair<uint64_t, uint64_t> get_tranc_id_range() const;
+
+  SSTFileMeta get_file_meta() const;
+};
+
+// 顺序读取 sst 时, 遇到不在窗口内的 block 就批量读取它之后的
+// LSM_READAHEAD_BLOCKS 个 block, 之后的读取直接从窗口中取
+class BlockReadahead {
+private:
+  const SST *sst_ = nullptr;
+  size_t start_ = 0;
+  std::vector<std::shared_ptr<Block>> blocks_;
+  bool fill_cache_; // 读取的 block 是否放入缓存
+
+public:
+  explicit BlockReadahead(bool fill_cache = true) : fill_cache_(fill_cache) {}
+
+  std::shared_ptr<Block> read(const std::shared_ptr<SST> &sst,
+                              size_t block_idx);
 };
 
 class SSTBuilder {
@@ -112,11 +230,14 @@ private:
   std::shared_ptr<BloomFilter> bloom_filter;
   uint64_t min_tranc_id_ = UINT64_MAX;
   uint64_t max_tranc_id_ = 0;
+  std::shared_ptr<AlignedBufferPool> direct_io_pool_;
 
 public:
   // 创建一个sst构建器, 指定目标block的大小
   SSTBuilder(size_t block_size, bool has_bloom); // 添加一个key-value对
   void add(const std::string &key, const std::string &value, uint64_t tranc_id);
+  // 设置后以 O_DIRECT 写入文件, 生成的 sst 也以 O_DIRECT 读取
+  void set_direct_io(std::shared_ptr<AlignedBufferPool> pool);
   // 估计sst的大小
   size_t estimated_size() const;
   // 完成当前block的构建, 即将block写入data, 并创建新的block
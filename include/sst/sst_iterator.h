@@ -1,5 +1,6 @@
 #pragma once
 #include "../block/block_iterator.h"
+#include "sst.h"
 #include <cstddef>
 #include <functional>
 #include <memory>
@@ -30,6 +31,8 @@ private:
   uint64_t max_tranc_id_;
   std::shared_ptr<BlockIterator> m_block_it;
   mutable std::optional<value_type> cached_value; // 缓存当前值
+  bool fill_cache_ = true;   // 读取的 block 是否放入缓存
+  BlockReadahead readahead_; // 顺序遍历时批量读取之后的 block
 
   void update_current() const;
   void set_block_idx(size_t idx);
@@ -37,7 +40,9 @@ private:
 
 public:
   // 创建迭代器, 并移动到第一个key
-  SstIterator(std::shared_ptr<SST> sst, uint64_t tranc_id);
+  // 扫描整个 sst 时可以指定 fill_cache 为 false, 避免挤掉缓存中的热点 block
+  SstIterator(std::shared_ptr<SST> sst, uint64_t tranc_id,
+              bool fill_cache = true);
   // 创建迭代器, 并移动到第指定key
   SstIterator(std::shared_ptr<SST> sst, const std::string &key,
               uint64_t tranc_id);
@@ -49,6 +54,8 @@ public:
 
   void seek_first();
   void seek(const std::string &key);
+  // 移动到第一个 >= key 的位置, 不要求 key 存在
+  void seek_lower_bound(const std::string &key);
   std::string key();
   std::string value();
 
@@ -58,6 +65,8 @@ public:
   virtual value_type operator*() const override;
   virtual IteratorType get_type() const override;
   virtual uint64_t get_tranc_id() const override;
+  // 当前记录自身的事务 id, get_tranc_id 返回的是查询时指定的事务 id
+  uint64_t get_cur_tranc_id() const;
   virtual bool is_end() const override;
   virtual bool is_valid() const override;
 
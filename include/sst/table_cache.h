@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace toni_lsm {
+
+class SST;
+
+// 记录当前打开的 sst, 限制打开的文件数和常驻内存的 block 索引、布隆过滤器字节数
+// 超出限制时关闭最久未访问的 sst, 关闭后再次读取时会重新打开
+// 正在读取的调用方持有打开状态的引用, 不会受到关闭的影响
+class TableCache {
+public:
+  TableCache(size_t max_open_files, size_t capacity);
+
+  // sst 打开之后登记, charge 为其常驻内存的字节数
+  void insert(size_t sst_id, std::weak_ptr<const SST> sst, size_t charge);
+  // 标记 sst 最近被访问过
+  void touch(size_t sst_id);
+  // sst 被销毁或不允许再关闭时移除登记, 不会关闭它
+  void erase(size_t sst_id);
+
+  size_t open_files() const;
+  // 已登记的 sst 常驻内存的字节数之和
+  size_t usage() const;
+
+private:
+  struct Entry {
+    size_t sst_id;
+    std::weak_ptr<const SST> sst;
+    size_t charge;
+  };
+
+  const size_t max_open_files_;
+  const size_t capacity_;
+
+  mutable std::mutex mtx_;
+  std::list<Entry> lru_; // 头部为最近访问的 sst
+  std::unordered_map<size_t, std::list<Entry>::iterator> index_;
+  size_t usage_ = 0;
+};
+} // namespace toni_lsm
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace toni_lsm {
+
+class AlignedBufferPool;
+
+// 起始地址和容量都按 AlignedBufferPool::kAlignment 对齐的缓冲区,
+// 析构时归还给分配它的缓冲池
+class AlignedBuffer {
+  friend class AlignedBufferPool;
+
+private:
+  uint8_t *data_ = nullptr;
+  size_t capacity_ = 0;
+  std::shared_ptr<AlignedBufferPool> pool_;
+
+  AlignedBuffer(uint8_t *data, size_t capacity,
+                std::shared_ptr<AlignedBufferPool> pool)
+      : data_(data), capacity_(capacity), pool_(std::move(pool)) {}
+
+public:
+  AlignedBuffer() = default;
+  ~AlignedBuffer();
+
+  AlignedBuffer(const AlignedBuffer &) = delete;
+  AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+  AlignedBuffer(AlignedBuffer &&other) noexcept;
+  AlignedBuffer &operator=(AlignedBuffer &&other) noexcept;
+
+  uint8_t *data() const { return data_; }
+  size_t capacity() const { return capacity_; }
+};
+
+// O_DIRECT 读写使用的对齐缓冲区池, 由引擎持有
+// 按 2 的幂分级复用, 空闲缓冲区的总量不超过 max_cached_bytes
+class AlignedBufferPool
+    : public std::enable_shared_from_this<AlignedBufferPool> {
+  friend class AlignedBuffer;
+
+public:
+  // O_DIRECT 要求的偏移量、长度和内存地址的对齐粒度
+  static constexpr size_t kAlignment = 4096;
+
+  explicit AlignedBufferPool(size_t max_cached_bytes);
+  ~AlignedBufferPool();
+
+  AlignedBufferPool(const AlignedBufferPool &) = delete;
+  AlignedBufferPool &operator=(const AlignedBufferPool &) = delete;
+
+  // 获取容量不小于 size 的缓冲区, 内容未初始化
+  AlignedBuffer acquire(size_t size);
+
+  // 当前空闲缓冲区的总字节数
+  size_t cached_bytes() const;
+
+  static size_t align_down(size_t value) { return value & ~(kAlignment - 1); }
+  static size_t align_up(size_t value) {
+    return align_down(value + kAlignment - 1);
+  }
+
+private:
+  size_t max_cached_bytes_;
+  size_t cached_bytes_ = 0;
+  mutable std::mutex mtx_;
+  std::unordered_map<size_t, std::vector<uint8_t *>> free_lists_; // 按容量
+
+  void release(uint8_t *data, size_t capacity);
+};
+} // namespace toni_lsm
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "mmap_file.h"
-#include "std_file.h"
+#include "posix_file.h"
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -12,7 +12,8 @@ namespace toni_lsm {
 
 class FileObj {
 private:
-  std::unique_ptr<StdFile> m_file;
+  // sst 和 wal 都使用 pread/pwrite, 并发读取不会争用文件位置
+  std::unique_ptr<PosixFile> m_file;
   size_t m_size;
 
 public:
@@ -34,15 +35,36 @@ public:
   // 设置文件大小
   void set_size(size_t size);
 
+  // 文件路径
+  std::string path() const;
+
+  // 文件描述符, 用于批量提交读取请求
+  int fd() const;
+
   // 删除文件
   void del_file();
 
+  // 重命名文件
+  void rename(const std::string &new_path);
+
   // 创建文件对象, 并写入到磁盘
-  static FileObj create_and_write(const std::string &path,
-                                  std::vector<uint8_t> buf);
+  // 指定 direct_pool 时以 O_DIRECT 读写, 不经过页缓存
+  static FileObj
+  create_and_write(const std::string &path, std::vector<uint8_t> buf,
+                   std::shared_ptr<AlignedBufferPool> direct_pool = nullptr);
+
+  // 同步目录项, 使目录中新建, 重命名和删除的文件在崩溃后仍然可见
+  static bool sync_dir(const std::string &dir);
 
   // 打开文件对象
-  static FileObj open(const std::string &path, bool create);
+  static FileObj open(const std::string &path, bool create,
+                      std::shared_ptr<AlignedBufferPool> direct_pool = nullptr);
+
+  // 以 O_DIRECT 打开时返回使用的缓冲池, 否则返回空
+  std::shared_ptr<AlignedBufferPool> direct_pool() const;
+
+  // 只读映射当前文件内容, 映射在返回值销毁之前有效, 与文件对象的生命周期无关
+  std::shared_ptr<MmapFile> map_readonly() const;
 
   // 读取并返回切片
   std::vector<uint8_t> read_to_slice(size_t offset, size_t length);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace toni_lsm {
+
+// TinyLFU 使用的访问频率估计 (Count-Min Sketch, 4 位计数器)
+// 每个 key 对应 4 个计数器, 估计值取最小者, 最多记到 15
+// 记录次数达到预期元素数量的 10 倍时所有计数器减半, 让旧的热点逐渐冷却
+class FrequencySketch {
+public:
+  // expected_entries: 预期同时缓存的元素数量, 决定计数器的数量
+  explicit FrequencySketch(size_t expected_entries);
+
+  // 记录一次访问, hash 为调用方计算好的 64 位哈希值
+  void increment(uint64_t hash);
+
+  // 估计访问次数
+  uint32_t estimate(uint64_t hash) const;
+
+private:
+  static constexpr int kDepth = 4;               // 每个 key 的计数器数量
+  static constexpr uint32_t kMaxCount = 15;      // 4 位计数器的上限
+  static constexpr size_t kCountersPerWord = 16; // 每个 uint64_t 的计数器数
+
+  std::vector<uint64_t> table_;
+  size_t counter_mask_; // 计数器总数减一
+  size_t sample_size_;  // 记录多少次之后减半
+  size_t additions_ = 0;
+
+  size_t index_of(uint64_t hash, int i) const;
+  uint32_t counter_at(size_t idx) const;
+  void reset();
+};
+} // namespace toni_lsm
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace toni_lsm {
+
+// 一次批量读取中的单个请求
+struct ReadRequest {
+  int fd = -1;
+  size_t offset = 0;
+  size_t length = 0;
+  uint8_t *buf = nullptr;
+  // 至少需要读到的字节数, 为 0 时需要读满 length
+  // O_DIRECT 读取对齐之后的区间可能越过文件末尾, 此时只要求读到有效部分
+  size_t required = 0;
+  bool ok = false; // 是否读到了需要的字节数
+};
+
+// 基于 io_uring 的批量读取, 一次系统调用提交整批请求, 由设备并发完成
+// 直接使用系统调用, 不依赖 liburing; 内核不支持或者被禁用时退化为逐个 pread
+// 同一个实例不能被多个线程同时使用, 每个线程各自持有一个实例
+class IoUring {
+private:
+  int ring_fd_ = -1;
+  unsigned sq_entries_ = 0;
+
+  // 提交队列
+  void *sq_ptr_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  unsigned *sq_head_ = nullptr;
+  unsigned *sq_tail_ = nullptr;
+  unsigned *sq_mask_ = nullptr;
+  unsigned *sq_array_ = nullptr;
+  void *sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  // 完成队列, 内核支持时与提交队列共用一次映射
+  void *cq_ptr_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  unsigned *cq_head_ = nullptr;
+  unsigned *cq_tail_ = nullptr;
+  unsigned *cq_mask_ = nullptr;
+  void *cqes_ = nullptr;
+
+  // 提交不超过 sq_entries_ 个请求并等待全部完成
+  void submit_and_wait(ReadRequest *reqs, size_t count);
+  void close();
+
+public:
+  // entries 为队列深度, 为 0 时不创建 io_uring
+  explicit IoUring(unsigned entries);
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // io_uring 是否可用, 不可用时 read_batch 使用 pread
+  bool available() const { return ring_fd_ != -1; }
+
+  // 读取所有请求并等待完成, 超过队列深度时分多次提交
+  // 短读或者单个请求失败时用 pread 补齐剩余部分
+  void read_batch(std::vector<ReadRequest> &reqs);
+};
+} // namespace toni_lsm
@@ -30,6 +30,14 @@ public:
   // 打开文件并映射到内存
   bool open(const std::string &filename, bool create = false);
 
+  // 以只读方式映射 fd 的前 size 字节, 映射不持有 fd, 之后 fd 可以被关闭
+  bool map_readonly(int fd, size_t size);
+
+  // 返回映射区域中 offset 处的地址, 调用方负责检查边界
+  const uint8_t *data_at(size_t offset) const {
+    return static_cast<const uint8_t *>(mapped_data_) + offset;
+  }
+
   // 创建文件
   bool create(const std::string &filename, std::vector<uint8_t> &buf);
 
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "aligned_buffer.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace toni_lsm {
+
+// 基于 pread/pwrite 的文件, 读写都指定偏移量, 不共享文件位置
+// 并发读取之间不需要加锁
+// 以 O_DIRECT 打开时绕过页缓存, 读写经过缓冲池中的对齐缓冲区中转
+class PosixFile {
+private:
+  int fd_ = -1;
+  // 写入时维护, 读取时不需要 fstat
+  std::atomic<size_t> size_ = 0;
+  std::string filename_;
+  std::mutex filename_mtx_; // 只保护 filename_
+  // 不为空表示以 O_DIRECT 打开
+  std::shared_ptr<AlignedBufferPool> direct_pool_;
+
+  void direct_read(size_t offset, size_t length, void *buf);
+  bool direct_write(size_t offset, const void *data, size_t size);
+
+public:
+  PosixFile() {}
+  ~PosixFile() { close(); }
+
+  PosixFile(const PosixFile &) = delete;
+  PosixFile &operator=(const PosixFile &) = delete;
+
+  // 打开文件, create 为 true 时创建或清空文件
+  // 指定 direct_pool 时以 O_DIRECT 打开, 文件系统不支持时退化为普通读写
+  bool open(const std::string &filename, bool create,
+            std::shared_ptr<AlignedBufferPool> direct_pool = nullptr);
+
+  // 创建文件并写入 buf
+  bool create(const std::string &filename, std::vector<uint8_t> &buf,
+              std::shared_ptr<AlignedBufferPool> direct_pool = nullptr);
+
+  // 关闭文件
+  void close();
+
+  // 获取文件大小
+  size_t size();
+
+  // 文件描述符, 未打开时为 -1
+  int fd() const { return fd_; }
+
+  // 以 O_DIRECT 打开时返回使用的缓冲池, 否则返回空
+  const std::shared_ptr<AlignedBufferPool> &direct_pool() const {
+    return direct_pool_;
+  }
+
+  // 当前文件名, 重命名之后返回新的文件名
+  std::string filename();
+
+  // 写入数据, O_DIRECT 模式下 offset 必须对齐, 末尾不足对齐粒度的部分
+  // 补零写入后再截断
+  bool write(size_t offset, const void *data, size_t size);
+
+  // 读取数据
+  std::vector<uint8_t> read(size_t offset, size_t length);
+  // 读取数据到调用方提供的缓冲区
+  void read(size_t offset, size_t length, void *buf);
+
+  // 同步到磁盘
+  bool sync();
+
+  // 删除文件
+  bool remove();
+
+  // 重命名文件, 已打开的文件描述符仍然有效
+  void rename(const std::string &new_filename);
+};
+} // namespace toni_lsm
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace toni_lsm {
+
+// 固定线程数的线程池, 任务按提交顺序执行
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t thread_num);
+  // 析构时会执行完队列中剩余的任务再退出
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // 提交任务, 返回任务结果的 future
+  // 线程池已经停止时抛出 std::runtime_error
+  template <typename F, typename... Args>
+  auto submit(F &&f, Args &&...args)
+      -> std::future<std::invoke_result_t<F, Args...>>;
+
+  // 停止接收新任务, 等待已提交的任务执行完毕
+  void shutdown();
+
+  size_t thread_num() const;
+
+private:
+  void worker_loop();
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+template <typename F, typename... Args>
+auto ThreadPool::submit(F &&f, Args &&...args)
+    -> std::future<std::invoke_result_t<F, Args...>> {
+  using ReturnType = std::invoke_result_t<F, Args...>;
+
+  auto task = std::make_shared<std::packaged_task<ReturnType()>>(
+      std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  std::future<ReturnType> res = task->get_future();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (stop_) {
+      throw std::runtime_error("submit on stopped ThreadPool");
+    }
+    tasks_.emplace([task]() { (*task)(); });
+  }
+  cv_.notify_one();
+  return res;
+}
+} // namespace toni_lsm
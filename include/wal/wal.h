@@ -35,10 +35,12 @@ public:
 
 private:
   void cleaner();
-  void cleanWALFile();
   void reset_file();
 
 protected:
+  // 删除除当前文件外所有事务都已结束的 wal 文件
+  void cleanWALFile();
+
   std::string active_log_path_;
   FileObj log_file_;
   size_t file_size_limit_;
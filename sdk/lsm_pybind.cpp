@@ -73,13 +73,17 @@ PYBIND11_MODULE(lsm_pybind, m) {
            "Get value by key, returns None if not found")
       .def("remove", &toni_lsm::LSM::remove, py::arg("key"), "Delete a key")
       // 批量操作
+      .def("get_batch", &toni_lsm::LSM::get_batch, py::arg("keys"),
+           "Batch get values, None for keys not found")
       .def("put_batch", &toni_lsm::LSM::put_batch, py::arg("kvs"),
            "Batch insert key-value pairs")
       .def("remove_batch", &toni_lsm::LSM::remove_batch, py::arg("keys"),
            "Batch delete keys")
       // 迭代器
       .def("begin", &toni_lsm::LSM::begin, py::arg("tranc_id"),
-           "Start an iterator with transaction ID")
+           py::arg("fill_cache") = true,
+           "Start an iterator with transaction ID, fill_cache=False keeps "
+           "scanned blocks out of the block cache")
       .def("end", &toni_lsm::LSM::end, "Get end iterator")
       // 事务
       .def("begin_tran", &toni_lsm::LSM::begin_tran, py::arg("isolation_level"),
@@ -61,6 +61,9 @@ class LSM:
         ...
 
     # 批量操作
+    def get_batch(self, keys: List[bytes]) -> List[Tuple[bytes, Optional[bytes]]]:
+        ...
+
     def put_batch(self, kvs: List[Tuple[bytes, bytes]]) -> None:
         ...
 
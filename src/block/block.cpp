@@ -14,15 +14,15 @@ Block::Block(size_t capacity) : capacity(capacity) {}
 
 std::vector<uint8_t> Block::encode() {
   // 计算总大小：数据段 + 偏移数组(每个偏移2字节) + 元素个数(2字节)
-  size_t total_bytes = data.size() * sizeof(uint8_t) +
+  size_t total_bytes = data_size() * sizeof(uint8_t) +
                        offsets.size() * sizeof(uint16_t) + sizeof(uint16_t);
   std::vector<uint8_t> encoded(total_bytes, 0);
 
   // 1. 复制数据段
-  memcpy(encoded.data(), data.data(), data.size() * sizeof(uint8_t));
+  memcpy(encoded.data(), data_ptr(), data_size() * sizeof(uint8_t));
 
   // 2. 复制偏移数组
-  size_t offset_pos = data.size() * sizeof(uint8_t);
+  size_t offset_pos = data_size() * sizeof(uint8_t);
   memcpy(encoded.data() + offset_pos,
          offsets.data(),                   // vector 的连续内存起始位置
          offsets.size() * sizeof(uint16_t) // 总字节数
@@ -30,75 +30,101 @@ std::vector<uint8_t> Block::encode() {
 
   // 3. 写入元素个数
   size_t num_pos =
-      data.size() * sizeof(uint8_t) + offsets.size() * sizeof(uint16_t);
+      data_size() * sizeof(uint8_t) + offsets.size() * sizeof(uint16_t);
   uint16_t num_elements = offsets.size();
   memcpy(encoded.data() + num_pos, &num_elements, sizeof(uint16_t));
 
   return encoded;
 }
 
-std::shared_ptr<Block> Block::decode(const std::vector<uint8_t> &encoded,
-                                     bool with_hash) {
-  // 使用 make_shared 创建对象
-  auto block = std::make_shared<Block>();
-
+size_t Block::decode_offsets(const uint8_t *encoded, size_t size,
+                             bool with_hash, Block &block) {
   // 1. 安全性检查
-  if (encoded.size() < sizeof(uint16_t)) {
+  size_t min_size = sizeof(uint16_t) + (with_hash ? sizeof(uint32_t) : 0);
+  if (size < min_size) {
     throw std::runtime_error("Encoded data too small");
   }
 
   // 2. 读取元素个数
   uint16_t num_elements;
-  size_t num_elements_pos = encoded.size() - sizeof(uint16_t);
+  size_t num_elements_pos = size - sizeof(uint16_t);
   if (with_hash) {
     num_elements_pos -= sizeof(uint32_t);
-    auto hash_pos = encoded.size() - sizeof(uint32_t);
+    auto hash_pos = size - sizeof(uint32_t);
     uint32_t hash_value;
-    memcpy(&hash_value, encoded.data() + hash_pos, sizeof(uint32_t));
+    memcpy(&hash_value, encoded + hash_pos, sizeof(uint32_t));
 
-    uint32_t compute_hash = std::hash<std::string_view>{}(
-        std::string_view(reinterpret_cast<const char *>(encoded.data()),
-                         encoded.size() - sizeof(uint32_t)));
+    uint32_t compute_hash = std::hash<std::string_view>{}(std::string_view(
+        reinterpret_cast<const char *>(encoded), size - sizeof(uint32_t)));
     if (hash_value != compute_hash) {
       throw std::runtime_error("Block hash verification failed");
     }
   }
-  memcpy(&num_elements, encoded.data() + num_elements_pos, sizeof(uint16_t));
+  memcpy(&num_elements, encoded + num_elements_pos, sizeof(uint16_t));
 
   // 3. 验证数据大小
-  size_t required_size = sizeof(uint16_t) + num_elements * sizeof(uint16_t);
-  if (encoded.size() < required_size) {
+  size_t required_size = num_elements * sizeof(uint16_t);
+  if (num_elements_pos < required_size) {
     throw std::runtime_error("Invalid encoded data size");
   }
 
   // 4. 计算各段位置
-  size_t offsets_section_start =
-      num_elements_pos - num_elements * sizeof(uint16_t);
+  size_t offsets_section_start = num_elements_pos - required_size;
 
   // 5. 读取偏移数组
-  block->offsets.resize(num_elements);
-  memcpy(block->offsets.data(), encoded.data() + offsets_section_start,
+  block.offsets.resize(num_elements);
+  memcpy(block.offsets.data(), encoded + offsets_section_start,
          num_elements * sizeof(uint16_t));
 
-  // 6. 复制数据段
-  block->data.reserve(offsets_section_start); // 优化内存分配
-  block->data.assign(encoded.begin(), encoded.begin() + offsets_section_start);
+  return offsets_section_start;
+}
+
+std::shared_ptr<Block> Block::decode(const std::vector<uint8_t> &encoded,
+                                     bool with_hash) {
+  // 使用 make_shared 创建对象
+  auto block = std::make_shared<Block>();
+  size_t data_len =
+      decode_offsets(encoded.data(), encoded.size(), with_hash, *block);
+
+  // 复制数据段
+  block->data.assign(encoded.begin(), encoded.begin() + data_len);
+  return block;
+}
+
+std::shared_ptr<Block> Block::decode(std::vector<uint8_t> &&encoded,
+                                     bool with_hash) {
+  auto block = std::make_shared<Block>();
+  size_t data_len =
+      decode_offsets(encoded.data(), encoded.size(), with_hash, *block);
+
+  // 截掉偏移数组和尾部之后直接作为数据段
+  encoded.resize(data_len);
+  block->data = std::move(encoded);
+  return block;
+}
 
+std::shared_ptr<Block> Block::decode_view(const uint8_t *encoded, size_t size,
+                                          bool with_hash,
+                                          std::shared_ptr<const void> owner) {
+  auto block = std::make_shared<Block>();
+  block->view_size_ = decode_offsets(encoded, size, with_hash, *block);
+  block->view_ = encoded;
+  block->view_owner_ = std::move(owner);
   return block;
 }
 
 std::string Block::get_first_key() {
-  if (data.empty() || offsets.empty()) {
+  if (data_size() == 0 || offsets.empty()) {
     return "";
   }
 
   // 读取第一个key的长度（前2字节）
   uint16_t key_len;
-  memcpy(&key_len, data.data(), sizeof(uint16_t));
+  memcpy(&key_len, data_ptr(), sizeof(uint16_t));
 
   // 读取key
-  std::string key(reinterpret_cast<char *>(data.data() + sizeof(uint16_t)),
-                  key_len);
+  std::string key(
+      reinterpret_cast<const char *>(data_ptr() + sizeof(uint16_t)), key_len);
   return key;
 }
 
@@ -111,6 +137,9 @@ size_t Block::get_offset_at(size_t idx) const {
 
 bool Block::add_entry(const std::string &key, const std::string &value,
                       uint64_t tranc_id, bool force_write) {
+  if (view_ != nullptr) {
+    throw std::logic_error("Cannot add entry to a read-only block view");
+  }
   if (!force_write &&
       (cur_size() + key.size() + value.size() + 3 * sizeof(uint16_t) +
            sizeof(uint64_t) >
@@ -154,9 +183,9 @@ bool Block::add_entry(const std::string &key, const std::string &value,
 // 从指定偏移量获取entry的key
 std::string Block::get_key_at(size_t offset) const {
   uint16_t key_len;
-  memcpy(&key_len, data.data() + offset, sizeof(uint16_t));
+  memcpy(&key_len, data_ptr() + offset, sizeof(uint16_t));
   return std::string(
-      reinterpret_cast<const char *>(data.data() + offset + sizeof(uint16_t)),
+      reinterpret_cast<const char *>(data_ptr() + offset + sizeof(uint16_t)),
       key_len);
 }
 
@@ -164,33 +193,33 @@ std::string Block::get_key_at(size_t offset) const {
 std::string Block::get_value_at(size_t offset) const {
   // 先获取key长度
   uint16_t key_len;
-  memcpy(&key_len, data.data() + offset, sizeof(uint16_t));
+  memcpy(&key_len, data_ptr() + offset, sizeof(uint16_t));
 
   // 计算value长度的位置
   size_t value_len_pos = offset + sizeof(uint16_t) + key_len;
   uint16_t value_len;
-  memcpy(&value_len, data.data() + value_len_pos, sizeof(uint16_t));
+  memcpy(&value_len, data_ptr() + value_len_pos, sizeof(uint16_t));
 
   // 返回value
   return std::string(reinterpret_cast<const char *>(
-                         data.data() + value_len_pos + sizeof(uint16_t)),
+                         data_ptr() + value_len_pos + sizeof(uint16_t)),
                      value_len);
 }
 
-uint16_t Block::get_tranc_id_at(size_t offset) const {
+uint64_t Block::get_tranc_id_at(size_t offset) const {
   // 先获取key长度
   uint16_t key_len;
-  memcpy(&key_len, data.data() + offset, sizeof(uint16_t));
+  memcpy(&key_len, data_ptr() + offset, sizeof(uint16_t));
 
   // 计算value长度的位置
   size_t value_len_pos = offset + sizeof(uint16_t) + key_len;
   uint16_t value_len;
-  memcpy(&value_len, data.data() + value_len_pos, sizeof(uint16_t));
+  memcpy(&value_len, data_ptr() + value_len_pos, sizeof(uint16_t));
 
   // 计算事务id的位置
   size_t tranc_id_pos = value_len_pos + sizeof(uint16_t) + value_len;
   uint64_t tranc_id;
-  memcpy(&tranc_id, data.data() + tranc_id_pos, sizeof(uint64_t));
+  memcpy(&tranc_id, data_ptr() + tranc_id_pos, sizeof(uint64_t));
   return tranc_id;
 }
 
@@ -373,7 +402,12 @@ Block::Entry Block::get_entry_at(size_t offset) const {
 size_t Block::size() const { return offsets.size(); }
 
 size_t Block::cur_size() const {
-  return data.size() + offsets.size() * sizeof(uint16_t) + sizeof(uint16_t);
+  return data_size() + offsets.size() * sizeof(uint16_t) + sizeof(uint16_t);
+}
+
+size_t Block::memory_usage() const {
+  size_t data_bytes = view_ != nullptr ? 0 : data.capacity();
+  return sizeof(Block) + data_bytes + offsets.capacity() * sizeof(uint16_t);
 }
 
 bool Block::is_empty() const { return offsets.empty(); }
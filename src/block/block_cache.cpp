@@ -1,5 +1,6 @@
 #include "../../include/block/block_cache.h"
 #include "../../include/block/block.h"
+#include "../../include/block/secondary_cache.h"
 #include <chrono>
 #include <list>
 #include <memory>
@@ -7,86 +8,225 @@
 #include <unordered_map>
 
 namespace toni_lsm {
-BlockCache::BlockCache(size_t capacity, size_t k)
-    : capacity_(capacity), k_(k) {}
+BlockCache::BlockCache(size_t capacity, size_t k, size_t shard_bits,
+                       bool tiny_lfu)
+    : capacity_(capacity), k_(k) {
+  // 保证每个分片至少有 kMinShardCapacity 字节的容量
+  while (shard_bits > 0 && (capacity >> shard_bits) < kMinShardCapacity) {
+    --shard_bits;
+  }
+  size_t num_shards = static_cast<size_t>(1) << shard_bits;
+  shard_mask_ = num_shards - 1;
+  shards_ = std::vector<Shard>(num_shards);
+  // 余数分给前面的分片, 各分片容量之和等于总容量
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_[i].capacity = capacity / num_shards + (i < capacity % num_shards);
+    if (tiny_lfu) {
+      shards_[i].sketch = std::make_unique<FrequencySketch>(
+          shards_[i].capacity / kSketchBytesPerEntry);
+    }
+  }
+}
 
 BlockCache::~BlockCache() = default;
 
 std::shared_ptr<Block> BlockCache::get(int sst_id, int block_id) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  ++total_requests_; // 增加总请求数
   auto key = std::make_pair(sst_id, block_id);
-  auto it = cache_map_.find(key);
-  if (it == cache_map_.end()) {
+  size_t hash = key_hash{}(key);
+  Shard &shard = shard_for(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  ++shard.total_requests_; // 增加总请求数
+  if (shard.sketch != nullptr) {
+    // 命中和未命中都计入访问频率
+    shard.sketch->increment(hash);
+  }
+  auto it = shard.cache_map_.find(key);
+  if (it == shard.cache_map_.end()) {
     return nullptr; // 缓存未命中
   }
 
-  ++hit_requests_; // 增加命中请求数
+  ++shard.hit_requests_; // 增加命中请求数
   // 更新访问次数
-  update_access_count(it->second);
+  update_access_count(shard, it->second);
 
   return it->second->cache_block;
 }
 
-void BlockCache::put(int sst_id, int block_id, std::shared_ptr<Block> block) {
-  std::lock_guard<std::mutex> lock(mutex_);
+void BlockCache::put(int sst_id, int block_id, std::shared_ptr<Block> block,
+                     uint64_t file_id) {
   auto key = std::make_pair(sst_id, block_id);
-  auto it = cache_map_.find(key);
+  size_t hash = key_hash{}(key);
+  Shard &shard = shard_for(hash);
+  std::vector<CacheItem> evicted;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    put_locked(shard, key, hash, std::move(block), file_id, evicted);
+  }
+  // 二级缓存需要加锁入队, 不能持有分片的锁
+  for (auto &item : evicted) {
+    if (item.file_id == 0) {
+      continue;
+    }
+    secondary_->insert(item.sst_id, item.block_id, item.file_id,
+                       std::move(item.cache_block));
+  }
+}
 
-  if (it != cache_map_.end()) {
+void BlockCache::put_locked(Shard &shard, const std::pair<int, int> &key,
+                            size_t hash, std::shared_ptr<Block> block,
+                            uint64_t file_id,
+                            std::vector<CacheItem> &evicted) {
+  auto it = shard.cache_map_.find(key);
+  size_t charge = entry_charge(block);
+  if (it != shard.cache_map_.end()) {
     // 更新已有缓存项
     // ! 照理说 Block 类的数据是不可变的，这里的更新分支应该不会存在,
     // 只是debug用
+    shard.usage = shard.usage - it->second->charge + charge;
     it->second->cache_block = block;
-    update_access_count(it->second);
+    it->second->charge = charge;
+    it->second->file_id = file_id;
+    update_access_count(shard, it->second);
+    evict_until(shard, shard.capacity, evicted);
   } else {
-    // 插入新缓存项
-    if (cache_map_.size() >= capacity_) {
-      // 移除最久未使用的缓存项
-      if (!cache_list_less_k.empty()) {
-        // 优先从 cache_list_less_k 中移除
-        cache_map_.erase(std::make_pair(cache_list_less_k.back().sst_id,
-                                        cache_list_less_k.back().block_id));
-        cache_list_less_k.pop_back();
-      } else {
-        cache_map_.erase(std::make_pair(cache_list_greater_k.back().sst_id,
-                                        cache_list_greater_k.back().block_id));
-        cache_list_greater_k.pop_back();
+    // 超过整个分片容量的 block 不缓存, 否则会清空分片
+    if (charge > shard.capacity) {
+      return;
+    }
+    if (shard.sketch != nullptr && !admit(shard, hash, charge)) {
+      return;
+    }
+    // 插入新缓存项, 先腾出足够的空间
+    evict_until(shard, shard.capacity - charge, evicted);
+
+    CacheItem item = {key.first, key.second, block, 1, charge, file_id};
+    shard.cache_list_less_k.push_front(item);
+    shard.cache_map_[key] = shard.cache_list_less_k.begin();
+    shard.usage += charge;
+  }
+}
+
+void BlockCache::evict_until(Shard &shard, size_t target,
+                             std::vector<CacheItem> &evicted) {
+  while (shard.usage > target && !shard.cache_map_.empty()) {
+    // 移除最久未使用的缓存项, 优先从 cache_list_less_k 中移除
+    auto &victims = shard.cache_list_less_k.empty()
+                        ? shard.cache_list_greater_k
+                        : shard.cache_list_less_k;
+    shard.usage -= victims.back().charge;
+    shard.cache_map_.erase(
+        std::make_pair(victims.back().sst_id, victims.back().block_id));
+    if (secondary_ != nullptr) {
+      evicted.push_back(std::move(victims.back()));
+    }
+    victims.pop_back();
+  }
+}
+
+bool BlockCache::admit(Shard &shard, size_t hash, size_t charge) const {
+  if (shard.usage + charge <= shard.capacity) {
+    return true;
+  }
+  uint32_t freq = shard.sketch->estimate(hash);
+  // 按照 evict_until 的顺序检查将被淘汰的缓存项
+  size_t usage = shard.usage;
+  for (auto *victims :
+       {&shard.cache_list_less_k, &shard.cache_list_greater_k}) {
+    for (auto it = victims->rbegin(); it != victims->rend(); ++it) {
+      uint64_t victim_hash =
+          key_hash{}(std::make_pair(it->sst_id, it->block_id));
+      if (shard.sketch->estimate(victim_hash) >= freq) {
+        return false;
+      }
+      usage -= it->charge;
+      if (usage + charge <= shard.capacity) {
+        return true;
       }
     }
+  }
+  return true;
+}
 
-    CacheItem item = {sst_id, block_id, block, 1};
-    cache_list_less_k.push_front(item);
-    cache_map_[key] = cache_list_less_k.begin();
+bool BlockCache::contains(int sst_id, int block_id) const {
+  auto key = std::make_pair(sst_id, block_id);
+  const Shard &shard = shard_for(key_hash{}(key));
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  return shard.cache_map_.contains(key);
+}
+
+std::vector<std::pair<int, int>>
+BlockCache::hot_keys(size_t max_entries) const {
+  std::vector<std::pair<int, int>> keys;
+  // 每个分片取相同的数量, 避免结果集中在前面的分片
+  size_t per_shard = (max_entries + shards_.size() - 1) / shards_.size();
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    size_t taken = 0;
+    for (const auto *items :
+         {&shard.cache_list_greater_k, &shard.cache_list_less_k}) {
+      for (auto it = items->begin(); it != items->end() && taken < per_shard;
+           ++it, ++taken) {
+        keys.emplace_back(it->sst_id, it->block_id);
+      }
+    }
+  }
+  if (keys.size() > max_entries) {
+    keys.resize(max_entries);
+  }
+  return keys;
+}
+
+size_t BlockCache::usage() const {
+  size_t usage = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    usage += shard.usage;
   }
+  return usage;
+}
+
+size_t BlockCache::entry_charge(const std::shared_ptr<Block> &block) {
+  // 缓存项在链表节点和哈希表节点中各有一份开销,
+  // 外加 make_shared 分配的控制块
+  constexpr size_t kEntryOverhead =
+      sizeof(CacheItem) + 2 * sizeof(void *) +
+      sizeof(std::pair<std::pair<int, int>, std::list<CacheItem>::iterator>) +
+      2 * sizeof(void *) + 2 * sizeof(long);
+  return kEntryOverhead + (block != nullptr ? block->memory_usage() : 0);
 }
 
 double BlockCache::hit_rate() const {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return total_requests_ == 0
+  size_t total_requests = 0;
+  size_t hit_requests = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    total_requests += shard.total_requests_;
+    hit_requests += shard.hit_requests_;
+  }
+  return total_requests == 0
              ? 0.0
-             : static_cast<double>(hit_requests_) / total_requests_;
+             : static_cast<double>(hit_requests) / total_requests;
 }
 
-void BlockCache::update_access_count(std::list<CacheItem>::iterator it) {
+void BlockCache::update_access_count(Shard &shard,
+                                     std::list<CacheItem>::iterator it) {
   ++it->access_count;
   if (it->access_count < k_) {
     // 更新后仍然位于cache_list_less_k
     // 重新置于cache_list_less_k头部
-    cache_list_less_k.splice(cache_list_less_k.begin(), cache_list_less_k, it);
+    shard.cache_list_less_k.splice(shard.cache_list_less_k.begin(),
+                                   shard.cache_list_less_k, it);
   } else if (it->access_count == k_) {
     // 更新后满足k次访问, 升级链表
     // 从 cache_list_less_k 移动到 cache_list_greater_k 头部
-    auto item = *it;
-    cache_list_less_k.erase(it);
-    cache_list_greater_k.push_front(item);
-    cache_map_[std::make_pair(item.sst_id, item.block_id)] =
-        cache_list_greater_k.begin();
+    // splice 不会使迭代器失效, 哈希表中的索引无需更新
+    shard.cache_list_greater_k.splice(shard.cache_list_greater_k.begin(),
+                                      shard.cache_list_less_k, it);
   } else if (it->access_count > k_) {
     // 本来就位于 cache_list_greater_k
     // 移动到 cache_list_greater_k 头部
-    cache_list_greater_k.splice(cache_list_greater_k.begin(),
-                                cache_list_greater_k, it);
+    shard.cache_list_greater_k.splice(shard.cache_list_greater_k.begin(),
+                                      shard.cache_list_greater_k, it);
   }
 }
-} // namespace toni_lsm
\ No newline at end of file
+} // namespace toni_lsm
@@ -0,0 +1,66 @@
+#include "../../include/block/block_index.h"
+#include <algorithm>
+
+namespace toni_lsm {
+
+BlockIndex::BlockIndex(const std::vector<BlockMeta> &meta_entries) {
+  if (meta_entries.empty()) {
+    return;
+  }
+  first_key_ = meta_entries.front().first_key;
+  block_offsets_.reserve(meta_entries.size());
+  key_offsets_.reserve(meta_entries.size() + 1);
+  for (size_t i = 0; i < meta_entries.size(); i++) {
+    block_offsets_.push_back(meta_entries[i].offset);
+    key_offsets_.push_back(arena_.size());
+    if (i + 1 < meta_entries.size()) {
+      arena_ += shortest_separator(meta_entries[i].last_key,
+                                   meta_entries[i + 1].first_key);
+    } else {
+      arena_ += meta_entries[i].last_key;
+    }
+  }
+  key_offsets_.push_back(arena_.size());
+  arena_.shrink_to_fit();
+}
+
+size_t BlockIndex::find(std::string_view key, size_t begin) const {
+  size_t left = begin;
+  size_t right = size();
+  while (left < right) {
+    size_t mid = (left + right) / 2;
+    if (separator(mid) < key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+size_t BlockIndex::memory_usage() const {
+  return sizeof(BlockIndex) + first_key_.capacity() + arena_.capacity() +
+         (block_offsets_.capacity() + key_offsets_.capacity()) *
+             sizeof(uint32_t);
+}
+
+std::string BlockIndex::shortest_separator(std::string_view a,
+                                           std::string_view b) {
+  size_t min_len = std::min(a.size(), b.size());
+  size_t diff = 0;
+  while (diff < min_len && a[diff] == b[diff]) {
+    diff++;
+  }
+  if (diff < min_len) {
+    // 第一个不同的字节加一之后仍然小于 b, 截断到这里即可
+    uint8_t byte = static_cast<uint8_t>(a[diff]);
+    if (byte < 0xff && byte + 1 < static_cast<uint8_t>(b[diff])) {
+      std::string sep(a.substr(0, diff + 1));
+      sep[diff] = static_cast<char>(byte + 1);
+      return sep;
+    }
+  }
+  // a 是 b 的前缀, 或者无法缩短
+  return std::string(a);
+}
+} // namespace toni_lsm
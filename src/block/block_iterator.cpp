@@ -92,6 +92,10 @@ BlockIterator::value_type BlockIterator::operator*() const {
 
 bool BlockIterator::is_end() { return current_index == block->offsets.size(); }
 
+uint64_t BlockIterator::get_cur_tranc_id() const {
+  return block->get_tranc_id_at(block->get_offset_at(current_index));
+}
+
 void BlockIterator::update_current() const {
   if (!cached_value && current_index < block->offsets.size()) {
     size_t offset = block->get_offset_at(current_index);
@@ -0,0 +1,364 @@
+#include "../../include/block/secondary_cache.h"
+#include "spdlog/spdlog.h"
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+namespace toni_lsm {
+
+namespace {
+struct RecordHeader {
+  int sst_id;
+  int block_id;
+  uint32_t size;
+  uint64_t seq;
+  uint64_t file_id;
+  uint32_t checksum;
+};
+
+uint32_t hash_bytes(const uint8_t *data, size_t size) {
+  return std::hash<std::string_view>{}(
+      std::string_view(reinterpret_cast<const char *>(data), size));
+}
+
+size_t align_up(size_t value) {
+  return (value + SecondaryCache::kAlignment - 1) &
+         ~(SecondaryCache::kAlignment - 1);
+}
+
+void encode_header(const RecordHeader &header, uint8_t *buf) {
+  uint32_t magic = SecondaryCache::kMagic;
+  memcpy(buf, &magic, sizeof(uint32_t));
+  memcpy(buf + 4, &header.sst_id, sizeof(int));
+  memcpy(buf + 8, &header.block_id, sizeof(int));
+  memcpy(buf + 12, &header.size, sizeof(uint32_t));
+  memcpy(buf + 16, &header.seq, sizeof(uint64_t));
+  memcpy(buf + 24, &header.file_id, sizeof(uint64_t));
+  memcpy(buf + 32, &header.checksum, sizeof(uint32_t));
+  uint32_t header_hash = hash_bytes(buf, 36);
+  memcpy(buf + 36, &header_hash, sizeof(uint32_t));
+}
+
+bool decode_header(const uint8_t *buf, RecordHeader &header) {
+  uint32_t magic;
+  uint32_t header_hash;
+  memcpy(&magic, buf, sizeof(uint32_t));
+  memcpy(&header_hash, buf + 36, sizeof(uint32_t));
+  if (magic != SecondaryCache::kMagic || header_hash != hash_bytes(buf, 36)) {
+    return false;
+  }
+  memcpy(&header.sst_id, buf + 4, sizeof(int));
+  memcpy(&header.block_id, buf + 8, sizeof(int));
+  memcpy(&header.size, buf + 12, sizeof(uint32_t));
+  memcpy(&header.seq, buf + 16, sizeof(uint64_t));
+  memcpy(&header.file_id, buf + 24, sizeof(uint64_t));
+  memcpy(&header.checksum, buf + 32, sizeof(uint32_t));
+  return true;
+}
+} // namespace
+
+SecondaryCache::SecondaryCache(const std::string &path, size_t capacity)
+    : path_(path), capacity_(capacity) {
+  if (!file_.open(path, !std::filesystem::exists(path))) {
+    throw std::runtime_error("Failed to open secondary cache file " + path);
+  }
+  recover();
+  writer_thread_ = std::thread(&SecondaryCache::writer_worker, this);
+}
+
+SecondaryCache::~SecondaryCache() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  if (writer_thread_.joinable()) {
+    writer_thread_.join();
+  }
+}
+
+void SecondaryCache::recover() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t file_size = std::min(file_.size(), capacity_);
+  uint64_t max_seq = 0;
+  uint8_t buf[kHeaderSize];
+  size_t pos = 0;
+  while (pos + kHeaderSize <= file_size) {
+    file_.read(pos, kHeaderSize, buf);
+    RecordHeader header;
+    if (!decode_header(buf, header) ||
+        pos + kHeaderSize + header.size > file_size) {
+      // 被新记录覆盖了一部分的旧记录, 跳到下一个对齐位置继续查找
+      pos += kAlignment;
+      continue;
+    }
+    size_t length = align_up(kHeaderSize + header.size);
+    auto key = std::make_pair(header.sst_id, header.block_id);
+    auto it = index_.find(key);
+    if (it == index_.end() || it->second.seq < header.seq) {
+      if (it != index_.end()) {
+        erase_locked(by_offset_.find(it->second.offset));
+      }
+      // block 数据在读取时才校验, 避免启动时读完整个文件
+      index_[key] = Location{pos, length, header.size, header.seq,
+                             header.file_id, true};
+      by_offset_[pos] = key;
+      usage_ += length;
+    }
+    if (header.seq > max_seq) {
+      max_seq = header.seq;
+      write_offset_ = pos + length;
+    }
+    pos += length;
+  }
+  next_seq_ = max_seq + 1;
+
+  spdlog::info("SecondaryCache--"
+               "Recovered {} blocks ({} bytes) from {}",
+               index_.size(), usage_, path_);
+}
+
+void SecondaryCache::insert(int sst_id, int block_id, uint64_t file_id,
+                            std::shared_ptr<Block> block) {
+  {
+    // block 不可变, 已经写入过的不需要再次写入
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.contains(std::make_pair(sst_id, block_id))) {
+      return;
+    }
+  }
+
+  // 文件 io 交给后台线程, 调用方通常是刚刚读取了 block 的前台线程
+  size_t size = BlockCache::entry_charge(block);
+  {
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    if (stop_ || pending_bytes_ + size > kMaxPendingBytes) {
+      ++dropped_;
+      return;
+    }
+    queue_.push_back(
+        PendingWrite{sst_id, block_id, file_id, std::move(block), size});
+    pending_bytes_ += size;
+  }
+  queue_cv_.notify_one();
+}
+
+void SecondaryCache::writer_worker() {
+  while (true) {
+    PendingWrite write;
+    {
+      std::unique_lock<std::mutex> lock(queue_mtx_);
+      queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break;
+      }
+      write = std::move(queue_.front());
+      queue_.pop_front();
+      writing_ = true;
+    }
+    try {
+      write_record(write);
+    } catch (const std::exception &e) {
+      spdlog::warn("SecondaryCache--"
+                   "Failed to write block ({}, {}): {}",
+                   write.sst_id, write.block_id, e.what());
+    }
+    {
+      std::lock_guard<std::mutex> lock(queue_mtx_);
+      pending_bytes_ -= write.size;
+      writing_ = false;
+    }
+    idle_cv_.notify_all();
+  }
+}
+
+void SecondaryCache::wait_for_pending() {
+  std::unique_lock<std::mutex> lock(queue_mtx_);
+  idle_cv_.wait(lock, [this] { return queue_.empty() && !writing_; });
+}
+
+void SecondaryCache::write_record(const PendingWrite &write) {
+  auto key = std::make_pair(write.sst_id, write.block_id);
+  auto data = write.block->encode();
+  size_t record_size = kHeaderSize + data.size();
+  size_t length = align_up(record_size);
+  if (length > capacity_) {
+    return;
+  }
+
+  // 预留写入区间, 文件 io 在锁外进行
+  size_t offset;
+  uint64_t seq;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.contains(key)) {
+      return;
+    }
+    if (write_offset_ + length > capacity_) {
+      write_offset_ = 0;
+    }
+    offset = write_offset_;
+    evict_range_locked(offset, length);
+    seq = next_seq_++;
+    index_[key] = Location{offset, length,
+                           static_cast<uint32_t>(data.size()), seq,
+                           write.file_id, false};
+    by_offset_[offset] = key;
+    usage_ += length;
+    write_offset_ = offset + length;
+  }
+
+  std::vector<uint8_t> record(record_size);
+  RecordHeader header{write.sst_id,
+                      write.block_id,
+                      static_cast<uint32_t>(data.size()),
+                      seq,
+                      write.file_id,
+                      hash_bytes(data.data(), data.size())};
+  encode_header(header, record.data());
+  memcpy(record.data() + kHeaderSize, data.data(), data.size());
+  bool ok = file_.write(offset, record.data(), record.size());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end() || it->second.seq != seq) {
+    // 写入期间区间已经被回绕的写入覆盖, 或者缓存被清空
+    return;
+  }
+  if (ok) {
+    it->second.ready = true;
+  } else {
+    spdlog::warn("SecondaryCache--"
+                 "Failed to write block ({}, {}) to {}",
+                 write.sst_id, write.block_id, path_);
+    erase_locked(by_offset_.find(offset));
+  }
+}
+
+std::shared_ptr<Block> SecondaryCache::lookup(int sst_id, int block_id,
+                                              uint64_t file_id,
+                                              size_t encoded_size) {
+  ++total_requests_;
+  auto key = std::make_pair(sst_id, block_id);
+  Location loc;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end() || !it->second.ready) {
+      return nullptr;
+    }
+    if (it->second.file_id != file_id) {
+      // sst_id 被另一个文件复用, 这条记录不会再被命中
+      erase_locked(by_offset_.find(it->second.offset));
+      return nullptr;
+    }
+    loc = it->second;
+  }
+  if (encoded_size != 0 && loc.size != encoded_size) {
+    return nullptr;
+  }
+
+  std::vector<uint8_t> buf(kHeaderSize + loc.size);
+  RecordHeader header;
+  bool valid = false;
+  try {
+    file_.read(loc.offset, buf.size(), buf.data());
+    // 读取期间记录可能被覆盖, 序号不同或者校验失败都视为未命中
+    valid = decode_header(buf.data(), header) && header.sst_id == sst_id &&
+            header.block_id == block_id && header.seq == loc.seq &&
+            header.file_id == file_id && header.size == loc.size &&
+            header.checksum == hash_bytes(buf.data() + kHeaderSize, loc.size);
+  } catch (const std::exception &e) {
+    spdlog::warn("SecondaryCache--"
+                 "Failed to read block ({}, {}): {}",
+                 sst_id, block_id, e.what());
+  }
+
+  std::shared_ptr<Block> block;
+  if (valid) {
+    buf.erase(buf.begin(), buf.begin() + kHeaderSize);
+    try {
+      block = Block::decode(std::move(buf), false);
+    } catch (const std::exception &) {
+      block = nullptr;
+    }
+  }
+  if (block == nullptr) {
+    // 记录已经损坏, 从索引中移除
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end() && it->second.seq == loc.seq) {
+      erase_locked(by_offset_.find(loc.offset));
+    }
+    return nullptr;
+  }
+  ++hit_requests_;
+  return block;
+}
+
+void SecondaryCache::clear() {
+  {
+    // 丢弃尚未写入的 block, 并等待正在进行的写入结束
+    std::unique_lock<std::mutex> lock(queue_mtx_);
+    for (auto &write : queue_) {
+      pending_bytes_ -= write.size;
+    }
+    queue_.clear();
+    idle_cv_.wait(lock, [this] { return !writing_; });
+  }
+  idle_cv_.notify_all();
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_.clear();
+  by_offset_.clear();
+  usage_ = 0;
+  write_offset_ = 0;
+  // 截断文件, 重启后不会恢复出旧记录
+  if (::ftruncate(file_.fd(), 0) == -1) {
+    spdlog::error("SecondaryCache--"
+                  "Failed to truncate {}",
+                  path_);
+  }
+}
+
+void SecondaryCache::evict_range_locked(size_t offset, size_t length) {
+  auto it = by_offset_.lower_bound(offset);
+  if (it != by_offset_.begin()) {
+    auto prev = std::prev(it);
+    if (prev->first + index_.at(prev->second).length > offset) {
+      erase_locked(prev);
+    }
+  }
+  while (it != by_offset_.end() && it->first < offset + length) {
+    it = erase_locked(it);
+  }
+}
+
+std::map<size_t, std::pair<int, int>>::iterator SecondaryCache::erase_locked(
+    std::map<size_t, std::pair<int, int>>::iterator it) {
+  auto index_it = index_.find(it->second);
+  usage_ -= index_it->second.length;
+  index_.erase(index_it);
+  return by_offset_.erase(it);
+}
+
+size_t SecondaryCache::usage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return usage_;
+}
+
+size_t SecondaryCache::entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.size();
+}
+
+double SecondaryCache::hit_rate() const {
+  size_t total_requests = total_requests_.load();
+  return total_requests == 0
+             ? 0.0
+             : static_cast<double>(hit_requests_.load()) / total_requests;
+}
+} // namespace toni_lsm
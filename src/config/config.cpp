@@ -8,14 +8,42 @@ namespace toni_lsm {
 // Private helper to set all default values
 void TomlConfig::setDefaultValues() {
   // --- LSM Core ---
-  lsm_tol_mem_size_limit_ = 67108864; // Default: 64 * 1024 * 1024
-  lsm_per_mem_size_limit_ = 4194304;  // Default: 4 * 1024 * 1024
-  lsm_block_size_ = 32768;            // Default: 32 * 1024
-  lsm_sst_level_ratio_ = 4;           // Default: 4
+  lsm_tol_mem_size_limit_ = 67108864;              // Default: 64 * 1024 * 1024
+  lsm_per_mem_size_limit_ = 4194304;               // Default: 4 * 1024 * 1024
+  lsm_block_size_ = 32768;                         // Default: 32 * 1024
+  lsm_sst_level_ratio_ = 4;                        // Default: 4
+  lsm_max_immutable_memtables_ = 32;               // Default: 32
+  lsm_compaction_threads_ = 2;                     // Default: 2
+  lsm_max_subcompactions_ = 4;                     // Default: 4
+  lsm_multiget_threads_ = 4;                       // Default: 4
+  lsm_multiget_min_keys_per_task_ = 64;            // Default: 64
+  lsm_l0_slowdown_writes_trigger_ = 20;            // Default: 20
+  lsm_l0_stop_writes_trigger_ = 36;                // Default: 36
+  lsm_soft_pending_compaction_bytes_ = 268435456;  // Default: 256MB
+  lsm_hard_pending_compaction_bytes_ = 1073741824; // Default: 1GB
+  lsm_delayed_write_rate_ = 16777216;              // Default: 16MB/s
+  lsm_max_manifest_file_size_ = 4194304;           // Default: 4MB
 
   // --- LSM Cache ---
-  lsm_block_cache_capacity_ = 1024; // Default: 1024
-  lsm_block_cache_k_ = 8;           // Default: 8
+  lsm_block_cache_capacity_ = 33554432;    // Default: 32MB
+  lsm_block_cache_k_ = 8;                  // Default: 8
+  lsm_block_cache_shard_bits_ = 4;         // Default: 4
+  lsm_block_cache_tiny_lfu_ = true;        // Default: true
+  lsm_row_cache_capacity_ = 0;             // Default: 0 (disabled)
+  lsm_secondary_cache_capacity_ = 0;       // Default: 0 (disabled)
+  lsm_secondary_cache_path_ = "";          // Default: <data dir>
+  lsm_hot_blocks_max_entries_ = 8192;      // Default: 8192
+  lsm_hot_blocks_persist_interval_ = 60;   // Default: 60 seconds
+  lsm_table_cache_max_open_files_ = 1024;  // Default: 1024
+  lsm_table_cache_capacity_ = 67108864;    // Default: 64MB
+  lsm_pin_index_filter_max_level_ = 1;     // Default: 1 (L0 and L1)
+  lsm_sst_use_mmap_ = false;               // Default: false
+
+  // --- LSM IO ---
+  lsm_io_uring_queue_depth_ = 64;             // Default: 64
+  lsm_readahead_blocks_ = 8;                  // Default: 8
+  lsm_sst_use_direct_io_ = false;             // Default: false
+  lsm_direct_io_buffer_pool_size_ = 16777216; // Default: 16MB
 
   // --- Redis Headers/Separators ---
   redis_expire_header_ = "REDIS_EXPIRE_";
@@ -69,13 +97,78 @@ bool TomlConfig::loadFromFile(const std::string &filePath) {
         core_config.at("LSM_PER_MEM_SIZE_LIMIT").as_integer();
     lsm_block_size_ = core_config.at("LSM_BLOCK_SIZE").as_integer();
     lsm_sst_level_ratio_ = core_config.at("LSM_SST_LEVEL_RATIO").as_integer();
+    lsm_max_immutable_memtables_ =
+        core_config.at("LSM_MAX_IMMUTABLE_MEMTABLES").as_integer();
+    lsm_compaction_threads_ =
+        core_config.at("LSM_COMPACTION_THREADS").as_integer();
+    lsm_max_subcompactions_ =
+        core_config.at("LSM_MAX_SUBCOMPACTIONS").as_integer();
+    lsm_multiget_threads_ =
+        core_config.at("LSM_MULTIGET_THREADS").as_integer();
+    lsm_multiget_min_keys_per_task_ =
+        core_config.at("LSM_MULTIGET_MIN_KEYS_PER_TASK").as_integer();
+    lsm_l0_slowdown_writes_trigger_ =
+        core_config.at("LSM_L0_SLOWDOWN_WRITES_TRIGGER").as_integer();
+    lsm_l0_stop_writes_trigger_ =
+        core_config.at("LSM_L0_STOP_WRITES_TRIGGER").as_integer();
+    lsm_soft_pending_compaction_bytes_ =
+        core_config.at("LSM_SOFT_PENDING_COMPACTION_BYTES").as_integer();
+    lsm_hard_pending_compaction_bytes_ =
+        core_config.at("LSM_HARD_PENDING_COMPACTION_BYTES").as_integer();
+    lsm_delayed_write_rate_ =
+        core_config.at("LSM_DELAYED_WRITE_RATE").as_integer();
+    lsm_max_manifest_file_size_ =
+        core_config.at("LSM_MAX_MANIFEST_FILE_SIZE").as_integer();
 
     // --- Load LSM Cache ---
     auto cache_config = config["lsm"]["cache"];
 
-    lsm_block_cache_capacity_ =
-        cache_config.at("LSM_BLOCK_CACHE_CAPACITY").as_integer();
+    if (cache_config.contains("LSM_BLOCK_CACHE_CAPACITY_BYTES")) {
+      lsm_block_cache_capacity_ =
+          cache_config.at("LSM_BLOCK_CACHE_CAPACITY_BYTES").as_integer();
+    } else if (cache_config.contains("LSM_BLOCK_CACHE_CAPACITY")) {
+      // 旧的配置项按块数计数, 按字节解释会得到过小的缓存, 保留默认容量
+      spdlog::warn("LSM_BLOCK_CACHE_CAPACITY counted blocks and is ignored, "
+                   "set LSM_BLOCK_CACHE_CAPACITY_BYTES instead");
+    }
+    if (lsm_block_cache_capacity_ < lsm_block_size_) {
+      spdlog::warn("LSM_BLOCK_CACHE_CAPACITY_BYTES ({}) is smaller than "
+                   "LSM_BLOCK_SIZE ({}), no block can be cached",
+                   lsm_block_cache_capacity_, lsm_block_size_);
+    }
     lsm_block_cache_k_ = cache_config.at("LSM_BLOCK_CACHE_K").as_integer();
+    lsm_block_cache_shard_bits_ =
+        cache_config.at("LSM_BLOCK_CACHE_SHARD_BITS").as_integer();
+    lsm_block_cache_tiny_lfu_ =
+        cache_config.at("LSM_BLOCK_CACHE_TINY_LFU").as_boolean();
+    lsm_row_cache_capacity_ =
+        cache_config.at("LSM_ROW_CACHE_CAPACITY").as_integer();
+    lsm_secondary_cache_capacity_ =
+        cache_config.at("LSM_SECONDARY_CACHE_CAPACITY").as_integer();
+    lsm_secondary_cache_path_ =
+        cache_config.at("LSM_SECONDARY_CACHE_PATH").as_string();
+    lsm_hot_blocks_max_entries_ =
+        cache_config.at("LSM_HOT_BLOCKS_MAX_ENTRIES").as_integer();
+    lsm_hot_blocks_persist_interval_ =
+        cache_config.at("LSM_HOT_BLOCKS_PERSIST_INTERVAL").as_integer();
+    lsm_table_cache_max_open_files_ =
+        cache_config.at("LSM_TABLE_CACHE_MAX_OPEN_FILES").as_integer();
+    lsm_table_cache_capacity_ =
+        cache_config.at("LSM_TABLE_CACHE_CAPACITY").as_integer();
+    lsm_pin_index_filter_max_level_ =
+        cache_config.at("LSM_PIN_INDEX_FILTER_MAX_LEVEL").as_integer();
+    lsm_sst_use_mmap_ = cache_config.at("LSM_SST_USE_MMAP").as_boolean();
+
+    // --- Load LSM IO ---
+    auto io_config = config["lsm"]["io"];
+
+    lsm_io_uring_queue_depth_ =
+        io_config.at("LSM_IO_URING_QUEUE_DEPTH").as_integer();
+    lsm_readahead_blocks_ = io_config.at("LSM_READAHEAD_BLOCKS").as_integer();
+    lsm_sst_use_direct_io_ =
+        io_config.at("LSM_SST_USE_DIRECT_IO").as_boolean();
+    lsm_direct_io_buffer_pool_size_ =
+        io_config.at("LSM_DIRECT_IO_BUFFER_POOL_SIZE").as_integer();
 
     // --- Load Redis Headers/Separators ---
     auto redis_config = config["redis"];
@@ -132,11 +225,82 @@ long long TomlConfig::getLsmPerMemSizeLimit() const {
 }
 int TomlConfig::getLsmBlockSize() const { return lsm_block_size_; }
 int TomlConfig::getLsmSstLevelRatio() const { return lsm_sst_level_ratio_; }
+int TomlConfig::getLsmMaxImmutableMemtables() const {
+  return lsm_max_immutable_memtables_;
+}
+int TomlConfig::getLsmCompactionThreads() const {
+  return lsm_compaction_threads_;
+}
+int TomlConfig::getLsmMaxSubcompactions() const {
+  return lsm_max_subcompactions_;
+}
+int TomlConfig::getLsmMultiGetThreads() const { return lsm_multiget_threads_; }
+int TomlConfig::getLsmMultiGetMinKeysPerTask() const {
+  return lsm_multiget_min_keys_per_task_;
+}
+int TomlConfig::getLsmL0SlowdownWritesTrigger() const {
+  return lsm_l0_slowdown_writes_trigger_;
+}
+int TomlConfig::getLsmL0StopWritesTrigger() const {
+  return lsm_l0_stop_writes_trigger_;
+}
+long long TomlConfig::getLsmSoftPendingCompactionBytes() const {
+  return lsm_soft_pending_compaction_bytes_;
+}
+long long TomlConfig::getLsmHardPendingCompactionBytes() const {
+  return lsm_hard_pending_compaction_bytes_;
+}
+long long TomlConfig::getLsmDelayedWriteRate() const {
+  return lsm_delayed_write_rate_;
+}
+long long TomlConfig::getLsmMaxManifestFileSize() const {
+  return lsm_max_manifest_file_size_;
+}
 
-int TomlConfig::getLsmBlockCacheCapacity() const {
+long long TomlConfig::getLsmBlockCacheCapacity() const {
   return lsm_block_cache_capacity_;
 }
 int TomlConfig::getLsmBlockCacheK() const { return lsm_block_cache_k_; }
+int TomlConfig::getLsmBlockCacheShardBits() const {
+  return lsm_block_cache_shard_bits_;
+}
+bool TomlConfig::getLsmBlockCacheTinyLfu() const {
+  return lsm_block_cache_tiny_lfu_;
+}
+long long TomlConfig::getLsmRowCacheCapacity() const {
+  return lsm_row_cache_capacity_;
+}
+long long TomlConfig::getLsmSecondaryCacheCapacity() const {
+  return lsm_secondary_cache_capacity_;
+}
+const std::string &TomlConfig::getLsmSecondaryCachePath() const {
+  return lsm_secondary_cache_path_;
+}
+int TomlConfig::getLsmHotBlocksMaxEntries() const {
+  return lsm_hot_blocks_max_entries_;
+}
+int TomlConfig::getLsmHotBlocksPersistInterval() const {
+  return lsm_hot_blocks_persist_interval_;
+}
+int TomlConfig::getLsmTableCacheMaxOpenFiles() const {
+  return lsm_table_cache_max_open_files_;
+}
+long long TomlConfig::getLsmTableCacheCapacity() const {
+  return lsm_table_cache_capacity_;
+}
+int TomlConfig::getLsmPinIndexFilterMaxLevel() const {
+  return lsm_pin_index_filter_max_level_;
+}
+bool TomlConfig::getLsmSstUseMmap() const { return lsm_sst_use_mmap_; }
+
+int TomlConfig::getLsmIoUringQueueDepth() const {
+  return lsm_io_uring_queue_depth_;
+}
+int TomlConfig::getLsmReadaheadBlocks() const { return lsm_readahead_blocks_; }
+bool TomlConfig::getLsmSstUseDirectIo() const { return lsm_sst_use_direct_io_; }
+long long TomlConfig::getLsmDirectIoBufferPoolSize() const {
+  return lsm_direct_io_buffer_pool_size_;
+}
 
 const std::string &TomlConfig::getRedisExpireHeader() const {
   return redis_expire_header_;
@@ -205,11 +369,57 @@ bool TomlConfig::saveToFile(const std::string &filePath) {
     config["lsm"]["core"]["LSM_PER_MEM_SIZE_LIMIT"] = lsm_per_mem_size_limit_;
     config["lsm"]["core"]["LSM_BLOCK_SIZE"] = lsm_block_size_;
     config["lsm"]["core"]["LSM_SST_LEVEL_RATIO"] = lsm_sst_level_ratio_;
+    config["lsm"]["core"]["LSM_MAX_IMMUTABLE_MEMTABLES"] =
+        lsm_max_immutable_memtables_;
+    config["lsm"]["core"]["LSM_COMPACTION_THREADS"] = lsm_compaction_threads_;
+    config["lsm"]["core"]["LSM_MAX_SUBCOMPACTIONS"] = lsm_max_subcompactions_;
+    config["lsm"]["core"]["LSM_MULTIGET_THREADS"] = lsm_multiget_threads_;
+    config["lsm"]["core"]["LSM_MULTIGET_MIN_KEYS_PER_TASK"] =
+        lsm_multiget_min_keys_per_task_;
+    config["lsm"]["core"]["LSM_L0_SLOWDOWN_WRITES_TRIGGER"] =
+        lsm_l0_slowdown_writes_trigger_;
+    config["lsm"]["core"]["LSM_L0_STOP_WRITES_TRIGGER"] =
+        lsm_l0_stop_writes_trigger_;
+    config["lsm"]["core"]["LSM_SOFT_PENDING_COMPACTION_BYTES"] =
+        lsm_soft_pending_compaction_bytes_;
+    config["lsm"]["core"]["LSM_HARD_PENDING_COMPACTION_BYTES"] =
+        lsm_hard_pending_compaction_bytes_;
+    config["lsm"]["core"]["LSM_DELAYED_WRITE_RATE"] = lsm_delayed_write_rate_;
+    config["lsm"]["core"]["LSM_MAX_MANIFEST_FILE_SIZE"] =
+        lsm_max_manifest_file_size_;
 
     // --- LSM Cache ---
-    config["lsm"]["cache"]["LSM_BLOCK_CACHE_CAPACITY"] =
+    config["lsm"]["cache"]["LSM_BLOCK_CACHE_CAPACITY_BYTES"] =
         lsm_block_cache_capacity_;
     config["lsm"]["cache"]["LSM_BLOCK_CACHE_K"] = lsm_block_cache_k_;
+    config["lsm"]["cache"]["LSM_BLOCK_CACHE_SHARD_BITS"] =
+        lsm_block_cache_shard_bits_;
+    config["lsm"]["cache"]["LSM_BLOCK_CACHE_TINY_LFU"] =
+        lsm_block_cache_tiny_lfu_;
+    config["lsm"]["cache"]["LSM_ROW_CACHE_CAPACITY"] = lsm_row_cache_capacity_;
+    config["lsm"]["cache"]["LSM_SECONDARY_CACHE_CAPACITY"] =
+        lsm_secondary_cache_capacity_;
+    config["lsm"]["cache"]["LSM_SECONDARY_CACHE_PATH"] =
+        lsm_secondary_cache_path_;
+    config["lsm"]["cache"]["LSM_HOT_BLOCKS_MAX_ENTRIES"] =
+        lsm_hot_blocks_max_entries_;
+    config["lsm"]["cache"]["LSM_HOT_BLOCKS_PERSIST_INTERVAL"] =
+        lsm_hot_blocks_persist_interval_;
+    config["lsm"]["cache"]["LSM_TABLE_CACHE_MAX_OPEN_FILES"] =
+        lsm_table_cache_max_open_files_;
+    config["lsm"]["cache"]["LSM_TABLE_CACHE_CAPACITY"] =
+        lsm_table_cache_capacity_;
+    config["lsm"]["cache"]["LSM_PIN_INDEX_FILTER_MAX_LEVEL"] =
+        lsm_pin_index_filter_max_level_;
+    config["lsm"]["cache"]["LSM_SST_USE_MMAP"] = lsm_sst_use_mmap_;
+
+    // --- LSM IO ---
+    config["lsm"]["io"]["LSM_IO_URING_QUEUE_DEPTH"] =
+        lsm_io_uring_queue_depth_;
+    config["lsm"]["io"]["LSM_READAHEAD_BLOCKS"] = lsm_readahead_blocks_;
+    config["lsm"]["io"]["LSM_SST_USE_DIRECT_IO"] = lsm_sst_use_direct_io_;
+    config["lsm"]["io"]["LSM_DIRECT_IO_BUFFER_POOL_SIZE"] =
+        lsm_direct_io_buffer_pool_size_;
 
     // --- Redis Headers/Separators ---
     config["redis"]["REDIS_EXPIRE_HEADER"] = redis_expire_header_;
@@ -37,8 +37,8 @@ bool operator==(const SearchItem &a, const SearchItem &b) {
 
 // *************************** HeapIterator ***************************
 HeapIterator::HeapIterator(std::vector<SearchItem> item_vec,
-                           uint64_t max_tranc_id)
-    : max_tranc_id_(max_tranc_id) {
+                           uint64_t max_tranc_id, bool skip_delete)
+    : max_tranc_id_(max_tranc_id), skip_delete_(skip_delete) {
   for (auto &item : item_vec) {
 
     items.push(item);
@@ -49,7 +49,7 @@ HeapIterator::HeapIterator(std::vector<SearchItem> item_vec,
     skip_by_tranc_id();
 
     // 2. 跳过标记为删除的元素
-    while (!items.empty() && items.top().value_.empty()) {
+    while (skip_delete_ && !items.empty() && items.top().value_.empty()) {
       // 如果当前元素的value为空，则说明该元素已经被删除，需要从优先队列中删除
       auto del_key = items.top().key_;
       while (!items.empty() && items.top().key_ == del_key) {
@@ -87,7 +87,7 @@ BaseIterator &HeapIterator::operator++() {
     skip_by_tranc_id();
 
     // 2. 跳过标记为删除的元素
-    while (!items.empty() && items.top().value_.empty()) {
+    while (skip_delete_ && !items.empty() && items.top().value_.empty()) {
       // 如果当前元素的value为空，则说明该元素已经被删除，需要从优先队列中删除
       auto del_key = items.top().key_;
       while (!items.empty() && items.top().key_ == del_key) {
@@ -126,12 +126,12 @@ bool HeapIterator::top_value_legal() const {
   if (max_tranc_id_ == 0) {
     // 没有开启事务
     // 不为空的 value 才合法
-    return items.top().value_.size() > 0;
+    return !skip_delete_ || items.top().value_.size() > 0;
   }
 
   if (items.top().tranc_id_ <= max_tranc_id_) {
     // 事务id可见, 则判断其value是否为空
-    return items.top().value_.size() > 0;
+    return !skip_delete_ || items.top().value_.size() > 0;
   } else {
     // 事务id不可见, 即不合法
     return false;
@@ -0,0 +1,119 @@
+#include "../../include/lsm/compact_iterator.h"
+#include <algorithm>
+
+namespace toni_lsm {
+
+CompactIterator::CompactIterator(
+    std::vector<std::vector<std::shared_ptr<SST>>> runs,
+    const std::optional<std::string> &start_key,
+    const std::optional<std::string> &end_key)
+    : end_key_(end_key) {
+  cursors_.resize(runs.size());
+  for (size_t i = 0; i < runs.size(); i++) {
+    cursors_[i].ssts = std::move(runs[i]);
+    seek(cursors_[i], start_key);
+    if (cursors_[i].valid) {
+      heap_.push_back(i);
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(), [this](size_t a, size_t b) {
+    return heap_greater(a, b);
+  });
+}
+
+void CompactIterator::seek(RunCursor &cursor,
+                           const std::optional<std::string> &start_key) {
+  if (!start_key.has_value()) {
+    load(cursor);
+    return;
+  }
+
+  // 跳过整体位于 start_key 之前的 sst 和 block
+  auto &ssts = cursor.ssts;
+  while (cursor.sst_idx < ssts.size() &&
+         ssts[cursor.sst_idx]->get_last_key() < start_key.value()) {
+    cursor.sst_idx++;
+  }
+  if (cursor.sst_idx < ssts.size()) {
+    cursor.block_idx =
+        ssts[cursor.sst_idx]->get_block_index()->find(start_key.value());
+  }
+
+  load(cursor);
+  while (cursor.valid && cursor.entry.key < start_key.value()) {
+    cursor.entry_idx++;
+    load(cursor);
+  }
+}
+
+void CompactIterator::load(RunCursor &cursor) {
+  cursor.valid = false;
+  while (cursor.sst_idx < cursor.ssts.size()) {
+    auto &sst = cursor.ssts[cursor.sst_idx];
+    if (cursor.block_idx >= sst->num_blocks()) {
+      cursor.sst_idx++;
+      cursor.block_idx = 0;
+      cursor.entry_idx = 0;
+      cursor.block = nullptr;
+      continue;
+    }
+    if (!cursor.block) {
+      cursor.block = cursor.readahead.read(sst, cursor.block_idx);
+    }
+    if (cursor.entry_idx >= cursor.block->size()) {
+      cursor.block_idx++;
+      cursor.entry_idx = 0;
+      cursor.block = nullptr;
+      continue;
+    }
+
+    auto offset = cursor.block->get_offset_at(cursor.entry_idx);
+    cursor.entry = cursor.block->get_entry_at(offset);
+    // run 内的 key 有序, 超出 end_key 之后的部分都不需要读取
+    cursor.valid = !end_key_.has_value() || cursor.entry.key < end_key_.value();
+    return;
+  }
+}
+
+bool CompactIterator::heap_greater(size_t a, size_t b) const {
+  auto &entry_a = cursors_[a].entry;
+  auto &entry_b = cursors_[b].entry;
+  if (entry_a.key != entry_b.key) {
+    return entry_a.key > entry_b.key;
+  }
+  if (entry_a.tranc_id != entry_b.tranc_id) {
+    return entry_a.tranc_id < entry_b.tranc_id;
+  }
+  // 下标越大的 run 越旧
+  return a > b;
+}
+
+bool CompactIterator::is_valid() const { return !heap_.empty(); }
+
+const CompactIterator::Entry &CompactIterator::operator*() const {
+  return cursors_[heap_.front()].entry;
+}
+
+const CompactIterator::Entry *CompactIterator::operator->() const {
+  return &cursors_[heap_.front()].entry;
+}
+
+CompactIterator &CompactIterator::operator++() {
+  if (heap_.empty()) {
+    return *this;
+  }
+  auto cmp = [this](size_t a, size_t b) { return heap_greater(a, b); };
+  std::pop_heap(heap_.begin(), heap_.end(), cmp);
+  size_t idx = heap_.back();
+  heap_.pop_back();
+
+  auto &cursor = cursors_[idx];
+  cursor.entry_idx++;
+  load(cursor);
+  if (cursor.valid) {
+    heap_.push_back(idx);
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+  }
+  return *this;
+}
+} // namespace toni_lsm
@@ -1,18 +1,26 @@
 #include "../../include/lsm/engine.h"
 #include "../../include/config/config.h"
+#include "../../include/block/secondary_cache.h"
 #include "../../include/consts.h"
 #include "../../include/logger/logger.h"
+#include "../../include/lsm/hot_blocks.h"
 #include "../../include/lsm/level_iterator.h"
 #include "../../include/sst/concact_iterator.h"
 #include "../../include/sst/sst.h"
 #include "../../include/sst/sst_iterator.h"
 #include "spdlog/spdlog.h"
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <exception>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <span>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -26,7 +34,29 @@ LSMEngine::LSMEngine(std::string path) : data_dir(path) {
   // 初始化 block_cahce
   block_cache = std::make_shared<BlockCache>(
       TomlConfig::getInstance().getLsmBlockCacheCapacity(),
-      TomlConfig::getInstance().getLsmBlockCacheK());
+      TomlConfig::getInstance().getLsmBlockCacheK(),
+      TomlConfig::getInstance().getLsmBlockCacheShardBits(),
+      TomlConfig::getInstance().getLsmBlockCacheTinyLfu());
+  table_cache = std::make_shared<TableCache>(
+      TomlConfig::getInstance().getLsmTableCacheMaxOpenFiles(),
+      TomlConfig::getInstance().getLsmTableCacheCapacity());
+  if (TomlConfig::getInstance().getLsmRowCacheCapacity() > 0) {
+    enable_row_cache(TomlConfig::getInstance().getLsmRowCacheCapacity());
+  }
+  if (TomlConfig::getInstance().getLsmSstUseDirectIo()) {
+    direct_io_pool = std::make_shared<AlignedBufferPool>(
+        TomlConfig::getInstance().getLsmDirectIoBufferPoolSize());
+  }
+
+  // 冻结表数量的阈值沿用 LSM_MAX_IMMUTABLE_MEMTABLES, 超过 3/4 时开始限速
+  const auto &config = TomlConfig::getInstance();
+  size_t max_immutable = config.getLsmMaxImmutableMemtables();
+  write_controller_ = std::make_unique<WriteController>(
+      config.getLsmL0SlowdownWritesTrigger(),
+      config.getLsmL0StopWritesTrigger(), max_immutable * 3 / 4,
+      max_immutable + 1, config.getLsmSoftPendingCompactionBytes(),
+      config.getLsmHardPendingCompactionBytes(),
+      config.getLsmDelayedWriteRate());
 
   // 创建数据目录
   if (!std::filesystem::exists(path)) {
@@ -34,75 +64,106 @@ LSMEngine::LSMEngine(std::string path) : data_dir(path) {
                  "DB path ndo not exist. Creating data directory: {}",
                  path);
     std::filesystem::create_directory(path);
+  } else if (Manifest::exists(path)) {
+    spdlog::info("LSMEngine--"
+                 "DB path exist. Loading SST layout from MANIFEST: {} ...",
+                 path);
+    load_from_manifest();
   } else {
-    // 如果目录存在，则检查是否有 sst 文件并加载
+    // 没有 MANIFEST 的旧目录, 检查是否有 sst 文件并全部打开
     spdlog::info("LSMEngine--"
                  "DB path exist. Loading data directory: {} ...",
                  path);
-    for (const auto &entry : std::filesystem::directory_iterator(path)) {
-      if (!entry.is_regular_file()) {
-        continue;
-      }
-
-      std::string filename = entry.path().filename().string();
-      // SST文件名格式为: sst_{id}.level
-      if (!filename.starts_with("sst_")) {
-        continue;
-      }
-
-      // 找到 . 的位置
-      size_t dot_pos = filename.find('.');
-      if (dot_pos == std::string::npos || dot_pos == filename.length() - 1) {
-        continue;
-      }
-
-      // 提取 level
-      std::string level_str =
-          filename.substr(dot_pos + 1, filename.length() - 1 - dot_pos);
-      if (level_str.empty()) {
-        continue;
-      }
-      size_t level = std::stoull(level_str);
-
-      // 提取SST ID
-      std::string id_str = filename.substr(4, dot_pos - 4); // 4 for "sst_"
-      if (id_str.empty()) {
-        continue;
-      }
-      size_t sst_id = std::stoull(id_str);
-
-      // 加载SST文件, 初始化时需要加写锁
-      std::unique_lock<std::shared_mutex> lock(ssts_mtx); // 写锁
+    load_from_directory();
+  }
+  // 二级缓存文件默认位于数据目录中, 在目录创建之后打开
+  if (config.getLsmSecondaryCacheCapacity() > 0) {
+    block_cache->set_secondary_cache(std::make_shared<SecondaryCache>(
+        get_secondary_cache_path(), config.getLsmSecondaryCacheCapacity()));
+  }
+  manifest_ = std::make_unique<Manifest>(path);
+  {
+    std::unique_lock<std::shared_mutex> lock(ssts_mtx);
+    // 以当前布局重写 MANIFEST, 丢弃重放过的增量记录
+    manifest_->write_snapshot(snapshot_edit_locked());
+    publish_version_locked();
+  }
 
-      next_sst_id = std::max(sst_id, next_sst_id); // 记录目前最大的 sst_id
-      cur_max_level = std::max(level, cur_max_level); // 记录目前最大的 level
-      std::string sst_path = get_sst_path(sst_id, level);
-      auto sst = SST::open(sst_id, FileObj::open(sst_path, false), block_cache);
-      spdlog::info("LSMEngine--"
-                   "Loaded SST: {} successfully!",
-                   sst_path);
-      ssts[sst_id] = sst;
+  // 启动后台 compact 线程池和刷盘线程
+  compact_pool_ = std::make_unique<ThreadPool>(
+      TomlConfig::getInstance().getLsmCompactionThreads());
+  // 第一个子区间由 compact 线程自己执行, 其余的交给 subcompact_pool_
+  int max_subcompactions = TomlConfig::getInstance().getLsmMaxSubcompactions();
+  if (max_subcompactions > 1) {
+    subcompact_pool_ = std::make_unique<ThreadPool>(max_subcompactions - 1);
+  }
+  int multiget_threads = TomlConfig::getInstance().getLsmMultiGetThreads();
+  if (multiget_threads > 0) {
+    multiget_pool_ = std::make_unique<ThreadPool>(multiget_threads);
+  }
+  flush_thread_ = std::thread(&LSMEngine::flush_worker, this);
+  if (config.getLsmHotBlocksMaxEntries() > 0) {
+    hot_blocks_thread_ = std::thread(&LSMEngine::hot_blocks_worker, this);
+  } else {
+    warm_up_done_ = true;
+  }
 
-      level_sst_ids[level].push_back(sst_id);
-    }
+  // 重启前可能有未完成的 compact
+  update_write_stall_condition();
+  maybe_schedule_compaction();
+}
 
-    next_sst_id++; // 现有的最大 sst_id 自增后才是下一个分配的 sst_id
+LSMEngine::~LSMEngine() {
+  {
+    std::lock_guard<std::mutex> lock(flush_cv_mtx_);
+    stop_flush_ = true;
+  }
+  flush_cv_.notify_all();
+  write_stall_cv_.notify_all();
+  if (flush_thread_.joinable()) {
+    flush_thread_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(hot_blocks_mtx_);
+    stop_hot_blocks_ = true;
+  }
+  hot_blocks_cv_.notify_all();
+  if (hot_blocks_thread_.joinable()) {
+    hot_blocks_thread_.join();
+    // 关闭时的热点 block 最能代表重启后的工作集
+    persist_hot_blocks();
+  }
 
-    for (auto &[level, sst_id_list] : level_sst_ids) {
-      std::sort(sst_id_list.begin(), sst_id_list.end());
-      if (level == 0) {
-        // 其他 level 的 sst 都是没有重叠的, 且 id 小的表示 key
-        // 排序在前面的部分, 不需要 reverse
-        std::reverse(sst_id_list.begin(), sst_id_list.end());
-      }
-    }
+  // 已提交的 compact 任务执行完后再退出, 不再调度新的任务
+  {
+    std::lock_guard<std::mutex> lock(compact_mtx_);
+    stop_compact_ = true;
+  }
+  compact_pool_->shutdown();
+  if (subcompact_pool_) {
+    subcompact_pool_->shutdown();
+  }
+  if (multiget_pool_) {
+    multiget_pool_->shutdown();
   }
 }
 
-LSMEngine::~LSMEngine() = default;
-
 std::optional<std::pair<std::string, uint64_t>>
 LSMEngine::get(const std::string &key, uint64_t tranc_id) {
+  // 0. 行缓存中是最新版本, 命中时不需要查询 memtable 和 sst
+  uint64_t row_token = 0;
+  if (row_cache != nullptr) {
+    auto cached = row_cache->get(key, tranc_id, row_token);
+    if (cached.has_value()) {
+      spdlog::trace("LSMEngine--"
+                    "get({},{}): returning from row cache",
+                    key, tranc_id);
+      // 与从 sst 中查到时的返回值保持一致
+      return std::pair<std::string, uint64_t>{std::move(cached->first),
+                                              tranc_id};
+    }
+  }
+
   // 1. 先查找 memtable
   auto mem_res = memtable.get(key, tranc_id);
   if (mem_res.is_valid()) {
@@ -125,12 +186,10 @@ LSMEngine::get(const std::string &key, uint64_t tranc_id) {
   }
 
   // 2. l0 sst中查询
-  std::shared_lock<std::shared_mutex> rlock(ssts_mtx); // 读锁
-
-  for (auto &sst_id : level_sst_ids[0]) {
-    //  中的 sst_id 是按从大到小的顺序排列,
-    // sst_id 越大, 表示是越晚刷入的, 优先查询
-    auto &sst = ssts[sst_id];
+  auto version = current_version();
+  for (auto &sst : version->level(0)) {
+    // l0 的 sst 按照从新到旧排列, 越晚刷入的越先查询
+    auto sst_id = sst->get_sst_id();
     auto sst_iterator = sst->get(key, tranc_id);
     if (sst_iterator != sst->end()) {
       if ((sst_iterator)->second.size() > 0) {
@@ -140,6 +199,8 @@ LSMEngine::get(const std::string &key, uint64_t tranc_id) {
                       "returning from l0 sst{}",
                       key, tranc_id, sst_iterator->second,
                       sst_iterator.get_tranc_id(), sst_id);
+        fill_row_cache(key, sst_iterator->second,
+                       sst_iterator.get_cur_tranc_id(), tranc_id, row_token);
         return std::pair<std::string, uint64_t>{sst_iterator->second,
                                                 sst_iterator.get_tranc_id()};
       } else {
@@ -155,14 +216,14 @@ LSMEngine::get(const std::string &key, uint64_t tranc_id) {
   }
 
   // 3. 其他level的sst中查询
-  for (size_t level = 1; level <= cur_max_level; level++) {
-    std::deque<size_t> l_sst_ids = level_sst_ids[level];
+  for (size_t level = 1; level <= version->max_level; level++) {
+    const auto &l_ssts = version->level(level);
     // 二分查询
     size_t left = 0;
-    size_t right = l_sst_ids.size();
+    size_t right = l_ssts.size();
     while (left < right) {
       size_t mid = left + (right - left) / 2;
-      auto &sst = ssts[l_sst_ids[mid]];
+      auto &sst = l_ssts[mid];
       if (sst->get_first_key() <= key && key <= sst->get_last_key()) {
         // 如果sst_id在中, 则在sst中查询
         auto sst_iterator = sst->get(key, tranc_id);
@@ -173,7 +234,11 @@ LSMEngine::get(const std::string &key, uint64_t tranc_id) {
                           "get({},{}): value = {}, tranc_id = {} "
                           "returning from l{} sst{}",
                           key, tranc_id, sst_iterator->second,
-                          sst_iterator.get_tranc_id(), level, l_sst_ids[mid]);
+                          sst_iterator.get_tranc_id(), level,
+                          sst->get_sst_id());
+            fill_row_cache(key, sst_iterator->second,
+                           sst_iterator.get_cur_tranc_id(), tranc_id,
+                           row_token);
 
             return std::pair<std::string, uint64_t>{
                 sst_iterator->second, sst_iterator.get_tranc_id()};
@@ -182,7 +247,7 @@ LSMEngine::get(const std::string &key, uint64_t tranc_id) {
             spdlog::trace("LSMEngine--"
                           "get({},{}): key is deleted or do not exist "
                           "returning from l{} sst{}",
-                          key, tranc_id, level, l_sst_ids[mid]);
+                          key, tranc_id, level, sst->get_sst_id());
 
             return std::nullopt;
           }
@@ -208,94 +273,226 @@ LSMEngine::get(const std::string &key, uint64_t tranc_id) {
 std::vector<
     std::pair<std::string, std::optional<std::pair<std::string, uint64_t>>>>
 LSMEngine::get_batch(const std::vector<std::string> &keys, uint64_t tranc_id) {
+  // 0. 查找行缓存, 填充令牌需要在查询 memtable 之前获取
+  std::vector<uint64_t> row_tokens(keys.size(), 0);
+  std::vector<std::optional<std::pair<std::string, uint64_t>>> row_hits(
+      keys.size());
+  if (row_cache != nullptr) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      row_hits[i] = row_cache->get(keys[i], tranc_id, row_tokens[i]);
+      if (row_hits[i].has_value()) {
+        // 与从 sst 中查到时的返回值保持一致
+        row_hits[i]->second = tranc_id;
+      }
+    }
+  }
+
   // 1. 先从 memtable 中批量查找
   auto results = memtable.get_batch(keys, tranc_id);
-
-  // 2. 如果所有键都在memtable 中找到，直接返回
-  bool need_search_sst = false;
-  for (const auto &[key, value] : results) {
-    if (!value.has_value()) {
-      // 需要查找
-      need_search_sst = true;
-      break;
+  // 还需要查找 sst 的 key 在 results 中的下标, 以及对应的 key, 按 key 排序
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < results.size(); i++) {
+    auto &value = results[i].second;
+    if (value.has_value()) {
+      if (value->first.empty()) {
+        // memtable 中的删除标记, 不能再去 sst 中查到旧版本
+        value = std::nullopt;
+      }
+    } else if (row_hits[i].has_value()) {
+      value = std::move(row_hits[i]);
+    } else {
+      pending.push_back(i);
     }
   }
 
-  if (!need_search_sst) {
-    return results; // 不需要查sst
+  // 2. 如果所有键都在 memtable 或行缓存中找到，直接返回
+  if (pending.empty()) {
+    return results;
   }
-
-  // 2. 从 L0 层 SST 文件中批量查找未命中的键
-  std::shared_lock<std::shared_mutex> rlock(ssts_mtx); // 加读锁
-  for (auto &[key, value] : results) {
-    for (auto &sst_id : level_sst_ids[0]) {
-      auto &sst = ssts[sst_id];
-      auto sst_iterator = sst->get(key, tranc_id);
-      if (sst_iterator != sst->end()) {
-        if (sst_iterator->second.size() > 0) {
-          // 值存在且不为空
-          value =
-              std::make_pair(sst_iterator->second, sst_iterator.get_tranc_id());
-        } else {
-          // 空值表示被删除
-          value = std::nullopt;
+  std::sort(pending.begin(), pending.end(),
+            [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+  // 从 sst 中查到的记录自身的事务 id, 放入行缓存时使用
+  std::vector<std::optional<uint64_t>> found_tranc_ids(results.size());
+
+  // 3. 在 sst 中查找, 键较多时按 key 范围切分, 交给读取线程池并行查找
+  // 每个键只由一个任务从新到旧逐层查找, 各任务写入 results 中不同的位置
+  auto version = current_version();
+  size_t min_keys = std::max(
+      1, TomlConfig::getInstance().getLsmMultiGetMinKeysPerTask());
+  size_t num_tasks = 1;
+  if (multiget_pool_ != nullptr) {
+    num_tasks = std::min(multiget_pool_->thread_num() + 1,
+                         pending.size() / min_keys);
+  }
+  if (num_tasks <= 1) {
+    multi_get_from_ssts(*version, keys, std::move(pending), tranc_id,
+                        results, found_tranc_ids);
+  } else {
+    auto range = [&](size_t t) {
+      return std::vector<size_t>(
+          pending.begin() + t * pending.size() / num_tasks,
+          pending.begin() + (t + 1) * pending.size() / num_tasks);
+    };
+    std::vector<std::future<void>> futures;
+    for (size_t t = 1; t < num_tasks; t++) {
+      futures.push_back(multiget_pool_->submit(
+          &LSMEngine::multi_get_from_ssts, this, std::cref(*version),
+          std::cref(keys), range(t), tranc_id, std::ref(results),
+          std::ref(found_tranc_ids)));
+    }
+    // 第一段由调用线程自己查找
+    std::exception_ptr error;
+    try {
+      multi_get_from_ssts(*version, keys, range(0), tranc_id, results,
+                          found_tranc_ids);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    // 即使有任务失败也要等待所有任务结束, 它们引用了调用方的数据
+    for (auto &future : futures) {
+      try {
+        future.get();
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
         }
-        break; // 停止继续查找
       }
     }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  for (size_t i = 0; i < results.size(); i++) {
+    if (found_tranc_ids[i].has_value()) {
+      fill_row_cache(keys[i], results[i].second->first, *found_tranc_ids[i],
+                     tranc_id, row_tokens[i]);
+    }
+  }
+  return results;
+}
+
+void LSMEngine::multi_get_from_ssts(
+    const Version &version, const std::vector<std::string> &keys,
+    std::vector<size_t> pending, uint64_t tranc_id,
+    std::vector<std::pair<std::string,
+                          std::optional<std::pair<std::string, uint64_t>>>>
+        &results,
+    std::vector<std::optional<uint64_t>> &found_tranc_ids) {
+  std::vector<std::string> pending_keys;
+  pending_keys.reserve(pending.size());
+  for (auto i : pending) {
+    pending_keys.push_back(keys[i]);
   }
 
-  // 3. 从其他层级 SST 文件中批量查找未命中的键
-  for (size_t level = 1; level <= cur_max_level; level++) {
-    std::deque<size_t> l_sst_ids = level_sst_ids[level];
+  // 依次在每个有序且互不重叠的 sst 序列中查找: l0 的每个 sst 从新到旧,
+  // 之后每层一个序列. 有序的 key 与 sst 归并分组, 需要的 block 一起读取,
+  // 同一个 block 只读取和解码一次, 查到的 key (包括删除标记) 不再继续查找
+  auto probe_run = [&](const std::vector<std::shared_ptr<SST>> &run) {
+    std::vector<std::pair<std::shared_ptr<SST>, size_t>> wanted;
+    std::vector<size_t> wanted_pos; // wanted 中每一项在 pending 中的位置
+    size_t sst_idx = 0;
+    for (size_t begin = 0; begin < pending_keys.size();) {
+      while (sst_idx < run.size() &&
+             run[sst_idx]->get_last_key() < pending_keys[begin]) {
+        sst_idx++;
+      }
+      if (sst_idx == run.size()) {
+        break;
+      }
+      auto &sst = run[sst_idx];
+      size_t end = begin;
+      while (end < pending_keys.size() &&
+             pending_keys[end] <= sst->get_last_key()) {
+        end++;
+      }
+      auto block_idxs = sst->find_block_idxs(
+          std::span(pending_keys).subspan(begin, end - begin));
+      for (size_t j = 0; j < block_idxs.size(); j++) {
+        if (block_idxs[j] != static_cast<size_t>(-1)) {
+          wanted.emplace_back(sst, block_idxs[j]);
+          wanted_pos.push_back(begin + j);
+        }
+      }
+      begin = end;
+    }
+    if (wanted.empty()) {
+      return;
+    }
 
-    for (auto &[key, value] : results) {
-      if (value.has_value()) // 已找到，跳过
-      {
+    auto blocks = SST::read_blocks(wanted);
+    std::vector<bool> resolved(pending.size(), false);
+    for (size_t w = 0; w < wanted.size(); w++) {
+      size_t pos = wanted_pos[w];
+      auto idx = blocks[w]->get_idx_binary(pending_keys[pos], tranc_id);
+      if (!idx.has_value()) {
         continue;
       }
+      auto entry = blocks[w]->get_entry_at(blocks[w]->get_offset_at(*idx));
+      size_t i = pending[pos];
+      resolved[pos] = true;
+      if (entry.value.empty()) {
+        // 空值表示被删除
+        continue;
+      }
+      results[i].second = std::make_pair(std::move(entry.value), tranc_id);
+      found_tranc_ids[i] = entry.tranc_id;
+    }
 
-      // 二分查找确定键可能所在的 SST 文件
-      size_t left = 0;
-      size_t right = l_sst_ids.size();
-      while (left < right) {
-        size_t mid = left + (right - left) / 2;
-        auto &sst = ssts[l_sst_ids[mid]];
-
-        if (sst->get_first_key() <= key && key <= sst->get_last_key()) {
-          // 如果键在当前 SST 文件范围内，则在 SST 中查找
-          auto sst_iterator = sst->get(key, tranc_id);
-          if (sst_iterator.is_valid()) {
-            if (sst_iterator->second.size() > 0) {
-              // 值存在且不为空
-              value = std::make_pair(sst_iterator->second,
-                                     sst_iterator.get_tranc_id());
-            } else {
-              // 空值表示被删除
-              value = std::nullopt;
-            }
-          }
-          break; // 停止继续查找
-        } else if (sst->get_last_key() < key) {
-          left = mid + 1;
-        } else {
-          right = mid;
-        }
+    size_t kept = 0;
+    for (size_t pos = 0; pos < pending.size(); pos++) {
+      if (resolved[pos]) {
+        continue;
+      }
+      if (kept != pos) {
+        pending[kept] = pending[pos];
+        pending_keys[kept] = std::move(pending_keys[pos]);
       }
+      kept++;
     }
+    pending.resize(kept);
+    pending_keys.resize(kept);
+  };
+
+  for (auto &sst : version.level(0)) {
+    if (pending.empty()) {
+      break;
+    }
+    probe_run({sst});
+  }
+  for (size_t level = 1; level <= version.max_level && !pending.empty();
+       level++) {
+    probe_run(version.level(level));
   }
+}
 
-  return results;
+void LSMEngine::enable_row_cache(size_t capacity) {
+  row_cache = std::make_shared<RowCache>(
+      capacity, TomlConfig::getInstance().getLsmBlockCacheShardBits());
+  // 写入 memtable 的 key 不再是缓存中的最新版本
+  memtable.set_write_callback(
+      [row_cache = row_cache](const std::string &key) {
+        row_cache->invalidate(key);
+      });
+}
+
+void LSMEngine::fill_row_cache(const std::string &key, const std::string &value,
+                               uint64_t value_tranc_id, uint64_t tranc_id,
+                               uint64_t row_token) {
+  // 快照之后还有写入时, 快照读取查到的不一定是最新版本, 不能放入
+  // 获取令牌之后的写入由令牌拒绝, 之前的写入都已计入 max_write_tranc_id
+  if (row_cache != nullptr &&
+      (tranc_id == 0 || tranc_id >= memtable.get_max_write_tranc_id())) {
+    row_cache->put(key, value, value_tranc_id, row_token);
+  }
 }
 
 std::optional<std::pair<std::string, uint64_t>>
 LSMEngine::sst_get_(const std::string &key, uint64_t tranc_id) {
-
   // 1. l0 sst中查询
-  for (auto &sst_id : level_sst_ids[0]) {
-    //  中的 sst_id 是按从大到小的顺序排列,
-    // sst_id 越大, 表示是越晚刷入的, 优先查询
-    auto sst = ssts[sst_id];
+  auto version = current_version();
+  for (auto &sst : version->level(0)) {
+    // l0 的 sst 按照从新到旧排列, 越晚刷入的越先查询
     auto sst_iterator = sst->get(key, tranc_id);
     if (sst_iterator != sst->end()) {
       if ((sst_iterator)->second.size() > 0) {
@@ -303,7 +500,7 @@ LSMEngine::sst_get_(const std::string &key, uint64_t tranc_id) {
         // L0 SST 查询命中
         spdlog::trace("LSMEngine--"
                       "sst_get({}{}): found in l0 sst{}",
-                      key, tranc_id, sst_id);
+                      key, tranc_id, sst->get_sst_id());
 
         return std::pair<std::string, uint64_t>{sst_iterator->second,
                                                 sst_iterator.get_tranc_id()};
@@ -315,14 +512,14 @@ LSMEngine::sst_get_(const std::string &key, uint64_t tranc_id) {
   }
 
   // 2. 其他level的sst中查询
-  for (size_t level = 1; level <= cur_max_level; level++) {
-    std::deque<size_t> l_sst_ids = level_sst_ids[level];
+  for (size_t level = 1; level <= version->max_level; level++) {
+    const auto &l_ssts = version->level(level);
     // 二分查询
     size_t left = 0;
-    size_t right = l_sst_ids.size();
+    size_t right = l_ssts.size();
     while (left < right) {
       size_t mid = left + (right - left) / 2;
-      auto sst = ssts[l_sst_ids[mid]];
+      auto &sst = l_ssts[mid];
       if (sst->get_first_key() <= key && key <= sst->get_last_key()) {
         // 如果sst_id在中, 则在sst中查询
         auto sst_iterator = sst->get(key, tranc_id);
@@ -367,11 +564,8 @@ uint64_t LSMEngine::put(const std::string &key, const std::string &value,
                 "inserted into memtable",
                 key, value, tranc_id);
 
-  // 如果 memtable 太大，需要刷新到磁盘
-  if (memtable.get_total_size() >=
-      TomlConfig::getInstance().getLsmTolMemSizeLimit()) {
-    return flush();
-  }
+  // 如果 memtable 太大，交给后台线程刷新到磁盘
+  notify_flush_or_stall(key.size() + value.size());
   return 0;
 }
 
@@ -384,11 +578,12 @@ uint64_t LSMEngine::put_batch(
                 "put_batch with {} keys inserted into memtable",
                 kvs.size());
 
-  // 如果 memtable 太大，需要刷新到磁盘
-  if (memtable.get_total_size() >=
-      TomlConfig::getInstance().getLsmTolMemSizeLimit()) {
-    return flush();
+  // 如果 memtable 太大，交给后台线程刷新到磁盘
+  size_t write_bytes = 0;
+  for (auto &[key, value] : kvs) {
+    write_bytes += key.size() + value.size();
   }
+  notify_flush_or_stall(write_bytes);
   return 0;
 }
 uint64_t LSMEngine::remove(const std::string &key, uint64_t tranc_id) {
@@ -400,11 +595,8 @@ uint64_t LSMEngine::remove(const std::string &key, uint64_t tranc_id) {
                 "deleted in memtable",
                 key, tranc_id);
 
-  // 如果 memtable 太大，需要刷新到磁盘
-  if (memtable.get_total_size() >=
-      TomlConfig::getInstance().getLsmTolMemSizeLimit()) {
-    return flush();
-  }
+  // 如果 memtable 太大，交给后台线程刷新到磁盘
+  notify_flush_or_stall(key.size());
   return 0;
 }
 
@@ -416,22 +608,40 @@ uint64_t LSMEngine::remove_batch(const std::vector<std::string> &keys,
                 "remove_batch with {} keys tagged into memtable",
                 keys.size());
 
-  // 如果 memtable 太大，需要刷新到磁盘
-  if (memtable.get_total_size() >=
-      TomlConfig::getInstance().getLsmTolMemSizeLimit()) {
-    return flush();
+  // 如果 memtable 太大，交给后台线程刷新到磁盘
+  size_t write_bytes = 0;
+  for (auto &key : keys) {
+    write_bytes += key.size();
   }
+  notify_flush_or_stall(write_bytes);
   return 0;
 }
 
 void LSMEngine::clear() {
+  std::lock_guard<std::mutex> flush_lock(flush_mtx_);
+  // 持有 compact_mtx_ 期间不会有新的 compact 被调度
+  std::unique_lock<std::mutex> compact_lock(compact_mtx_);
+  compact_cv_.wait(compact_lock, [this] { return running_compactions_ == 0; });
+  std::unique_lock<std::shared_mutex> lock(ssts_mtx);
   memtable.clear();
+  if (row_cache != nullptr) {
+    row_cache->clear();
+  }
   level_sst_ids.clear();
   ssts.clear();
-  // 清空当前文件夹的所有内容
+  publish_version_locked();
+  // 清空当前文件夹的所有内容, 包括 MANIFEST
+  // 二级缓存文件仍然处于打开状态, 只截断不删除
+  const auto &secondary = block_cache->secondary_cache();
+  if (secondary != nullptr) {
+    secondary->clear();
+  }
   try {
     for (const auto &entry : std::filesystem::directory_iterator(data_dir)) {
-      if (!entry.is_regular_file()) {
+      if (!entry.is_regular_file() ||
+          (secondary != nullptr &&
+           std::filesystem::equivalent(entry.path(),
+                                       get_secondary_cache_path()))) {
         continue;
       }
       std::filesystem::remove(entry.path());
@@ -444,39 +654,65 @@ void LSMEngine::clear() {
     // 处理文件系统错误
     spdlog::error("Error clearing directory: {}", e.what());
   }
+  manifest_->write_snapshot(snapshot_edit_locked());
+
+  // 清空之后不再需要限速
+  lock.unlock();
+  write_controller_->update_immutable_memtables(0);
+  update_write_stall_condition();
 }
 
 uint64_t LSMEngine::flush() {
+  std::lock_guard<std::mutex> flush_lock(flush_mtx_);
+
   if (memtable.get_total_size() == 0) {
     return 0;
   }
 
-  std::unique_lock<std::shared_mutex> lock(ssts_mtx); // 写锁
-
-  // 1. 先判断 l0 sst 是否数量超限需要concat到 l1
-  if (level_sst_ids.find(0) != level_sst_ids.end() &&
-      level_sst_ids[0].size() >=
-          TomlConfig::getInstance().getLsmSstLevelRatio()) {
-    full_compact(0);
-  }
-
-  // 2. 创建新的 SST ID
+  // 1. 创建新的 SST ID
   size_t new_sst_id = next_sst_id++;
 
-  // 3. 准备 SSTBuilder
+  // 2. 准备 SSTBuilder
   SSTBuilder builder(TomlConfig::getInstance().getLsmBlockSize(),
                      true); // 4KB block size
+  builder.set_direct_io(direct_io_pool);
 
-  // 4. 将 memtable 中最旧的表写入 SST
+  // 3. 将 memtable 中最旧的表写入 SST
+  // 构建期间不持有 ssts_mtx, 冻结表仍然对读者可见
   auto sst_path = get_sst_path(new_sst_id, 0);
   auto new_sst =
       memtable.flush_last(builder, sst_path, new_sst_id, block_cache);
+  if (new_sst == nullptr) {
+    return 0;
+  }
+  new_sst->attach_table_cache(table_cache);
+
+  {
+    std::unique_lock<std::shared_mutex> lock(ssts_mtx); // 写锁
 
-  // 5. 更新内存索引
-  ssts[new_sst_id] = new_sst;
+    // 4. 先记录到 MANIFEST, 崩溃后未记录的 sst 由 wal 重放恢复
+    VersionEdit edit;
+    edit.added.emplace_back(0, new_sst->get_file_meta());
+    edit.next_sst_id = next_sst_id.load();
+    manifest_->log_edit(edit);
 
-  // 6. 更新 sst_ids
-  level_sst_ids[0].push_front(new_sst_id);
+    // 5. 更新内存索引
+    ssts[new_sst_id] = new_sst;
+
+    // 6. 更新 sst_ids
+    level_sst_ids[0].push_front(new_sst_id);
+    publish_version_locked();
+    maybe_rewrite_manifest_locked();
+  }
+
+  // 7. sst 已经可见, 才能移除对应的冻结表
+  memtable.remove_last_frozen();
+  write_controller_->update_immutable_memtables(
+      memtable.get_frozen_table_num());
+  update_write_stall_condition();
+
+  // 8. l0 的 sst 数量可能超限, 交给后台线程池 compact
+  maybe_schedule_compaction();
 
   // 返回新刷入的 sst 的最大的 tranc_id
   spdlog::info("LSMEngine--"
@@ -486,6 +722,357 @@ uint64_t LSMEngine::flush() {
   return new_sst->get_tranc_id_range().second;
 }
 
+// memtable 的总大小上限, 配置为负数时视为 0
+static size_t tol_mem_size_limit() {
+  return static_cast<size_t>(
+      std::max(0LL, TomlConfig::getInstance().getLsmTolMemSizeLimit()));
+}
+
+void LSMEngine::notify_flush_or_stall(size_t write_bytes) {
+  if (memtable.get_total_size() >= tol_mem_size_limit()) {
+    {
+      // 持有 flush_cv_mtx_ 后再唤醒, 避免刷盘线程检查条件后丢失唤醒
+      std::lock_guard<std::mutex> lock(flush_cv_mtx_);
+    }
+    flush_cv_.notify_one();
+  }
+
+  write_controller_->update_immutable_memtables(
+      memtable.get_frozen_table_num());
+  auto state = write_controller_->get_state();
+  if (state == WriteStallState::Normal) {
+    return;
+  }
+
+  if (state == WriteStallState::Delayed) {
+    // 刷盘或 compact 开始落后, 按照令牌桶平滑地降低写入速度
+    uint64_t delay_us = write_controller_->get_delay_us(write_bytes);
+    if (delay_us > 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    }
+    return;
+  }
+
+  // 已经严重落后, 阻塞当前写入直到刷盘或 compact 追上
+  auto stats = write_controller_->get_stats();
+  spdlog::warn("LSMEngine--"
+               "Write stall: l0_files={}, immutable_memtables={}, "
+               "pending_compaction_bytes={}",
+               stats.l0_files, stats.immutable_memtables,
+               stats.pending_compaction_bytes);
+  write_controller_->record_stop();
+
+  std::unique_lock<std::mutex> lock(flush_cv_mtx_);
+  while (!stop_flush_ &&
+         write_controller_->get_state() == WriteStallState::Stopped) {
+    write_stall_cv_.wait_for(lock, std::chrono::milliseconds(100));
+    write_controller_->update_immutable_memtables(
+        memtable.get_frozen_table_num());
+    if (write_controller_->get_state() == WriteStallState::Stopped) {
+      // 失败的 compact 不会立即重试, 写入被阻塞时也不会再有新的刷盘,
+      // 因此需要主动调度, 避免永远阻塞
+      lock.unlock();
+      maybe_schedule_compaction();
+      lock.lock();
+    }
+  }
+}
+
+void LSMEngine::flush_worker() {
+  auto need_flush = [this] {
+    return memtable.get_total_size() >= tol_mem_size_limit();
+  };
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(flush_cv_mtx_);
+      flush_cv_.wait(lock, [&] { return stop_flush_ || need_flush(); });
+      if (stop_flush_) {
+        break;
+      }
+    }
+
+    try {
+      flush();
+    } catch (const std::exception &e) {
+      spdlog::error("LSMEngine--"
+                    "Background flush failed: {}",
+                    e.what());
+      // 避免持续失败时空转
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(flush_cv_mtx_);
+    }
+    write_stall_cv_.notify_all();
+  }
+
+  spdlog::debug("LSMEngine--"
+                "Background flush thread stopped");
+}
+
+void LSMEngine::hot_blocks_worker() {
+  warm_up_block_cache();
+  {
+    std::lock_guard<std::mutex> lock(hot_blocks_mtx_);
+    warm_up_done_ = true;
+  }
+  hot_blocks_cv_.notify_all();
+
+  auto interval = std::chrono::seconds(
+      TomlConfig::getInstance().getLsmHotBlocksPersistInterval());
+  std::unique_lock<std::mutex> lock(hot_blocks_mtx_);
+  while (true) {
+    if (interval.count() > 0) {
+      hot_blocks_cv_.wait_for(lock, interval,
+                              [this] { return stop_hot_blocks_; });
+    } else {
+      hot_blocks_cv_.wait(lock, [this] { return stop_hot_blocks_; });
+    }
+    if (stop_hot_blocks_) {
+      break;
+    }
+    lock.unlock();
+    persist_hot_blocks();
+    lock.lock();
+  }
+}
+
+void LSMEngine::warm_up_block_cache() {
+  auto keys = HotBlockList::load(get_hot_blocks_path());
+  if (keys.empty()) {
+    return;
+  }
+
+  std::map<size_t, std::vector<size_t>> blocks_by_sst;
+  for (auto &[sst_id, block_id] : keys) {
+    blocks_by_sst[sst_id].push_back(block_id);
+  }
+  std::unordered_map<size_t, std::shared_ptr<SST>> live_ssts;
+  auto version = current_version();
+  for (auto &[level, level_ssts] : version->levels) {
+    for (auto &sst : level_ssts) {
+      live_ssts[sst->get_sst_id()] = sst;
+    }
+  }
+
+  size_t loaded = 0;
+  for (auto &[sst_id, block_ids] : blocks_by_sst) {
+    {
+      std::lock_guard<std::mutex> lock(hot_blocks_mtx_);
+      if (stop_hot_blocks_) {
+        break;
+      }
+    }
+    // 保存列表之后被 compact 删除的 sst 不再需要预热
+    auto it = live_ssts.find(sst_id);
+    if (it == live_ssts.end()) {
+      continue;
+    }
+    try {
+      loaded += it->second->prefetch_blocks(std::move(block_ids));
+    } catch (const std::exception &e) {
+      spdlog::warn("LSMEngine--"
+                   "Failed to warm up blocks of sst {}: {}",
+                   sst_id, e.what());
+    }
+  }
+  spdlog::info("LSMEngine--"
+               "Warmed up block cache with {} of {} hot blocks",
+               loaded, keys.size());
+}
+
+void LSMEngine::persist_hot_blocks() {
+  auto keys = block_cache->hot_keys(
+      TomlConfig::getInstance().getLsmHotBlocksMaxEntries());
+  if (keys.empty()) {
+    // 缓存为空时保留之前的列表
+    return;
+  }
+  try {
+    HotBlockList::save(get_hot_blocks_path(), keys);
+  } catch (const std::exception &e) {
+    spdlog::warn("LSMEngine--"
+                 "Failed to persist hot blocks: {}",
+                 e.what());
+  }
+}
+
+void LSMEngine::wait_for_warm_up() {
+  std::unique_lock<std::mutex> lock(hot_blocks_mtx_);
+  hot_blocks_cv_.wait(lock, [this] { return warm_up_done_; });
+}
+
+void LSMEngine::load_from_directory() {
+  // SST文件名格式为: sst_{id}.level
+  std::vector<std::pair<size_t, size_t>> files; // (sst_id, level)
+  for (const auto &entry : std::filesystem::directory_iterator(data_dir)) {
+    std::string filename = entry.path().filename().string();
+    size_t dot_pos = filename.find('.');
+    if (!entry.is_regular_file() || !filename.starts_with("sst_") ||
+        dot_pos == std::string::npos || dot_pos == filename.length() - 1 ||
+        dot_pos == 4) {
+      continue;
+    }
+    size_t level = std::stoull(filename.substr(dot_pos + 1));
+    size_t sst_id = std::stoull(filename.substr(4, dot_pos - 4));
+    files.emplace_back(sst_id, level);
+  }
+
+  // 读取 footer、解码布隆过滤器和元数据块并校验, 各文件之间互不依赖
+  std::vector<std::shared_ptr<SST>> opened(files.size());
+  if (!files.empty()) {
+    size_t thread_num = std::clamp<size_t>(std::thread::hardware_concurrency(),
+                                           1, files.size());
+    ThreadPool pool(thread_num);
+    std::vector<std::future<std::shared_ptr<SST>>> futures;
+    for (auto &[sst_id, level] : files) {
+      futures.push_back(pool.submit([this, sst_id, level] {
+        auto sst_path = get_sst_path(sst_id, level);
+        return SST::open(sst_id,
+                         FileObj::open(sst_path, false, direct_io_pool),
+                         block_cache);
+      }));
+    }
+    // 即使有文件打开失败也要等待所有任务结束, 再抛出第一个异常
+    std::exception_ptr error;
+    for (size_t i = 0; i < futures.size(); i++) {
+      try {
+        opened[i] = futures[i].get();
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    spdlog::info("LSMEngine--"
+                 "Loaded {} SSTs with {} threads",
+                 files.size(), thread_num);
+  }
+
+  std::unique_lock<std::shared_mutex> lock(ssts_mtx);
+  size_t max_sst_id = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    auto [sst_id, level] = files[i];
+    opened[i]->attach_table_cache(table_cache);
+    ssts[sst_id] = opened[i];
+    level_sst_ids[level].push_back(sst_id);
+    // 记录目前最大的 sst_id 和 level
+    max_sst_id = std::max(sst_id, max_sst_id);
+    cur_max_level = std::max(level, cur_max_level);
+  }
+  // 现有的最大 sst_id 自增后才是下一个分配的 sst_id
+  next_sst_id = max_sst_id + 1;
+
+  for (auto &[level, sst_id_list] : level_sst_ids) {
+    if (level == 0) {
+      // l0 按照 id 从大到小排列, 越新的 sst 越先查询
+      std::sort(sst_id_list.begin(), sst_id_list.end(), std::greater<size_t>());
+    } else {
+      // 其他 level 的 sst 没有重叠, 部分 compact 之后 id 与 key
+      // 的顺序不再一致, 需要按照 first_key 排序
+      sort_level_by_key(level);
+    }
+  }
+}
+
+void LSMEngine::load_from_manifest() {
+  auto state = Manifest::recover(data_dir);
+  std::unordered_map<size_t, size_t> live_levels; // sst_id -> level
+  for (auto &[level, metas] : state.levels) {
+    for (auto &[sst_id, meta] : metas) {
+      live_levels[sst_id] = level;
+    }
+  }
+
+  // 把目录中的文件与 MANIFEST 对齐:
+  // 不在 MANIFEST 中的文件是未安装的输出或未删完的输入, 直接删除;
+  // level 后缀不一致的文件是 trivial move 重命名之后没来得及记录的
+  size_t max_file_id = 0;
+  std::unordered_set<size_t> found_ids;
+  for (const auto &entry : std::filesystem::directory_iterator(data_dir)) {
+    std::string filename = entry.path().filename().string();
+    size_t dot_pos = filename.find('.');
+    if (!entry.is_regular_file() || !filename.starts_with("sst_") ||
+        dot_pos == std::string::npos || dot_pos == filename.length() - 1) {
+      continue;
+    }
+    size_t level = std::stoull(filename.substr(dot_pos + 1));
+    size_t sst_id = std::stoull(filename.substr(4, dot_pos - 4));
+    max_file_id = std::max(max_file_id, sst_id);
+
+    auto it = live_levels.find(sst_id);
+    if (it == live_levels.end()) {
+      std::filesystem::remove(entry.path());
+      spdlog::info("LSMEngine--"
+                   "Removed SST {} which is not in MANIFEST",
+                   filename);
+      continue;
+    }
+    if (it->second != level) {
+      std::filesystem::rename(entry.path(), get_sst_path(sst_id, it->second));
+      spdlog::info("LSMEngine--"
+                   "Renamed SST {} to level{} according to MANIFEST",
+                   filename, it->second);
+    }
+    found_ids.insert(sst_id);
+  }
+
+  std::unique_lock<std::shared_mutex> lock(ssts_mtx);
+  for (auto &[level, metas] : state.levels) {
+    for (auto &[sst_id, meta] : metas) {
+      if (!found_ids.count(sst_id)) {
+        throw std::runtime_error("SST file in MANIFEST is missing: " +
+                                 get_sst_path(sst_id, level));
+      }
+      ssts[sst_id] =
+          SST::open_lazy(meta, get_sst_path(sst_id, level), block_cache);
+      ssts[sst_id]->set_direct_io(direct_io_pool);
+      ssts[sst_id]->attach_table_cache(table_cache);
+      level_sst_ids[level].push_back(sst_id);
+      cur_max_level = std::max(level, cur_max_level);
+    }
+    if (level == 0) {
+      // l0 按照 id 从大到小排列, 越新的 sst 越先查询
+      auto &ids = level_sst_ids[0];
+      std::sort(ids.begin(), ids.end(), std::greater<size_t>());
+    } else {
+      sort_level_by_key(level);
+    }
+  }
+  next_sst_id = std::max(state.next_sst_id, max_file_id + 1);
+  spdlog::info("LSMEngine--"
+               "Loaded {} SSTs from MANIFEST, next_sst_id={}",
+               ssts.size(), next_sst_id.load());
+}
+
+VersionEdit LSMEngine::snapshot_edit_locked() {
+  VersionEdit edit;
+  for (auto &[level, sst_ids] : level_sst_ids) {
+    for (auto sst_id : sst_ids) {
+      edit.added.emplace_back(level, ssts.at(sst_id)->get_file_meta());
+    }
+  }
+  edit.next_sst_id = next_sst_id.load();
+  return edit;
+}
+
+void LSMEngine::maybe_rewrite_manifest_locked() {
+  // 配置为负数时不重写
+  long long max_size = TomlConfig::getInstance().getLsmMaxManifestFileSize();
+  if (max_size < 0 || manifest_->size() <= static_cast<size_t>(max_size)) {
+    return;
+  }
+  manifest_->write_snapshot(snapshot_edit_locked());
+  spdlog::debug("LSMEngine--"
+                "Rewrote MANIFEST as a snapshot of {} SSTs",
+                ssts.size());
+}
+
 std::string LSMEngine::get_sst_path(size_t sst_id, size_t target_level) {
   // sst的文件路径格式为: data_dir/sst_<sst_id>，sst_id格式化为32位数字
   std::stringstream ss;
@@ -494,6 +1081,15 @@ std::string LSMEngine::get_sst_path(size_t sst_id, size_t target_level) {
   return ss.str();
 }
 
+std::string LSMEngine::get_hot_blocks_path() const {
+  return data_dir + "/HOT_BLOCKS";
+}
+
+std::string LSMEngine::get_secondary_cache_path() const {
+  const auto &path = TomlConfig::getInstance().getLsmSecondaryCachePath();
+  return path.empty() ? data_dir + "/secondary_cache" : path;
+}
+
 std::optional<std::pair<TwoMergeIterator, TwoMergeIterator>>
 LSMEngine::lsm_iters_monotony_predicate(
     uint64_t tranc_id, std::function<int(const std::string &)> predicate) {
@@ -501,11 +1097,12 @@ LSMEngine::lsm_iters_monotony_predicate(
   //  先从 memtable 中查询
   auto mem_result = memtable.iters_monotony_predicate(tranc_id, predicate);
 
-  // 再从 sst 中查询
+  // 再从 sst 中查询, sst 的结果会被全部物化
+  auto version = current_version();
   std::vector<SearchItem> item_vec;
-  for (auto &[sst_level, sst_ids] : level_sst_ids) {
-    for (auto &sst_id : sst_ids) {
-      auto sst = ssts[sst_id];
+  for (auto &[sst_level, level_ssts] : version->levels) {
+    for (auto &sst : level_ssts) {
+      auto sst_id = sst->get_sst_id();
       auto result = sst_iters_monotony_predicate(sst, tranc_id, predicate);
       if (!result.has_value()) {
         continue;
@@ -559,165 +1156,573 @@ LSMEngine::lsm_iters_monotony_predicate(
   }
 }
 
-Level_Iterator LSMEngine::begin(uint64_t tranc_id) {
-  return Level_Iterator(shared_from_this(), tranc_id);
+std::shared_ptr<const Version> LSMEngine::current_version() const {
+  return current_version_.load();
+}
+
+void LSMEngine::publish_version_locked() {
+  auto version = std::make_shared<Version>();
+  int pin_max_level = TomlConfig::getInstance().getLsmPinIndexFilterMaxLevel();
+  for (auto &[level, sst_ids] : level_sst_ids) {
+    if (sst_ids.empty()) {
+      continue;
+    }
+    auto &level_ssts = version->levels[level];
+    for (auto &sst_id : sst_ids) {
+      auto &sst = ssts.at(sst_id);
+      // 上层的 sst 几乎每次查询都会访问, 索引和布隆过滤器常驻内存
+      // trivial move 到更深 level 之后重新交给 TableCache 管理
+      sst->set_pin_reader(static_cast<int>(level) <= pin_max_level);
+      level_ssts.push_back(sst);
+    }
+    version->max_level = std::max(version->max_level, level);
+  }
+  // 之前的 Version 在最后一个读者释放后析构
+  current_version_.store(std::move(version));
+}
+
+Level_Iterator LSMEngine::begin(uint64_t tranc_id, bool fill_cache) {
+  return Level_Iterator(shared_from_this(), tranc_id, fill_cache);
 }
 
 Level_Iterator LSMEngine::end() { return Level_Iterator{}; }
 //-----------------------compact-----------------------------------------------------
-void LSMEngine::full_compact(size_t src_level) {
-  // 将 src_level 的 sst 全体压缩到 src_level + 1
+double LSMEngine::level_score(size_t level) {
+  auto it = level_sst_ids.find(level);
+  if (it == level_sst_ids.end() || it->second.empty()) {
+    return 0;
+  }
+
+  double ratio = TomlConfig::getInstance().getLsmSstLevelRatio();
+  if (level == 0) {
+    // l0 的 sst 之间有重叠, 读放大取决于 sst 的数量
+    return it->second.size() / ratio;
+  }
 
-  // 递归地判断下一级 level 是否需要 full compact
-  if (level_sst_ids[src_level + 1].size() >=
-      TomlConfig::getInstance().getLsmSstLevelRatio()) {
-    full_compact(src_level + 1);
+  // 其他 level 按照总字节数与该 level 容量的比值计算
+  size_t level_bytes = 0;
+  for (auto &sst_id : it->second) {
+    level_bytes += ssts[sst_id]->sst_size();
   }
+  return level_bytes / (ratio * get_sst_size(level));
+}
 
-  spdlog::debug("LSMEngine--"
-                "Compaction: Starting full compaction from level{} to level{}",
-                src_level, src_level + 1);
+std::optional<CompactionTask> LSMEngine::pick_compaction() {
+  std::shared_lock<std::shared_mutex> rlock(ssts_mtx);
 
-  // 获取源level和目标level的 sst_id
-  auto old_level_id_x = level_sst_ids[src_level];
-  auto old_level_id_y = level_sst_ids[src_level + 1];
-  std::vector<std::shared_ptr<SST>> new_ssts;
-  std::vector<size_t> lx_ids(old_level_id_x.begin(), old_level_id_x.end());
-  std::vector<size_t> ly_ids(old_level_id_y.begin(), old_level_id_y.end());
-  if (src_level == 0) {
-    // l0这一层不同sst的key有重叠, 需要额外处理
-    new_ssts = full_l0_l1_compact(lx_ids, ly_ids);
-  } else {
-    new_ssts = full_common_compact(lx_ids, ly_ids, src_level + 1);
+  std::optional<CompactionTask> task;
+  for (size_t level = 0; level <= cur_max_level; level++) {
+    if (compacting_levels_.count(level) ||
+        compacting_levels_.count(level + 1)) {
+      continue;
+    }
+    double score = level_score(level);
+    if (score < 1 || (task.has_value() && score <= task->score)) {
+      continue;
+    }
+    task = CompactionTask{};
+    task->src_level = level;
+    task->dst_level = level + 1;
+    task->score = score;
   }
-  // 完成 compact 后移除旧的sst记录
-  for (auto &old_sst_id : old_level_id_x) {
-    ssts[old_sst_id]->del_sst();
-    ssts.erase(old_sst_id);
+  if (!task.has_value()) {
+    return std::nullopt;
   }
-  for (auto &old_sst_id : old_level_id_y) {
-    ssts[old_sst_id]->del_sst();
-    ssts.erase(old_sst_id);
+
+  // 快照输入 sst, 执行期间 src_level 和 dst_level 都被标记为忙碌,
+  // 除了刷盘向 l0 头部插入新的 sst 外不会有其他修改
+  if (task->src_level == 0) {
+    // l0 的 sst 之间有重叠, 需要全部参与
+    for (auto &sst_id : level_sst_ids[0]) {
+      task->src_ssts.push_back(ssts[sst_id]);
+    }
+  } else {
+    task->type = CompactType::PartialCompact;
+    task->src_ssts.push_back(pick_sst_to_compact(task->src_level));
   }
-  level_sst_ids[src_level].clear();
-  level_sst_ids[src_level + 1].clear();
 
-  cur_max_level = std::max(cur_max_level, src_level + 1);
+  // dst_level 中只有与输入 key 范围重叠的 sst 需要重写
+  std::string first_key = task->src_ssts.front()->get_first_key();
+  std::string last_key = task->src_ssts.front()->get_last_key();
+  for (auto &sst : task->src_ssts) {
+    first_key = std::min(first_key, sst->get_first_key());
+    last_key = std::max(last_key, sst->get_last_key());
+  }
+  task->dst_ssts = overlapping_ssts(task->dst_level, first_key, last_key);
+
+  // 更深的 level 正在参与的 compact 都需要 dst_level, 期间不会写入新的数据
+  task->bottommost = true;
+  for (size_t level = task->dst_level + 1; level <= cur_max_level; level++) {
+    auto level_it = level_sst_ids.find(level);
+    if (level_it != level_sst_ids.end() && !level_it->second.empty()) {
+      task->bottommost = false;
+      break;
+    }
+  }
 
-  // 添加新的sst
-  for (auto &new_sst : new_ssts) {
-    level_sst_ids[src_level + 1].push_back(new_sst->get_sst_id());
-    ssts[new_sst->get_sst_id()] = new_sst;
+  // 输入之间以及与下一层都没有重叠时, 直接把文件移动到下一层
+  if (task->dst_ssts.empty()) {
+    auto sorted = task->src_ssts;
+    std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) {
+      return a->get_first_key() < b->get_first_key();
+    });
+    bool overlap = false;
+    for (size_t i = 1; i < sorted.size(); i++) {
+      if (sorted[i - 1]->get_last_key() >= sorted[i]->get_first_key()) {
+        overlap = true;
+        break;
+      }
+    }
+    if (!overlap) {
+      task->type = CompactType::TrivialMove;
+    }
   }
-  // 此处没必要reverse了
-  std::sort(level_sst_ids[src_level + 1].begin(),
-            level_sst_ids[src_level + 1].end());
+  return task;
+}
 
-  spdlog::debug("LSMEngine--"
-                "Compaction: Finished compaction. New SSTs added at level{}",
-                src_level + 1);
+std::shared_ptr<SST> LSMEngine::pick_sst_to_compact(size_t level) {
+  // 从上次 compact 结束的位置继续, 让整个 level 的 key 空间轮流被 compact
+  auto &ids = level_sst_ids[level];
+  auto &pointer = compact_pointer_[level];
+  auto it = std::find_if(ids.begin(), ids.end(), [&](size_t id) {
+    return ssts[id]->get_first_key() > pointer;
+  });
+  auto sst = ssts[it == ids.end() ? ids.front() : *it];
+  pointer = sst->get_last_key();
+  return sst;
 }
 
 std::vector<std::shared_ptr<SST>>
-LSMEngine::full_l0_l1_compact(std::vector<size_t> &l0_ids,
-                              std::vector<size_t> &l1_ids) {
-  // TODO: 这里需要补全的是对已经完成事务的删除
-  std::vector<SstIterator> l0_iters;
-  std::vector<std::shared_ptr<SST>> l1_ssts;
-
-  for (auto id : l0_ids) {
-    auto sst_it = ssts[id]->begin(0);
-    l0_iters.push_back(sst_it);
+LSMEngine::overlapping_ssts(size_t level, const std::string &first_key,
+                            const std::string &last_key) {
+  std::vector<std::shared_ptr<SST>> res;
+  auto level_it = level_sst_ids.find(level);
+  if (level_it == level_sst_ids.end()) {
+    return res;
   }
-  for (auto id : l1_ids) {
-    l1_ssts.push_back(ssts[id]);
+  for (auto &sst_id : level_it->second) {
+    auto &sst = ssts[sst_id];
+    if (sst->get_last_key() < first_key) {
+      continue;
+    }
+    if (sst->get_first_key() > last_key) {
+      break; // 按 first_key 有序, 后面的都不会重叠
+    }
+    res.push_back(sst);
   }
-  // l0 的sst之间的key有重叠, 需要合并
-  auto [l0_begin, l0_end] = SstIterator::merge_sst_iterator(l0_iters, 0);
+  return res;
+}
 
-  std::shared_ptr<HeapIterator> l0_begin_ptr = std::make_shared<HeapIterator>();
-  *l0_begin_ptr = l0_begin;
+void LSMEngine::sort_level_by_key(size_t level) {
+  auto &ids = level_sst_ids[level];
+  std::sort(ids.begin(), ids.end(), [this](size_t a, size_t b) {
+    return ssts[a]->get_first_key() < ssts[b]->get_first_key();
+  });
+}
 
-  std::shared_ptr<ConcactIterator> old_l1_begin_ptr =
-      std::make_shared<ConcactIterator>(l1_ssts, 0);
+void LSMEngine::schedule_compaction_locked() {
+  while (!stop_compact_) {
+    auto task = pick_compaction();
+    if (!task.has_value()) {
+      return;
+    }
 
-  TwoMergeIterator l0_l1_begin(l0_begin_ptr, old_l1_begin_ptr, 0);
+    spdlog::debug("LSMEngine--"
+                  "Compaction: Scheduling compaction from level{} to level{}, "
+                  "score={:.2f}",
+                  task->src_level, task->dst_level, task->score);
 
-  return gen_sst_from_iter(l0_l1_begin,
-                           TomlConfig::getInstance().getLsmPerMemSizeLimit() *
-                               TomlConfig::getInstance().getLsmSstLevelRatio(),
-                           1);
+    // 之后开始的快照只会更新, 调度时的值对执行期间的所有快照都足够保守
+    if (oldest_snapshot_provider_) {
+      task->oldest_snapshot = oldest_snapshot_provider_();
+    }
+    compacting_levels_.insert(task->src_level);
+    compacting_levels_.insert(task->dst_level);
+    running_compactions_++;
+    compact_pool_->submit(&LSMEngine::run_compaction, this,
+                          std::move(task.value()));
+  }
 }
 
-std::vector<std::shared_ptr<SST>>
-LSMEngine::full_common_compact(std::vector<size_t> &lx_ids,
-                               std::vector<size_t> &ly_ids, size_t level_y) {
-  // TODO 需要补全已完成事务的滤除
-  std::vector<std::shared_ptr<SST>> lx_iters;
-  std::vector<std::shared_ptr<SST>> ly_iters;
+void LSMEngine::maybe_schedule_compaction() {
+  std::lock_guard<std::mutex> lock(compact_mtx_);
+  schedule_compaction_locked();
+}
+
+void LSMEngine::set_oldest_snapshot_provider(
+    std::function<uint64_t()> provider) {
+  std::lock_guard<std::mutex> lock(compact_mtx_);
+  oldest_snapshot_provider_ = std::move(provider);
+}
+
+void LSMEngine::wait_for_compaction() {
+  std::unique_lock<std::mutex> lock(compact_mtx_);
+  compact_cv_.wait(lock, [this] { return running_compactions_ == 0; });
+}
+
+size_t LSMEngine::estimate_pending_compaction_bytes() {
+  size_t pending_bytes = 0;
+  size_t ratio = TomlConfig::getInstance().getLsmSstLevelRatio();
+  for (auto &[level, sst_ids] : level_sst_ids) {
+    size_t level_bytes = 0;
+    for (auto &sst_id : sst_ids) {
+      level_bytes += ssts.at(sst_id)->sst_size();
+    }
+    if (level == 0) {
+      // l0 达到 compact 条件后全部都需要合并到 l1
+      if (sst_ids.size() >= ratio) {
+        pending_bytes += level_bytes;
+      }
+    } else if (level_bytes > ratio * get_sst_size(level)) {
+      pending_bytes += level_bytes - ratio * get_sst_size(level);
+    }
+  }
+  return pending_bytes;
+}
 
-  for (auto id : lx_ids) {
-    lx_iters.push_back(ssts[id]);
+void LSMEngine::update_write_stall_condition() {
+  size_t l0_files = 0;
+  size_t pending_bytes = 0;
+  {
+    std::shared_lock<std::shared_mutex> rlock(ssts_mtx);
+    auto it = level_sst_ids.find(0);
+    if (it != level_sst_ids.end()) {
+      l0_files = it->second.size();
+    }
+    pending_bytes = estimate_pending_compaction_bytes();
   }
-  for (auto id : ly_ids) {
-    ly_iters.push_back(ssts[id]);
+  write_controller_->update_lsm_condition(l0_files, pending_bytes);
+}
+
+WriteControllerStats LSMEngine::get_write_stall_stats() const {
+  return write_controller_->get_stats();
+}
+
+void LSMEngine::run_compaction(const CompactionTask &task) {
+  spdlog::debug("LSMEngine--"
+                "Compaction: Starting compaction from level{} to level{}, "
+                "{} + {} input ssts",
+                task.src_level, task.dst_level, task.src_ssts.size(),
+                task.dst_ssts.size());
+
+  bool success = false;
+  try {
+    // 构建输出 sst 时不持有 ssts_mtx, 读取和刷盘可以并发进行
+    std::vector<std::shared_ptr<SST>> new_ssts;
+    if (task.type == CompactType::TrivialMove) {
+      // level 编码在文件名中, 重命名即可完成移动
+      for (auto &sst : task.src_ssts) {
+        sst->rename_sst(get_sst_path(sst->get_sst_id(), task.dst_level));
+      }
+      new_ssts = task.src_ssts;
+      spdlog::debug("LSMEngine--"
+                    "Compaction: Trivial move {} ssts from level{} to level{}",
+                    task.src_ssts.size(), task.src_level, task.dst_level);
+    } else if (task.src_level == 0) {
+      // l0这一层不同sst的key有重叠, 需要额外处理
+      new_ssts = l0_l1_compact(task);
+    } else {
+      new_ssts = common_compact(task);
+    }
+    install_compaction(task, new_ssts);
+    success = true;
+  } catch (const std::exception &e) {
+    spdlog::error("LSMEngine--"
+                  "Compaction from level{} to level{} failed: {}",
+                  task.src_level, task.dst_level, e.what());
   }
 
-  std::shared_ptr<ConcactIterator> old_lx_begin_ptr =
-      std::make_shared<ConcactIterator>(lx_iters, 0);
+  {
+    std::lock_guard<std::mutex> lock(compact_mtx_);
+    compacting_levels_.erase(task.src_level);
+    compacting_levels_.erase(task.dst_level);
+    // 先调度后续任务再减少计数, wait_for_compaction 不会提前返回
+    // 失败时不立即重试, 等待下一次刷盘再调度
+    if (success) {
+      schedule_compaction_locked();
+    }
+    running_compactions_--;
+  }
+  compact_cv_.notify_all();
+}
+
+void LSMEngine::install_compaction(
+    const CompactionTask &task, std::vector<std::shared_ptr<SST>> &new_ssts) {
+  std::unordered_set<size_t> old_ids;
+  for (auto &sst : task.src_ssts) {
+    old_ids.insert(sst->get_sst_id());
+  }
+  for (auto &sst : task.dst_ssts) {
+    old_ids.insert(sst->get_sst_id());
+  }
+  // trivial move 的输出就是输入本身, 对应的文件不能删除
+  std::unordered_set<size_t> new_ids;
+  for (auto &sst : new_ssts) {
+    new_ids.insert(sst->get_sst_id());
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> lock(ssts_mtx); // 写锁
+
+    // 输入的删除和输出的添加作为一条记录写入 MANIFEST, 重启后不会只生效一半
+    // trivial move 记录为从 src_level 删除并添加到 dst_level
+    VersionEdit edit;
+    for (auto &sst : task.src_ssts) {
+      edit.deleted.emplace_back(task.src_level, sst->get_sst_id());
+    }
+    for (auto &sst : task.dst_ssts) {
+      edit.deleted.emplace_back(task.dst_level, sst->get_sst_id());
+    }
+    for (auto &sst : new_ssts) {
+      edit.added.emplace_back(task.dst_level, sst->get_file_meta());
+    }
+    edit.next_sst_id = next_sst_id.load();
+    manifest_->log_edit(edit);
+
+    // 只移除参与 compact 的 sst, 期间新刷入 l0 的 sst 需要保留
+    for (auto level : {task.src_level, task.dst_level}) {
+      auto &ids = level_sst_ids[level];
+      ids.erase(std::remove_if(ids.begin(), ids.end(),
+                               [&](size_t id) { return old_ids.count(id); }),
+                ids.end());
+    }
+    for (auto &old_sst_id : old_ids) {
+      ssts.erase(old_sst_id);
+    }
+
+    // 添加新的sst
+    auto &dst_ids = level_sst_ids[task.dst_level];
+    for (auto &new_sst : new_ssts) {
+      dst_ids.push_back(new_sst->get_sst_id());
+      ssts[new_sst->get_sst_id()] = new_sst;
+    }
+    sort_level_by_key(task.dst_level);
 
-  std::shared_ptr<ConcactIterator> old_ly_begin_ptr =
-      std::make_shared<ConcactIterator>(ly_iters, 0);
+    cur_max_level = std::max(cur_max_level, task.dst_level);
+    publish_version_locked();
+    maybe_rewrite_manifest_locked();
+  }
 
-  TwoMergeIterator lx_ly_begin(old_lx_begin_ptr, old_ly_begin_ptr, 0);
+  // 删除已经记录到 MANIFEST 且新的版本已经可见, 旧文件可以删除了
+  for (auto &sst : task.src_ssts) {
+    if (!new_ids.count(sst->get_sst_id())) {
+      sst->del_sst();
+    }
+  }
+  for (auto &sst : task.dst_ssts) {
+    sst->del_sst();
+  }
 
-  // TODO:如果目标 level 的下一级 level+1 不存在, 则为底层的level,
-  // 可以清理掉删除标记
+  // l0 sst 数量和待 compact 的数据量都可能下降, 唤醒被阻塞的写入
+  update_write_stall_condition();
+  {
+    std::lock_guard<std::mutex> lock(flush_cv_mtx_);
+  }
+  write_stall_cv_.notify_all();
 
-  return gen_sst_from_iter(lx_ly_begin, LSMEngine::get_sst_size(level_y),
-                           level_y);
+  spdlog::debug("LSMEngine--"
+                "Compaction: Finished compaction. New SSTs added at level{}",
+                task.dst_level);
 }
 
 std::vector<std::shared_ptr<SST>>
-LSMEngine::gen_sst_from_iter(BaseIterator &iter, size_t target_sst_size,
-                             size_t target_level) {
-  // TODO: 这里需要补全的是对已经完成事务的删除
+LSMEngine::l0_l1_compact(const CompactionTask &task) {
+  auto boundaries = subcompaction_boundaries(task.src_ssts, task.dst_ssts);
+  if (boundaries.empty()) {
+    return l0_l1_subcompact(task, std::nullopt, std::nullopt);
+  }
 
-  std::vector<std::shared_ptr<SST>> new_ssts;
-  auto new_sst_builder =
-      SSTBuilder(TomlConfig::getInstance().getLsmBlockSize(), true);
-  while (iter.is_valid() && !iter.is_end()) {
+  spdlog::debug("LSMEngine--"
+                "Compaction: Splitting level0 compaction into {} "
+                "subcompactions",
+                boundaries.size() + 1);
+
+  // 子区间 i 为 [boundaries[i-1], boundaries[i]), 两端的区间无边界
+  auto range_start = [&](size_t i) -> std::optional<std::string> {
+    return i == 0 ? std::nullopt : std::make_optional(boundaries[i - 1]);
+  };
+  auto range_end = [&](size_t i) -> std::optional<std::string> {
+    return i == boundaries.size() ? std::nullopt
+                                  : std::make_optional(boundaries[i]);
+  };
+
+  std::vector<std::future<std::vector<std::shared_ptr<SST>>>> futures;
+  for (size_t i = 1; i <= boundaries.size(); i++) {
+    futures.push_back(subcompact_pool_->submit(
+        &LSMEngine::l0_l1_subcompact, this, std::cref(task), range_start(i),
+        range_end(i)));
+  }
+
+  // 各子区间互不重叠, 按区间顺序拼接即为 key 有序的输出
+  std::vector<std::vector<std::shared_ptr<SST>>> results(futures.size() + 1);
+  std::exception_ptr error;
+  try {
+    results[0] = l0_l1_subcompact(task, range_start(0), range_end(0));
+  } catch (...) {
+    error = std::current_exception();
+  }
+  // 即使有子区间失败也要等待所有任务结束, 它们引用了调用方的输入
+  for (size_t i = 0; i < futures.size(); i++) {
+    try {
+      results[i + 1] = futures[i].get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
 
-    new_sst_builder.add((*iter).first, (*iter).second, 0);
-    ++iter;
+  std::vector<std::shared_ptr<SST>> new_ssts;
+  for (auto &result : results) {
+    new_ssts.insert(new_ssts.end(), result.begin(), result.end());
+  }
+  if (error) {
+    // 整个 compact 失败, 已经生成的输出不会被安装
+    for (auto &sst : new_ssts) {
+      sst->del_sst();
+    }
+    std::rethrow_exception(error);
+  }
+  return new_ssts;
+}
 
-    if (new_sst_builder.estimated_size() >= target_sst_size) {
-      size_t sst_id = next_sst_id++; // TODO: 后续优化并发性
-      std::string sst_path = get_sst_path(sst_id, target_level);
-      auto new_sst = new_sst_builder.build(sst_id, sst_path, this->block_cache);
-      new_ssts.push_back(new_sst);
+std::vector<std::string> LSMEngine::subcompaction_boundaries(
+    const std::vector<std::shared_ptr<SST>> &l0_ssts,
+    const std::vector<std::shared_ptr<SST>> &l1_ssts) {
+  if (!subcompact_pool_) {
+    return {};
+  }
 
-      spdlog::debug("LSMEngine--"
-                    "Compaction: Generated new SST file with sst_id={}"
-                    "at level{}",
-                    sst_id, target_level);
+  // 每个子区间平均至少能产出一个完整的 l1 sst, 避免输出过于碎片化
+  size_t total_size = 0;
+  std::vector<std::string> block_keys;
+  for (auto &ssts : {std::cref(l0_ssts), std::cref(l1_ssts)}) {
+    for (auto &sst : ssts.get()) {
+      total_size += sst->sst_size();
+      // 分隔 key 同样把 block 切开, 可以作为切分点
+      auto index = sst->get_block_index();
+      for (size_t i = 0; i < index->size(); i++) {
+        block_keys.emplace_back(index->separator(i));
+      }
+    }
+  }
+  size_t num_ranges = std::min<size_t>(
+      TomlConfig::getInstance().getLsmMaxSubcompactions(),
+      total_size / get_sst_size(1));
+  if (num_ranges <= 1) {
+    return {};
+  }
 
-      new_sst_builder = SSTBuilder(TomlConfig::getInstance().getLsmBlockSize(),
-                                   true); // 重置builder
+  // block 大小基本一致, 按 block 数量等分近似于按数据量等分
+  std::sort(block_keys.begin(), block_keys.end());
+  block_keys.erase(std::unique(block_keys.begin(), block_keys.end()),
+                   block_keys.end());
+  std::vector<std::string> boundaries;
+  for (size_t i = 1; i < num_ranges; i++) {
+    auto &key = block_keys[i * block_keys.size() / num_ranges];
+    // 第一个 key 作为切分点会产生空区间
+    if (key != block_keys.front() &&
+        (boundaries.empty() || boundaries.back() != key)) {
+      boundaries.push_back(key);
     }
   }
-  if (new_sst_builder.estimated_size() > 0) {
-    size_t sst_id = next_sst_id++; // TODO: 后续优化并发性
-    std::string sst_path = get_sst_path(sst_id, target_level);
+  return boundaries;
+}
+
+std::vector<std::shared_ptr<SST>> LSMEngine::l0_l1_subcompact(
+    const CompactionTask &task, const std::optional<std::string> &start_key,
+    const std::optional<std::string> &end_key) {
+  // l0 的 sst 之间的 key 有重叠, 每个 sst 单独作为一路输入
+  // src_ssts 按照从新到旧排列, l1 比所有 l0 都旧
+  std::vector<std::vector<std::shared_ptr<SST>>> runs;
+  for (auto &sst : task.src_ssts) {
+    runs.push_back({sst});
+  }
+  runs.push_back(task.dst_ssts);
+  CompactIterator iter(std::move(runs), start_key, end_key);
+
+  return gen_sst_from_iter(iter, get_sst_size(1), task);
+}
+
+std::vector<std::shared_ptr<SST>>
+LSMEngine::common_compact(const CompactionTask &task) {
+  CompactIterator iter({task.src_ssts, task.dst_ssts});
+
+  // 各层输出的 sst 大小都与 l1 相同, 保证部分 compact 能按文件粒度挑选,
+  // level 的容量仍然按照 get_sst_size(level) * ratio 逐层放大
+  return gen_sst_from_iter(iter, get_sst_size(1), task);
+}
+
+std::vector<std::shared_ptr<SST>>
+LSMEngine::gen_sst_from_iter(CompactIterator &iter, size_t target_sst_size,
+                             const CompactionTask &task) {
+  std::vector<std::shared_ptr<SST>> new_ssts;
+  auto new_sst_builder =
+      SSTBuilder(TomlConfig::getInstance().getLsmBlockSize(), true);
+  new_sst_builder.set_direct_io(direct_io_pool);
+  auto finish_sst = [&]() {
+    size_t sst_id = next_sst_id++;
+    std::string sst_path = get_sst_path(sst_id, task.dst_level);
     auto new_sst = new_sst_builder.build(sst_id, sst_path, this->block_cache);
+    new_sst->attach_table_cache(table_cache);
     new_ssts.push_back(new_sst);
 
     spdlog::debug("LSMEngine--"
                   "Compaction: Generated new SST file with sst_id={} "
                   "at level{}",
-                  sst_id, target_level);
+                  sst_id, task.dst_level);
+
+    new_sst_builder = SSTBuilder(TomlConfig::getInstance().getLsmBlockSize(),
+                                 true); // 重置builder
+    new_sst_builder.set_direct_io(direct_io_pool);
+  };
+
+  size_t dropped_versions = 0;
+  size_t dropped_tombstones = 0;
+  std::string prev_key;
+  uint64_t prev_tranc_id = 0;
+  // 当前 key 是否已经输出了 oldest_snapshot 能读到的版本
+  bool snapshot_covered = false;
+  for (bool first = true; iter.is_valid(); ++iter, first = false) {
+    auto &entry = *iter;
+    if (first || entry.key != prev_key) {
+      // 只在 key 变化时切分 sst, 查询时一个 key 的版本都在同一个 sst 中
+      if (new_sst_builder.estimated_size() >= target_sst_size) {
+        finish_sst();
+      }
+      prev_key = entry.key;
+      snapshot_covered = false;
+    } else if (entry.tranc_id == prev_tranc_id) {
+      // 同一个版本被写入多次时 (例如以 tranc_id 0 重复写入), 以最新的为准
+      dropped_versions++;
+      continue;
+    }
+    prev_tranc_id = entry.tranc_id;
+
+    if (entry.tranc_id > task.oldest_snapshot) {
+      // 可能有快照位于该版本与更新的版本之间, 需要保留
+      new_sst_builder.add(entry.key, entry.value, entry.tranc_id);
+    } else if (snapshot_covered) {
+      // 被 oldest_snapshot 能读到的版本遮挡, 任何快照都读不到
+      dropped_versions++;
+    } else {
+      snapshot_covered = true;
+      if (task.bottommost && entry.value.empty()) {
+        // 下层没有更旧的版本需要遮挡
+        dropped_tombstones++;
+      } else {
+        new_sst_builder.add(entry.key, entry.value, entry.tranc_id);
+      }
+    }
+  }
+  if (new_sst_builder.estimated_size() > 0) {
+    finish_sst();
   }
 
+  spdlog::debug("LSMEngine--"
+                "Compaction: Dropped {} obsolete versions and {} tombstones "
+                "at level{}",
+                dropped_versions, dropped_tombstones, task.dst_level);
   return new_ssts;
 }
 
@@ -736,6 +1741,12 @@ LSM::LSM(std::string path)
     : engine(std::make_shared<LSMEngine>(path)),
       tran_manager_(std::make_shared<TranManager>(path)) {
   tran_manager_->set_engine(engine);
+  // engine 间接持有 tran_manager_ 会形成循环引用
+  std::weak_ptr<TranManager> weak_manager = tran_manager_;
+  engine->set_oldest_snapshot_provider([weak_manager]() {
+    auto manager = weak_manager.lock();
+    return manager ? manager->get_oldest_snapshot() : UINT64_MAX;
+  });
   auto check_recover_res = tran_manager_->check_recover();
   for (auto &[tranc_id, records] : check_recover_res) {
     tran_manager_->update_max_finished_tranc_id(tranc_id);
@@ -759,8 +1770,10 @@ LSM::~LSM() {
 }
 
 std::optional<std::string> LSM::get(const std::string &key) {
-  auto tranc_id = tran_manager_->getNextTransactionId();
-  auto res = engine->get(key, tranc_id);
+  // 读取期间持有快照, 避免能读到的版本被并发的 compact 回收
+  // 查询抛出异常时快照同样在离开作用域时释放
+  auto snapshot = tran_manager_->acquire_snapshot();
+  auto res = engine->get(key, snapshot.tranc_id());
 
   if (res.has_value()) {
     return res.value().first;
@@ -770,11 +1783,11 @@ std::optional<std::string> LSM::get(const std::string &key) {
 
 std::vector<std::pair<std::string, std::optional<std::string>>>
 LSM::get_batch(const std::vector<std::string> &keys) {
-  // 1. 获取事务ID
-  auto tranc_id = tran_manager_->getNextTransactionId();
+  // 1. 获取事务ID, 读取期间持有快照, 离开作用域时释放
+  auto snapshot = tran_manager_->acquire_snapshot();
 
   // 2. 调用 engine 的批量查询接口
-  auto batch_results = engine->get_batch(keys, tranc_id);
+  auto batch_results = engine->get_batch(keys, snapshot.tranc_id());
 
   // 3. 构造最终结果
   std::vector<std::pair<std::string, std::optional<std::string>>> results;
@@ -811,7 +1824,7 @@ void LSM::remove_batch(const std::vector<std::string> &keys) {
 
 void LSM::clear() { engine->clear(); }
 
-void LSM::flush() { auto max_tranc_id = engine->flush(); }
+void LSM::flush() { engine->flush(); }
 
 void LSM::flush_all() {
   while (engine->memtable.get_total_size() > 0) {
@@ -820,8 +1833,10 @@ void LSM::flush_all() {
   }
 }
 
-LSM::LSMIterator LSM::begin(uint64_t tranc_id) {
-  return engine->begin(tranc_id);
+void LSM::wait_for_compaction() { engine->wait_for_compaction(); }
+
+LSM::LSMIterator LSM::begin(uint64_t tranc_id, bool fill_cache) {
+  return engine->begin(tranc_id, fill_cache);
 }
 
 LSM::LSMIterator LSM::end() { return engine->end(); }
@@ -844,5 +1859,17 @@ LSM::begin_tran(const IsolationLevel &isolation_level) {
   return tranc_context;
 }
 
+WriteControllerStats LSM::get_write_stall_stats() const {
+  return engine->get_write_stall_stats();
+}
+
+void LSM::enable_row_cache(size_t capacity) {
+  engine->enable_row_cache(capacity);
+}
+
+double LSM::get_row_cache_hit_rate() const {
+  return engine->row_cache == nullptr ? 0 : engine->row_cache->hit_rate();
+}
+
 void LSM::set_log_level(const std::string &level) { reset_log_level(level); }
 } // namespace toni_lsm
\ No newline at end of file
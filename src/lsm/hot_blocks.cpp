@@ -0,0 +1,80 @@
+#include "../../include/lsm/hot_blocks.h"
+#include "../../include/utils/files.h"
+#include "spdlog/spdlog.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+
+namespace toni_lsm {
+
+namespace {
+uint32_t hash_bytes(const uint8_t *data, size_t size) {
+  return std::hash<std::string_view>{}(
+      std::string_view(reinterpret_cast<const char *>(data), size));
+}
+} // namespace
+
+void HotBlockList::save(const std::string &path,
+                        const std::vector<std::pair<int, int>> &keys) {
+  std::vector<uint8_t> buf(sizeof(uint32_t) * (2 + 2 * keys.size()));
+  uint32_t count = keys.size();
+  memcpy(buf.data(), &count, sizeof(uint32_t));
+  uint8_t *pos = buf.data() + sizeof(uint32_t);
+  for (auto &[sst_id, block_id] : keys) {
+    memcpy(pos, &sst_id, sizeof(int));
+    memcpy(pos + sizeof(int), &block_id, sizeof(int));
+    pos += 2 * sizeof(int);
+  }
+  uint32_t hash = hash_bytes(buf.data(), pos - buf.data());
+  memcpy(pos, &hash, sizeof(uint32_t));
+
+  auto tmp_path = path + ".tmp";
+  FileObj::create_and_write(tmp_path, std::move(buf));
+  std::filesystem::rename(tmp_path, path);
+}
+
+std::vector<std::pair<int, int>> HotBlockList::load(const std::string &path) {
+  std::vector<std::pair<int, int>> keys;
+  if (!std::filesystem::exists(path)) {
+    return keys;
+  }
+  std::vector<uint8_t> buf;
+  try {
+    auto file = FileObj::open(path, false);
+    buf = file.read_to_slice(0, file.size());
+  } catch (const std::exception &e) {
+    spdlog::warn("HotBlockList--"
+                 "Failed to read {}: {}",
+                 path, e.what());
+    return keys;
+  }
+
+  uint32_t count = 0;
+  if (buf.size() >= sizeof(uint32_t)) {
+    memcpy(&count, buf.data(), sizeof(uint32_t));
+  }
+  size_t expected = sizeof(uint32_t) * (2 + 2 * static_cast<size_t>(count));
+  uint32_t hash = 0;
+  if (buf.size() == expected) {
+    memcpy(&hash, buf.data() + expected - sizeof(uint32_t), sizeof(uint32_t));
+  }
+  if (buf.size() != expected ||
+      hash != hash_bytes(buf.data(), expected - sizeof(uint32_t))) {
+    spdlog::warn("HotBlockList--"
+                 "Ignore corrupted hot block list {}",
+                 path);
+    return keys;
+  }
+
+  keys.resize(count);
+  const uint8_t *pos = buf.data() + sizeof(uint32_t);
+  for (auto &[sst_id, block_id] : keys) {
+    memcpy(&sst_id, pos, sizeof(int));
+    memcpy(&block_id, pos + sizeof(int), sizeof(int));
+    pos += 2 * sizeof(int);
+  }
+  return keys;
+}
+} // namespace toni_lsm
@@ -3,16 +3,13 @@
 #include "../../include/sst/concact_iterator.h"
 #include "../../include/sst/sst.h"
 #include <memory>
-#include <shared_mutex>
 #include <string>
 
 // TODO: 需要进行单元测试
 namespace toni_lsm {
 Level_Iterator::Level_Iterator(std::shared_ptr<LSMEngine> engine,
-                               uint64_t max_tranc_id)
-    : engine_(engine), max_tranc_id_(max_tranc_id), rlock_(engine_->ssts_mtx) {
-  // 成员变量获取sst读锁
-
+                               uint64_t max_tranc_id, bool fill_cache)
+    : engine_(engine), max_tranc_id_(max_tranc_id) {
   // 1. 获取内存部分迭代器
   // TODO: 这里最好修改 memtable.begin 使其返回一个指针, 避免多余的内存拷贝
   auto mem_iter = engine_->memtable.begin(max_tranc_id_);
@@ -20,11 +17,14 @@ Level_Iterator::Level_Iterator(std::shared_ptr<LSMEngine> engine,
   *mem_iter_ptr = mem_iter;
   iter_vec.push_back(mem_iter_ptr);
 
+  // 读取 memtable 之后再获取 sst 布局, 刷盘中的数据至少在其中一处可见
+  version_ = engine_->current_version();
+
   // 2. 获取 L0 层的迭代器
   std::vector<SearchItem> item_vec;
-  for (auto &sst_id : engine_->level_sst_ids[0]) {
-    auto sst = engine_->ssts[sst_id];
-    for (auto iter = sst->begin(max_tranc_id_);
+  for (auto &sst : version_->level(0)) {
+    int sst_id = sst->get_sst_id();
+    for (auto iter = sst->begin(max_tranc_id_, fill_cache);
          iter.is_valid() && iter != sst->end(); ++iter) {
       // 这里越新的sst的idx越大, 我们需要让新的sst优先在堆顶
       // 让新的sst(拥有更大的idx)排序在前面, 反转符号就行了
@@ -40,19 +40,13 @@ Level_Iterator::Level_Iterator(std::shared_ptr<LSMEngine> engine,
       std::make_shared<HeapIterator>(item_vec, max_tranc_id);
   iter_vec.push_back(l0_iter_ptr);
 
-  // 3. 获取其他层的迭代器
-  for (auto &[level, sst_id_list] : engine_->level_sst_ids) {
+  // 3. 获取其他层的迭代器, 每个 level 的 sst 互不重叠, 顺序拼接即可
+  for (auto &[level, level_ssts] : version_->levels) {
     if (level == 0) {
       continue;
     }
-    std::vector<std::shared_ptr<SST>> ssts;
-    for (auto sst_id : sst_id_list) {
-      auto sst = engine_->ssts[sst_id];
-      ssts.push_back(sst);
-      std::shared_ptr<ConcactIterator> level_i_iter =
-          std::make_shared<ConcactIterator>(ssts, max_tranc_id);
-      iter_vec.push_back(level_i_iter);
-    }
+    iter_vec.push_back(std::make_shared<ConcactIterator>(
+        level_ssts, max_tranc_id, fill_cache));
   }
 
   while (!is_end()) {
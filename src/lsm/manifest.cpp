@@ -0,0 +1,247 @@
+#include "../../include/lsm/manifest.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+namespace toni_lsm {
+
+namespace {
+
+void put_u32(std::vector<uint8_t> &buf, uint32_t value) {
+  size_t pos = buf.size();
+  buf.resize(pos + sizeof(uint32_t));
+  memcpy(buf.data() + pos, &value, sizeof(uint32_t));
+}
+
+void put_u64(std::vector<uint8_t> &buf, uint64_t value) {
+  size_t pos = buf.size();
+  buf.resize(pos + sizeof(uint64_t));
+  memcpy(buf.data() + pos, &value, sizeof(uint64_t));
+}
+
+void put_string(std::vector<uint8_t> &buf, const std::string &value) {
+  put_u32(buf, value.size());
+  buf.insert(buf.end(), value.begin(), value.end());
+}
+
+// 顺序读取 VersionEdit 的各个字段, 越界时抛出异常
+class EditReader {
+public:
+  EditReader(const uint8_t *data, size_t len) : data_(data), len_(len) {}
+
+  uint32_t get_u32() {
+    uint32_t value;
+    memcpy(&value, take(sizeof(uint32_t)), sizeof(uint32_t));
+    return value;
+  }
+
+  uint64_t get_u64() {
+    uint64_t value;
+    memcpy(&value, take(sizeof(uint64_t)), sizeof(uint64_t));
+    return value;
+  }
+
+  std::string get_string() {
+    uint32_t size = get_u32();
+    auto ptr = reinterpret_cast<const char *>(take(size));
+    return std::string(ptr, size);
+  }
+
+  bool done() const { return pos_ == len_; }
+
+private:
+  const uint8_t *take(size_t size) {
+    if (size > len_ - pos_) {
+      throw std::runtime_error("Corrupted version edit: unexpected end");
+    }
+    auto ptr = data_ + pos_;
+    pos_ += size;
+    return ptr;
+  }
+
+  const uint8_t *data_;
+  size_t len_;
+  size_t pos_ = 0;
+};
+
+uint32_t record_hash(const uint8_t *data, size_t len) {
+  return static_cast<uint32_t>(std::hash<std::string_view>{}(
+      std::string_view(reinterpret_cast<const char *>(data), len)));
+}
+} // namespace
+
+// *********************** VersionEdit ***********************
+std::vector<uint8_t> VersionEdit::encode() const {
+  std::vector<uint8_t> buf;
+  put_u64(buf, next_sst_id);
+
+  put_u32(buf, added.size());
+  for (auto &[level, meta] : added) {
+    put_u64(buf, level);
+    put_u64(buf, meta.sst_id);
+    put_u64(buf, meta.file_size);
+    put_u64(buf, meta.min_tranc_id);
+    put_u64(buf, meta.max_tranc_id);
+    put_string(buf, meta.first_key);
+    put_string(buf, meta.last_key);
+  }
+
+  put_u32(buf, deleted.size());
+  for (auto &[level, sst_id] : deleted) {
+    put_u64(buf, level);
+    put_u64(buf, sst_id);
+  }
+  return buf;
+}
+
+VersionEdit VersionEdit::decode(const uint8_t *data, size_t len) {
+  EditReader reader(data, len);
+  VersionEdit edit;
+  edit.next_sst_id = reader.get_u64();
+
+  uint32_t num_added = reader.get_u32();
+  for (uint32_t i = 0; i < num_added; i++) {
+    size_t level = reader.get_u64();
+    SSTFileMeta meta;
+    meta.sst_id = reader.get_u64();
+    meta.file_size = reader.get_u64();
+    meta.min_tranc_id = reader.get_u64();
+    meta.max_tranc_id = reader.get_u64();
+    meta.first_key = reader.get_string();
+    meta.last_key = reader.get_string();
+    edit.added.emplace_back(level, std::move(meta));
+  }
+
+  uint32_t num_deleted = reader.get_u32();
+  for (uint32_t i = 0; i < num_deleted; i++) {
+    size_t level = reader.get_u64();
+    size_t sst_id = reader.get_u64();
+    edit.deleted.emplace_back(level, sst_id);
+  }
+
+  if (!reader.done()) {
+    throw std::runtime_error("Corrupted version edit: trailing bytes");
+  }
+  return edit;
+}
+
+// *********************** ManifestState ***********************
+void ManifestState::apply(const VersionEdit &edit) {
+  // 先删除再添加, trivial move 在同一条 edit 中删除旧 level 并添加新 level
+  for (auto &[level, sst_id] : edit.deleted) {
+    auto it = levels.find(level);
+    if (it == levels.end()) {
+      continue;
+    }
+    it->second.erase(sst_id);
+    if (it->second.empty()) {
+      levels.erase(it);
+    }
+  }
+  for (auto &[level, meta] : edit.added) {
+    levels[level][meta.sst_id] = meta;
+  }
+  next_sst_id = std::max(next_sst_id, edit.next_sst_id);
+}
+
+// *********************** Manifest ***********************
+Manifest::Manifest(const std::string &data_dir) : data_dir_(data_dir) {}
+
+std::string Manifest::get_path(const std::string &data_dir) {
+  return data_dir + "/MANIFEST";
+}
+
+bool Manifest::exists(const std::string &data_dir) {
+  return std::filesystem::exists(get_path(data_dir));
+}
+
+std::vector<uint8_t> Manifest::encode_record(const VersionEdit &edit) {
+  auto payload = edit.encode();
+  std::vector<uint8_t> record;
+  record.reserve(payload.size() + sizeof(uint32_t) * 2);
+  put_u32(record, payload.size());
+  record.insert(record.end(), payload.begin(), payload.end());
+  put_u32(record, record_hash(payload.data(), payload.size()));
+  return record;
+}
+
+ManifestState Manifest::recover(const std::string &data_dir) {
+  ManifestState state;
+  auto file = FileObj::open(get_path(data_dir), false);
+  size_t file_size = file.size();
+  auto buf = file.read_to_slice(0, file_size);
+
+  size_t pos = 0;
+  size_t num_records = 0;
+  while (pos + sizeof(uint32_t) <= file_size) {
+    uint32_t len;
+    memcpy(&len, buf.data() + pos, sizeof(uint32_t));
+    if (len + sizeof(uint32_t) > file_size - pos - sizeof(uint32_t)) {
+      break; // 写了一半的记录
+    }
+    const uint8_t *payload = buf.data() + pos + sizeof(uint32_t);
+    uint32_t hash;
+    memcpy(&hash, payload + len, sizeof(uint32_t));
+    if (hash != record_hash(payload, len)) {
+      break;
+    }
+    try {
+      state.apply(VersionEdit::decode(payload, len));
+    } catch (const std::runtime_error &e) {
+      spdlog::warn("Manifest--recover: {}", e.what());
+      break;
+    }
+    pos += sizeof(uint32_t) * 2 + len;
+    num_records++;
+  }
+
+  if (pos != file_size) {
+    // 崩溃时最后一条记录没有写完, 对应的变化没有生效
+    spdlog::warn("Manifest--"
+                 "recover: ignored {} bytes of incomplete records",
+                 file_size - pos);
+  }
+  spdlog::info("Manifest--"
+               "recover: replayed {} records, {} levels",
+               num_records, state.levels.size());
+  return state;
+}
+
+void Manifest::write_snapshot(const VersionEdit &snapshot) {
+  auto record = encode_record(snapshot);
+  auto path = get_path(data_dir_);
+  auto tmp_path = path + ".tmp";
+  // 先完整写入临时文件, 崩溃时旧的 MANIFEST 仍然可用
+  auto tmp = FileObj::open(tmp_path, true);
+  if (!tmp.append(record) || !tmp.sync()) {
+    throw std::runtime_error("Failed to write " + tmp_path);
+  }
+  std::filesystem::rename(tmp_path, path);
+  // 重命名落盘之前不能追加记录, 否则崩溃后读到的旧 MANIFEST
+  // 可能引用已经被 compact 删除的 sst
+  if (!FileObj::sync_dir(data_dir_)) {
+    throw std::runtime_error("Failed to sync directory " + data_dir_);
+  }
+
+  file_ = FileObj::open(path, false);
+  size_ = record.size();
+}
+
+void Manifest::log_edit(const VersionEdit &edit) {
+  // 新 sst 的目录项先落盘, 再写入引用它的记录
+  if (!edit.added.empty() && !FileObj::sync_dir(data_dir_)) {
+    throw std::runtime_error("Failed to sync directory " + data_dir_);
+  }
+  auto record = encode_record(edit);
+  if (!file_.append(record) || !file_.sync()) {
+    throw std::runtime_error("Failed to append to MANIFEST");
+  }
+  size_ += record.size();
+}
+
+size_t Manifest::size() const { return size_; }
+} // namespace toni_lsm
@@ -0,0 +1,115 @@
+#include "../../include/lsm/row_cache.h"
+#include "../../include/block/block_cache.h"
+#include <functional>
+
+namespace toni_lsm {
+
+RowCache::RowCache(size_t capacity, size_t shard_bits) : capacity_(capacity) {
+  // 与 BlockCache 相同, 保证每个分片有足够的容量
+  while (shard_bits > 0 &&
+         (capacity >> shard_bits) < BlockCache::kMinShardCapacity) {
+    --shard_bits;
+  }
+  size_t num_shards = static_cast<size_t>(1) << shard_bits;
+  shard_mask_ = num_shards - 1;
+  shards_ = std::vector<Shard>(num_shards);
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_[i].capacity = capacity / num_shards + (i < capacity % num_shards);
+  }
+}
+
+RowCache::Shard &RowCache::shard_for(const std::string &key) {
+  return shards_[(mix64(std::hash<std::string>{}(key)) >> 32) & shard_mask_];
+}
+
+std::optional<std::pair<std::string, uint64_t>>
+RowCache::get(const std::string &key, uint64_t tranc_id,
+              uint64_t &fill_token) {
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  ++shard.total_requests;
+  fill_token = shard.epoch;
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    return std::nullopt;
+  }
+  auto &entry = *it->second;
+  if (tranc_id != 0 && entry.tranc_id > tranc_id) {
+    // 最新版本对该快照不可见, 需要查询更旧的版本
+    return std::nullopt;
+  }
+  ++shard.hit_requests;
+  shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+  return std::make_pair(entry.value, entry.tranc_id);
+}
+
+void RowCache::put(const std::string &key, const std::string &value,
+                   uint64_t tranc_id, uint64_t fill_token) {
+  // key 在缓存项和索引中各保存一份
+  size_t charge = sizeof(Entry) + 2 * key.size() + value.size() +
+                  4 * sizeof(void *);
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  if (shard.epoch != fill_token || charge > shard.capacity) {
+    return;
+  }
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    erase_locked(shard, it->second);
+  }
+  while (shard.usage + charge > shard.capacity) {
+    erase_locked(shard, std::prev(shard.lru.end()));
+  }
+  shard.lru.push_front(Entry{key, value, tranc_id, charge});
+  shard.index[key] = shard.lru.begin();
+  shard.usage += charge;
+}
+
+void RowCache::invalidate(const std::string &key) {
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mutex_);
+  ++shard.epoch;
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    erase_locked(shard, it->second);
+  }
+}
+
+void RowCache::clear() {
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    ++shard.epoch;
+    shard.index.clear();
+    shard.lru.clear();
+    shard.usage = 0;
+  }
+}
+
+void RowCache::erase_locked(Shard &shard, std::list<Entry>::iterator it) {
+  shard.usage -= it->charge;
+  shard.index.erase(it->key);
+  shard.lru.erase(it);
+}
+
+size_t RowCache::usage() const {
+  size_t usage = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    usage += shard.usage;
+  }
+  return usage;
+}
+
+double RowCache::hit_rate() const {
+  size_t total_requests = 0;
+  size_t hit_requests = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    total_requests += shard.total_requests;
+    hit_requests += shard.hit_requests;
+  }
+  return total_requests == 0
+             ? 0.0
+             : static_cast<double>(hit_requests) / total_requests;
+}
+} // namespace toni_lsm
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace toni_lsm {
@@ -29,6 +30,34 @@ inline std::string isolation_level_to_string(const IsolationLevel &level) {
   }
 }
 
+// *********************** SnapshotGuard ***********************
+SnapshotGuard::SnapshotGuard(TranManager *manager, size_t slot,
+                             uint64_t tranc_id)
+    : manager_(manager), slot_(slot), tranc_id_(tranc_id) {}
+
+SnapshotGuard::SnapshotGuard(SnapshotGuard &&other) noexcept
+    : manager_(std::exchange(other.manager_, nullptr)), slot_(other.slot_),
+      tranc_id_(other.tranc_id_) {}
+
+SnapshotGuard &SnapshotGuard::operator=(SnapshotGuard &&other) noexcept {
+  if (this != &other) {
+    release();
+    manager_ = std::exchange(other.manager_, nullptr);
+    slot_ = other.slot_;
+    tranc_id_ = other.tranc_id_;
+  }
+  return *this;
+}
+
+SnapshotGuard::~SnapshotGuard() { release(); }
+
+void SnapshotGuard::release() {
+  if (manager_ != nullptr) {
+    manager_->release_snapshot(slot_, tranc_id_);
+    manager_ = nullptr;
+  }
+}
+
 // *********************** TranContext ***********************
 TranContext::TranContext(uint64_t tranc_id, std::shared_ptr<LSMEngine> engine,
                          std::shared_ptr<TranManager> tranManager,
@@ -38,6 +67,13 @@ TranContext::TranContext(uint64_t tranc_id, std::shared_ptr<LSMEngine> engine,
   operations.emplace_back(Record::createRecord(tranc_id_));
 }
 
+TranContext::~TranContext() {
+  // 没有提交或回滚就被丢弃的事务也不能一直阻止 compact 回收旧版本
+  if (!isCommited && !isAborted) {
+    tranManager_->finish_tranc(tranc_id_);
+  }
+}
+
 void TranContext::put(const std::string &key, const std::string &value) {
   spdlog::trace("LSM--"
                 "lsm_iters_monotony_predicate: Starting query for tranc_id={}",
@@ -165,6 +201,7 @@ bool TranContext::commit(bool test_fail) {
       throw std::runtime_error("write to wal failed");
     }
     isCommited = true;
+    tranManager_->finish_tranc(tranc_id_);
     tranManager_->update_max_finished_tranc_id(tranc_id_);
 
     spdlog::info(
@@ -181,16 +218,17 @@ bool TranContext::commit(bool test_fail) {
   // TODO: 目前为检查冲突, 全局获取了读锁, 后续考虑性能优化方案
 
   MemTable &memtable = engine_->memtable;
-  std::unique_lock<std::shared_mutex> wlock1(memtable.frozen_mtx);
-  std::unique_lock<std::shared_mutex> wlock2(memtable.cur_mtx);
+  // 加锁顺序与 MemTable::put 保持一致: 先活跃表再冻结表
+  std::unique_lock<std::shared_mutex> wlock1(memtable.cur_mtx);
+  std::unique_lock<std::shared_mutex> wlock2(memtable.frozen_mtx);
 
   if (isolation_level == IsolationLevel::REPEATABLE_READ ||
       isolation_level == IsolationLevel::SERIALIZABLE) {
     // REPEATABLE_READ 需要校验冲突
     // TODO: 目前 SERIALIZABLE 还没有实现, 逻辑和 REPEATABLE_READ 相同
 
-    // 只要需要校验的 隔离级别 需要加sst的锁
-    std::shared_lock<std::shared_mutex> rlock3(engine_->ssts_mtx);
+    // sst 通过 Version 读取, 不需要加锁; 持有 memtable 的写锁期间
+    // 冻结表不会被移除, 刷盘中的数据至少在其中一处可见
 
     for (auto &[k, v] : temp_map_) {
       // 步骤1: 先在内存表中判断该 key 是否冲突
@@ -202,6 +240,7 @@ bool TranContext::commit(bool test_fail) {
         // 表示更晚创建的事务修改了相同的key, 并先提交, 发生了冲突
         // 需要终止事务
         isAborted = true;
+        tranManager_->finish_tranc(tranc_id_);
 
         spdlog::warn("TranContext--commit(): Conflict detected on key={}, "
                      "aborting transaction ID={}",
@@ -225,6 +264,7 @@ bool TranContext::commit(bool test_fail) {
             // 表示更晚创建的事务修改了相同的key, 并先提交, 发生了冲突
             // 需要终止事务
             isAborted = true;
+            tranManager_->finish_tranc(tranc_id_);
 
             spdlog::warn("TranContext--commit(): SST conflict on key={}, "
                          "aborting transaction ID={}",
@@ -262,6 +302,7 @@ bool TranContext::commit(bool test_fail) {
   }
 
   isCommited = true;
+  tranManager_->finish_tranc(tranc_id_);
   tranManager_->update_max_finished_tranc_id(tranc_id_);
 
   spdlog::info(
@@ -287,6 +328,7 @@ bool TranContext::abort() {
       }
     }
     isAborted = true;
+    tranManager_->finish_tranc(tranc_id_);
 
     spdlog::info("TranContext--abort(): Transaction ID={} aborted", tranc_id_);
 
@@ -305,6 +347,7 @@ bool TranContext::abort() {
   // }
 
   isAborted = true;
+  tranManager_->finish_tranc(tranc_id_);
 
   return true;
 }
@@ -424,16 +467,76 @@ TranManager::new_tranc(const IsolationLevel &isolation_level) {
   // 获取锁
   std::unique_lock<std::mutex> lock(mutex_);
 
+  // 在锁内分配 tranc_id, get_oldest_snapshot 不会漏掉刚创建的事务
   auto tranc_id = getNextTransactionId();
-  activeTrans_[tranc_id] = std::make_shared<TranContext>(
+  auto tranc = std::make_shared<TranContext>(
       tranc_id, engine_, shared_from_this(), isolation_level);
+  activeTrans_[tranc_id] = tranc;
 
   spdlog::debug("TranManager--new_tranc(): Created transaction ID={} with "
                 "isolation level={}",
                 tranc_id, static_cast<int>(isolation_level));
 
-  return activeTrans_[tranc_id];
+  return tranc;
+}
+
+void TranManager::finish_tranc(uint64_t tranc_id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  activeTrans_.erase(tranc_id);
 }
+
+SnapshotGuard TranManager::acquire_snapshot() {
+  // 先以当前的 nextTransactionId_ 作为下界占住槽位, 再分配 tranc_id
+  // get_oldest_snapshot 先读取 nextTransactionId_ 再扫描槽位,
+  // 没有扫描到这个槽位时, 之后分配到的 tranc_id 也不会小于它读到的值
+  size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  for (size_t i = 0; i < kReadSlots; i++) {
+    size_t slot = (start + i) % kReadSlots;
+    uint64_t expected = kFreeSlot;
+    if (read_slots_[slot].tranc_id.compare_exchange_strong(
+            expected, nextTransactionId_.load())) {
+      uint64_t tranc_id = nextTransactionId_.fetch_add(1);
+      read_slots_[slot].tranc_id.store(tranc_id);
+      return SnapshotGuard(this, slot, tranc_id);
+    }
+  }
+
+  // 同时进行的读取超过槽位数量时退回加锁的集合
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto tranc_id = getNextTransactionId();
+  read_snapshots_.insert(tranc_id);
+  return SnapshotGuard(this, kReadSlots, tranc_id);
+}
+
+void TranManager::release_snapshot(size_t slot, uint64_t tranc_id) {
+  if (slot < kReadSlots) {
+    read_slots_[slot].tranc_id.store(kFreeSlot);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = read_snapshots_.find(tranc_id);
+  if (it != read_snapshots_.end()) {
+    read_snapshots_.erase(it);
+  }
+}
+
+uint64_t TranManager::get_oldest_snapshot() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // 之后分配的 tranc_id 都不会小于 nextTransactionId_
+  // 需要在扫描读取槽位之前读取, 见 acquire_snapshot
+  uint64_t oldest = nextTransactionId_.load();
+  if (!activeTrans_.empty()) {
+    oldest = std::min(oldest, activeTrans_.begin()->first);
+  }
+  for (const auto &slot : read_slots_) {
+    oldest = std::min(oldest, slot.tranc_id.load());
+  }
+  if (!read_snapshots_.empty()) {
+    oldest = std::min(oldest, *read_snapshots_.begin());
+  }
+  return oldest;
+}
+
 std::string TranManager::get_tranc_id_file_path() {
   if (data_dir_.empty()) {
     data_dir_ = "./";
@@ -0,0 +1,10 @@
+#include "../../include/lsm/version.h"
+
+namespace toni_lsm {
+
+const std::vector<std::shared_ptr<SST>> &Version::level(size_t level) const {
+  static const std::vector<std::shared_ptr<SST>> empty_level;
+  auto it = levels.find(level);
+  return it == levels.end() ? empty_level : it->second;
+}
+} // namespace toni_lsm
@@ -0,0 +1,144 @@
+#include "../../include/lsm/write_controller.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+
+namespace toni_lsm {
+
+std::string to_string(WriteStallState state) {
+  switch (state) {
+  case WriteStallState::Normal:
+    return "normal";
+  case WriteStallState::Delayed:
+    return "delayed";
+  case WriteStallState::Stopped:
+    return "stopped";
+  }
+  return "unknown";
+}
+
+WriteController::WriteController(size_t l0_slowdown_trigger,
+                                 size_t l0_stop_trigger,
+                                 size_t immutable_slowdown_trigger,
+                                 size_t immutable_stop_trigger,
+                                 size_t soft_pending_compaction_bytes,
+                                 size_t hard_pending_compaction_bytes,
+                                 uint64_t delayed_write_rate)
+    : l0_slowdown_trigger_(l0_slowdown_trigger),
+      l0_stop_trigger_(l0_stop_trigger),
+      immutable_slowdown_trigger_(immutable_slowdown_trigger),
+      immutable_stop_trigger_(immutable_stop_trigger),
+      soft_pending_compaction_bytes_(soft_pending_compaction_bytes),
+      hard_pending_compaction_bytes_(hard_pending_compaction_bytes),
+      max_delayed_write_rate_(std::max<uint64_t>(delayed_write_rate, 1)),
+      delayed_write_rate_(max_delayed_write_rate_),
+      last_refill_(std::chrono::steady_clock::now()) {}
+
+void WriteController::update_lsm_condition(size_t l0_files,
+                                           size_t pending_compaction_bytes) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  l0_files_ = l0_files;
+  pending_compaction_bytes_ = pending_compaction_bytes;
+  recalc_state_locked();
+}
+
+void WriteController::update_immutable_memtables(size_t immutable_memtables) {
+  if (immutable_memtables_.load() == immutable_memtables) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  immutable_memtables_ = immutable_memtables;
+  recalc_state_locked();
+}
+
+void WriteController::recalc_state_locked() {
+  // 指标在 [slowdown, stop) 区间内的位置, 0 表示刚开始限速
+  double severity = -1;
+  bool stop = false;
+  auto check = [&](size_t value, size_t slowdown, size_t stop_trigger) {
+    if (stop_trigger > 0 && value >= stop_trigger) {
+      stop = true;
+    } else if (slowdown > 0 && value >= slowdown) {
+      double range = stop_trigger > slowdown ? stop_trigger - slowdown : 1;
+      severity = std::max(severity, (value - slowdown) / range);
+    }
+  };
+  check(l0_files_, l0_slowdown_trigger_, l0_stop_trigger_);
+  check(immutable_memtables_, immutable_slowdown_trigger_,
+        immutable_stop_trigger_);
+  check(pending_compaction_bytes_, soft_pending_compaction_bytes_,
+        hard_pending_compaction_bytes_);
+
+  WriteStallState new_state = WriteStallState::Normal;
+  if (stop) {
+    new_state = WriteStallState::Stopped;
+  } else if (severity >= 0) {
+    new_state = WriteStallState::Delayed;
+    // 越接近 stop 阈值限速越严格, 最低降到最大速率的 1/16
+    delayed_write_rate_ = std::max<uint64_t>(
+        max_delayed_write_rate_ * (1 - severity), max_delayed_write_rate_ / 16);
+  }
+
+  WriteStallState old_state = state_.exchange(new_state);
+  if (old_state == new_state) {
+    return;
+  }
+  if (new_state == WriteStallState::Delayed) {
+    // 重新开始限速, 不继承之前积累的令牌
+    available_bytes_ = 0;
+    last_refill_ = std::chrono::steady_clock::now();
+  }
+  spdlog::info("WriteController--"
+               "Write stall state changed from {} to {}: l0_files={}, "
+               "immutable_memtables={}, pending_compaction_bytes={}",
+               to_string(old_state), to_string(new_state), l0_files_,
+               immutable_memtables_.load(), pending_compaction_bytes_);
+}
+
+WriteStallState WriteController::get_state() const { return state_.load(); }
+
+uint64_t WriteController::get_delay_us(size_t bytes) {
+  if (state_.load() != WriteStallState::Delayed) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto now = std::chrono::steady_clock::now();
+  double elapsed_sec =
+      std::chrono::duration<double>(now - last_refill_).count();
+  last_refill_ = now;
+  // 最多积累 10ms 的令牌, 避免空闲一段时间后突发写入不受限制
+  double burst = delayed_write_rate_ / 100.0;
+  available_bytes_ =
+      std::min(available_bytes_ + elapsed_sec * delayed_write_rate_, burst);
+
+  // 透支的部分由之后的写入一起偿还, 并发写入会依次排队
+  available_bytes_ -= bytes;
+  if (available_bytes_ >= 0) {
+    return 0;
+  }
+  uint64_t delay_us = static_cast<uint64_t>(-available_bytes_ * 1000000 /
+                                            delayed_write_rate_);
+  num_delayed_writes_++;
+  total_delay_us_ += delay_us;
+  return delay_us;
+}
+
+void WriteController::record_stop() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  num_stopped_writes_++;
+}
+
+WriteControllerStats WriteController::get_stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  WriteControllerStats stats;
+  stats.state = state_.load();
+  stats.l0_files = l0_files_;
+  stats.immutable_memtables = immutable_memtables_.load();
+  stats.pending_compaction_bytes = pending_compaction_bytes_;
+  stats.delayed_write_rate = delayed_write_rate_;
+  stats.num_delayed_writes = num_delayed_writes_;
+  stats.total_delay_us = total_delay_us_;
+  stats.num_stopped_writes = num_stopped_writes_;
+  return stats;
+}
+} // namespace toni_lsm
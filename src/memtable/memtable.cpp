@@ -28,6 +28,10 @@ MemTable::~MemTable() = default;
 void MemTable::put_(const std::string &key, const std::string &value,
                     uint64_t tranc_id) {
   current_table->put(key, value, tranc_id);
+  update_max_write_tranc_id(tranc_id);
+  if (write_callback_) {
+    write_callback_(key);
+  }
 }
 
 void MemTable::put(const std::string &key, const std::string &value,
@@ -145,9 +149,8 @@ MemTable::get_batch(const std::vector<std::string> &keys, uint64_t tranc_id) {
     auto key = keys[idx];
     auto cur_res = cur_get_(key, tranc_id);
     if (cur_res.is_valid()) {
-      // 值存在且不为空
-      // ! 此时value可能为空, 需要返回时置为 nullopt
-      // ! 这里允许value为空主要是为了与"没有找到"区分开来
+      // ! 此时value可能为空, 表示被删除
+      // ! 这里保留空值是为了与"没有找到"区分开来, 调用方不能再去 sst 中查找
       results.emplace_back(
           key, std::make_pair(cur_res.get_value(), cur_res.get_tranc_id()));
     } else {
@@ -160,12 +163,6 @@ MemTable::get_batch(const std::vector<std::string> &keys, uint64_t tranc_id) {
   if (!std::any_of(results.begin(), results.end(), [](const auto &result) {
         return !result.second.has_value();
       })) {
-    // ! 最后, 需要把 value 为空的键值对标记为 nullopt
-    for (auto &[key, value] : results) {
-      if (!value.has_value()) {
-        value = std::nullopt;
-      }
-    }
     return results;
   }
 
@@ -178,7 +175,7 @@ MemTable::get_batch(const std::vector<std::string> &keys, uint64_t tranc_id) {
     auto key = keys[idx];
     auto frozen_result = frozen_get_(key, tranc_id);
     if (frozen_result.is_valid()) {
-      // 值存在且不为空
+      // 与活跃表相同, 被删除的键返回空值
       results[idx] =
           std::make_pair(key, std::make_pair(frozen_result.get_value(),
                                              frozen_result.get_tranc_id()));
@@ -187,13 +184,6 @@ MemTable::get_batch(const std::vector<std::string> &keys, uint64_t tranc_id) {
     }
   }
 
-  // 最后, 需要把 value 为空的键值对标记为 nullopt
-  for (auto &[key, value] : results) {
-    if (!value.has_value()) {
-      value = std::nullopt;
-    }
-  }
-
   return results;
 }
 
@@ -202,6 +192,10 @@ void MemTable::remove_(const std::string &key, uint64_t tranc_id) {
 
   // 删除的方式是写入空值
   current_table->put(key, "", tranc_id);
+  update_max_write_tranc_id(tranc_id);
+  if (write_callback_) {
+    write_callback_(key);
+  }
 }
 
 void MemTable::remove(const std::string &key, uint64_t tranc_id) {
@@ -234,6 +228,22 @@ void MemTable::remove_batch(const std::vector<std::string> &keys,
   }
 }
 
+void MemTable::set_write_callback(
+    std::function<void(const std::string &)> callback) {
+  write_callback_ = std::move(callback);
+}
+
+uint64_t MemTable::get_max_write_tranc_id() const {
+  return max_write_tranc_id_.load();
+}
+
+void MemTable::update_max_write_tranc_id(uint64_t tranc_id) {
+  uint64_t cur = max_write_tranc_id_.load();
+  while (cur < tranc_id &&
+         !max_write_tranc_id_.compare_exchange_weak(cur, tranc_id)) {
+  }
+}
+
 void MemTable::clear() {
   spdlog::info("MemTable--clear(): Clearing all tables");
 
@@ -244,37 +254,38 @@ void MemTable::clear() {
 }
 
 // 将最老的 memtable 写入 SST, 并返回控制类
+// ! 冻结表是只读的, 构建 sst 期间不需要持有写锁, 也不会阻塞读者
+// ! 调用方需要保证同一时刻只有一个刷盘任务
 std::shared_ptr<SST>
 MemTable::flush_last(SSTBuilder &builder, std::string &sst_path, size_t sst_id,
                      std::shared_ptr<BlockCache> block_cache) {
   spdlog::debug("MemTable--flush_last(): Starting to flush memtable to SST{}",
                 sst_id);
 
-  // 由于 flush 后需要移除最老的 memtable, 因此需要加写锁
-  std::unique_lock<std::shared_mutex> lock(frozen_mtx);
-
-  uint64_t max_tranc_id = 0;
-  uint64_t min_tranc_id = UINT64_MAX;
+  std::shared_ptr<SkipList> table;
+  {
+    // 可能需要冻结当前表, 加锁顺序与 put 保持一致: 先活跃表再冻结表
+    std::unique_lock<std::shared_mutex> lock1(cur_mtx);
+    std::unique_lock<std::shared_mutex> lock2(frozen_mtx);
 
-  if (frozen_tables.empty()) {
-    // 如果当前表为空，直接返回nullptr
-    if (current_table->get_size() == 0) {
-      spdlog::debug(
-          "MemTable--flush_last(): Current table is empty, returning null");
+    if (frozen_tables.empty()) {
+      // 如果当前表为空，直接返回nullptr
+      if (current_table->get_size() == 0) {
+        spdlog::debug(
+            "MemTable--flush_last(): Current table is empty, returning null");
 
-      return nullptr;
+        return nullptr;
+      }
+      // 将当前表加入到frozen_tables头部
+      frozen_cur_table_();
     }
-    // 将当前表加入到frozen_tables头部
-    frozen_tables.push_front(current_table);
-    frozen_bytes += current_table->get_size();
-    // 创建新的空表作为当前表
-    current_table = std::make_shared<SkipList>();
+
+    // 最老的 memtable 位于链表尾部
+    table = frozen_tables.back();
   }
 
-  // 将最老的 memtable 写入 SST
-  std::shared_ptr<SkipList> table = frozen_tables.back();
-  frozen_tables.pop_back();
-  frozen_bytes -= table->get_size();
+  uint64_t max_tranc_id = 0;
+  uint64_t min_tranc_id = UINT64_MAX;
 
   std::vector<std::tuple<std::string, std::string, uint64_t>> flush_data =
       table->flush();
@@ -291,6 +302,18 @@ MemTable::flush_last(SSTBuilder &builder, std::string &sst_path, size_t sst_id,
   return sst;
 }
 
+void MemTable::remove_last_frozen() {
+  std::unique_lock<std::shared_mutex> lock(frozen_mtx);
+  if (frozen_tables.empty()) {
+    return;
+  }
+  frozen_bytes -= frozen_tables.back()->get_size();
+  frozen_tables.pop_back();
+
+  spdlog::trace("MemTable--remove_last_frozen(): {} frozen tables left",
+                frozen_tables.size());
+}
+
 void MemTable::frozen_cur_table_() {
   spdlog::trace("MemTable--frozen_cur_table_(): Freezing current table");
 
@@ -318,6 +341,11 @@ size_t MemTable::get_frozen_size() {
   return frozen_bytes;
 }
 
+size_t MemTable::get_frozen_table_num() {
+  std::shared_lock<std::shared_mutex> slock(frozen_mtx);
+  return frozen_tables.size();
+}
+
 size_t MemTable::get_total_size() {
   std::shared_lock<std::shared_mutex> slock1(cur_mtx);
   std::shared_lock<std::shared_mutex> slock2(frozen_mtx);
@@ -3,11 +3,11 @@
 namespace toni_lsm {
 
 ConcactIterator::ConcactIterator(std::vector<std::shared_ptr<SST>> ssts,
-                                 uint64_t tranc_id)
+                                 uint64_t tranc_id, bool fill_cache)
     : ssts(ssts), cur_iter(nullptr, tranc_id), cur_idx(0),
-      max_tranc_id_(tranc_id) {
+      max_tranc_id_(tranc_id), fill_cache_(fill_cache) {
   if (!this->ssts.empty()) {
-    cur_iter = ssts[0]->begin(max_tranc_id_);
+    cur_iter = ssts[0]->begin(max_tranc_id_, fill_cache_);
   }
 }
 
@@ -17,7 +17,7 @@ BaseIterator &ConcactIterator::operator++() {
   if (cur_iter.is_end() || !cur_iter.is_valid()) {
     cur_idx++;
     if (cur_idx < ssts.size()) {
-      cur_iter = ssts[cur_idx]->begin(max_tranc_id_);
+      cur_iter = ssts[cur_idx]->begin(max_tranc_id_, fill_cache_);
     } else {
       cur_iter = SstIterator(nullptr, max_tranc_id_);
     }
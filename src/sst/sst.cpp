@@ -1,100 +1,311 @@
 #include "../../include/sst/sst.h"
+#include "../../include/block/secondary_cache.h"
 #include "../../include/config/config.h"
 #include "../../include/consts.h"
 #include "../../include/sst/sst_iterator.h"
+#include "../../include/utils/io_uring.h"
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <filesystem>
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <sys/stat.h>
+#include <unordered_map>
 
 namespace toni_lsm {
 
+// 每个线程一个 io_uring, 提交和收割都不需要加锁
+static IoUring &local_io_uring() {
+  thread_local IoUring ring(
+      std::max(0, TomlConfig::getInstance().getLsmIoUringQueueDepth()));
+  return ring;
+}
+
+// 同一个文件每次打开得到的值相同; 删除后以相同路径重新生成的文件,
+// 修改时间不同, 通常 inode 和元数据块也不同
+static uint64_t file_identity(const FileObj &file,
+                              const std::vector<uint8_t> &meta_bytes) {
+  uint64_t id = std::hash<std::string_view>{}(std::string_view(
+      reinterpret_cast<const char *>(meta_bytes.data()), meta_bytes.size()));
+  struct stat st;
+  if (::fstat(file.fd(), &st) == 0) {
+    id = mix64(id ^ static_cast<uint64_t>(st.st_ino));
+    id = mix64(id ^ static_cast<uint64_t>(st.st_mtim.tv_sec));
+    id = mix64(id ^ static_cast<uint64_t>(st.st_mtim.tv_nsec));
+  }
+  return id == 0 ? 1 : id;
+}
+
+// **************************************************
+// SSTReader
+// **************************************************
+
+std::pair<size_t, size_t> SSTReader::block_range(size_t block_idx) const {
+  size_t offset = index.offset(block_idx);
+  if (block_idx == index.size() - 1) {
+    return {offset, meta_block_offset - offset};
+  }
+  return {offset, index.offset(block_idx + 1) - offset};
+}
+
 // **************************************************
 // SST
 // **************************************************
 
+SST::~SST() {
+  if (table_cache_ != nullptr) {
+    table_cache_->erase(sst_id);
+  }
+}
+
 std::shared_ptr<SST> SST::open(size_t sst_id, FileObj file,
                                std::shared_ptr<BlockCache> block_cache) {
   auto sst = std::make_shared<SST>();
   sst->sst_id = sst_id;
-  sst->file = std::move(file);
   sst->block_cache = block_cache;
+  sst->use_mmap_ = TomlConfig::getInstance().getLsmSstUseMmap();
+  // 被 TableCache 关闭之后按路径和原来的方式重新打开
+  sst->path_ = file.path();
+  sst->direct_io_pool_ = file.direct_pool();
 
-  size_t file_size = sst->file.size();
+  size_t file_size = file.size();
+  sst->file_size_ = file_size;
   // 读取文件末尾的元数据块
   if (file_size < sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2) {
     throw std::runtime_error("Invalid SST file: too small");
   }
 
   // 0. 读取最大和最小的事务id
-  auto max_tranc_id =
-      sst->file.read_to_slice(file_size - sizeof(uint64_t), sizeof(uint64_t));
-  memcpy(&sst->max_tranc_id_, max_tranc_id.data(), sizeof(uint64_t));
+  sst->max_tranc_id_ = file.read_uint64(file_size - sizeof(uint64_t));
+  sst->min_tranc_id_ = file.read_uint64(file_size - sizeof(uint64_t) * 2);
+
+  // 1~3. 读取 bloom filter 和元数据块
+  auto reader = load_reader(std::move(file), file_size, sst->use_mmap_);
+
+  // 4. 设置首尾key
+  if (!reader->index.empty()) {
+    sst->first_key = reader->index.first_key();
+    sst->last_key = reader->index.last_key();
+  }
+  sst->reader_ = std::move(reader);
+
+  return sst;
+}
 
-  auto min_tranc_id = sst->file.read_to_slice(file_size - sizeof(uint64_t) * 2,
-                                              sizeof(uint64_t));
-  memcpy(&sst->min_tranc_id_, min_tranc_id.data(), sizeof(uint64_t));
+std::shared_ptr<SST>
+SST::open_lazy(const SSTFileMeta &meta, const std::string &path,
+               std::shared_ptr<BlockCache> block_cache) {
+  auto sst = std::make_shared<SST>();
+  sst->sst_id = meta.sst_id;
+  sst->file_size_ = meta.file_size;
+  sst->first_key = meta.first_key;
+  sst->last_key = meta.last_key;
+  sst->min_tranc_id_ = meta.min_tranc_id;
+  sst->max_tranc_id_ = meta.max_tranc_id;
+  sst->path_ = path;
+  sst->block_cache = block_cache;
+  sst->use_mmap_ = TomlConfig::getInstance().getLsmSstUseMmap();
+  return sst;
+}
+
+std::shared_ptr<SSTReader> SST::load_reader(FileObj file, size_t file_size,
+                                            bool use_mmap) {
+  if (file_size < sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2) {
+    throw std::runtime_error("Invalid SST file: too small");
+  }
+  auto reader = std::make_shared<SSTReader>();
 
   // 1. 读取元数据块的偏移量, 最后8字节: 2个 uint32_t,
   // 分别是 meta 和 bloom 的 offset
 
-  auto bloom_offset_bytes = sst->file.read_to_slice(
-      file_size - sizeof(uint64_t) * 2 - sizeof(uint32_t), sizeof(uint32_t));
-  memcpy(&sst->bloom_offset, bloom_offset_bytes.data(), sizeof(uint32_t));
-
-  auto meta_offset_bytes = sst->file.read_to_slice(
-      file_size - sizeof(uint64_t) * 2 - sizeof(uint32_t) * 2,
-      sizeof(uint32_t));
-  memcpy(&sst->meta_block_offset, meta_offset_bytes.data(), sizeof(uint32_t));
+  reader->bloom_offset =
+      file.read_uint32(file_size - sizeof(uint64_t) * 2 - sizeof(uint32_t));
+  reader->meta_block_offset = file.read_uint32(
+      file_size - sizeof(uint64_t) * 2 - sizeof(uint32_t) * 2);
 
   // 2. 读取 bloom filter
-  if (sst->bloom_offset + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) <
+  if (reader->bloom_offset + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) <
       file_size) {
     // 布隆过滤器偏移量 + 2*uint32_t 的大小小于文件大小
     // 表示存在布隆过滤器
-    uint32_t bloom_size = file_size - sizeof(uint64_t) * 2 - sst->bloom_offset -
-                          sizeof(uint32_t) * 2;
-    auto bloom_bytes = sst->file.read_to_slice(sst->bloom_offset, bloom_size);
+    uint32_t bloom_size = file_size - sizeof(uint64_t) * 2 -
+                          reader->bloom_offset - sizeof(uint32_t) * 2;
+    auto bloom_bytes = file.read_to_slice(reader->bloom_offset, bloom_size);
 
     auto bloom = BloomFilter::decode(bloom_bytes);
-    sst->bloom_filter = std::make_shared<BloomFilter>(std::move(bloom));
+    reader->bloom_filter = std::make_shared<BloomFilter>(std::move(bloom));
   }
 
   // 3. 读取并解码元数据块
-  uint32_t meta_size = sst->bloom_offset - sst->meta_block_offset;
-  auto meta_bytes = sst->file.read_to_slice(sst->meta_block_offset, meta_size);
-  sst->meta_entries = BlockMeta::decode_meta_from_slice(meta_bytes);
+  uint32_t meta_size = reader->bloom_offset - reader->meta_block_offset;
+  auto meta_bytes = file.read_to_slice(reader->meta_block_offset, meta_size);
+  reader->index = BlockIndex(BlockMeta::decode_meta_from_slice(meta_bytes));
+  reader->file_id = file_identity(file, meta_bytes);
+
+  // 4. 数据块通过映射读取, 由内核页缓存充当二级缓存
+  if (use_mmap) {
+    reader->mapped = file.map_readonly();
+  }
 
-  // 4. 设置首尾key
-  if (!sst->meta_entries.empty()) {
-    sst->first_key = sst->meta_entries.front().first_key;
-    sst->last_key = sst->meta_entries.back().last_key;
+  reader->file = std::move(file);
+  return reader;
+}
+
+std::shared_ptr<SSTReader> SST::get_reader() const {
+  auto reader = reader_.load();
+  if (reader != nullptr) {
+    if (table_cache_ != nullptr) {
+      table_cache_->touch(sst_id);
+    }
+    return reader;
   }
 
-  return sst;
+  bool opened = false;
+  bool pinned;
+  {
+    std::lock_guard<std::mutex> lock(open_mtx_);
+    reader = reader_.load();
+    if (reader == nullptr) {
+      reader = load_reader(FileObj::open(path_, false, direct_io_pool_),
+                           file_size_, use_mmap_);
+      reader_.store(reader);
+      opened = true;
+    }
+    pinned = pinned_ || pin_reader_;
+  }
+  // 登记时可能淘汰其他 sst, 不能持有 open_mtx_
+  if (opened && !pinned && table_cache_ != nullptr) {
+    table_cache_->insert(sst_id, weak_from_this(), reader_charge(*reader));
+  }
+  return reader;
+}
+
+size_t SST::reader_charge(const SSTReader &reader) const {
+  // block 索引按照内存中的大小计算, 布隆过滤器和 footer 按照文件中的大小估计
+  return reader.index.memory_usage() + file_size_ - reader.bloom_offset;
+}
+
+void SST::attach_table_cache(std::shared_ptr<TableCache> table_cache) {
+  table_cache_ = std::move(table_cache);
+  std::shared_ptr<SSTReader> reader;
+  {
+    std::lock_guard<std::mutex> lock(open_mtx_);
+    if (!pinned_ && !pin_reader_) {
+      reader = reader_.load();
+    }
+  }
+  if (reader != nullptr && table_cache_ != nullptr) {
+    table_cache_->insert(sst_id, weak_from_this(), reader_charge(*reader));
+  }
 }
 
-void SST::del_sst() { file.del_file(); }
+void SST::release_reader() const {
+  std::lock_guard<std::mutex> lock(open_mtx_);
+  if (!pinned_ && !pin_reader_) {
+    reader_.store(nullptr);
+  }
+}
+
+void SST::set_pin_reader(bool pin) {
+  std::shared_ptr<SSTReader> reader;
+  {
+    std::lock_guard<std::mutex> lock(open_mtx_);
+    if (pin_reader_ == pin) {
+      return;
+    }
+    pin_reader_ = pin;
+    if (!pin && !pinned_) {
+      reader = reader_.load();
+    }
+  }
+  if (table_cache_ == nullptr) {
+    return;
+  }
+  if (pin) {
+    table_cache_->erase(sst_id);
+  } else if (reader != nullptr) {
+    // 已经打开的重新登记, 之后可以被关闭
+    table_cache_->insert(sst_id, weak_from_this(), reader_charge(*reader));
+  }
+}
+
+bool SST::is_reader_pinned() const {
+  std::lock_guard<std::mutex> lock(open_mtx_);
+  return pin_reader_;
+}
+
+void SST::set_use_mmap(bool use_mmap) {
+  std::lock_guard<std::mutex> lock(open_mtx_);
+  if (use_mmap_ == use_mmap) {
+    return;
+  }
+  use_mmap_ = use_mmap;
+  // 已删除的 sst 不能重新打开, 保持原来的读取方式
+  if (!pinned_ && !path_.empty()) {
+    reader_.store(nullptr);
+  }
+}
+
+void SST::set_direct_io(std::shared_ptr<AlignedBufferPool> pool) {
+  std::lock_guard<std::mutex> lock(open_mtx_);
+  if (direct_io_pool_ == pool) {
+    return;
+  }
+  direct_io_pool_ = std::move(pool);
+  if (!pinned_ && !path_.empty()) {
+    reader_.store(nullptr);
+  }
+}
+
+void SST::del_sst() {
+  {
+    std::lock_guard<std::mutex> lock(open_mtx_);
+    pinned_ = true;
+  }
+  // 保持文件打开直到 sst 被销毁,
+  // 持有该 sst 的读者在文件被删除后仍然可以通过句柄读取
+  auto reader = get_reader();
+  if (table_cache_ != nullptr) {
+    table_cache_->erase(sst_id);
+  }
+  reader->file.del_file();
+}
+
+void SST::rename_sst(const std::string &new_path) {
+  std::lock_guard<std::mutex> lock(open_mtx_);
+  auto reader = reader_.load();
+  if (reader != nullptr) {
+    reader->file.rename(new_path);
+  } else {
+    std::filesystem::rename(path_, new_path);
+  }
+  path_ = new_path;
+}
 
 std::shared_ptr<SST> SST::create_sst_with_meta_only(
     size_t sst_id, size_t file_size, const std::string &first_key,
     const std::string &last_key, std::shared_ptr<BlockCache> block_cache) {
   auto sst = std::make_shared<SST>();
-  sst->file.set_size(file_size);
+  auto reader = std::make_shared<SSTReader>();
+  reader->file.set_size(file_size);
+  sst->reader_ = std::move(reader);
+  sst->pinned_ = true;
+  sst->file_size_ = file_size;
   sst->sst_id = sst_id;
   sst->first_key = first_key;
   sst->last_key = last_key;
-  sst->meta_block_offset = 0;
   sst->block_cache = block_cache;
 
   return sst;
 }
 
-std::shared_ptr<Block> SST::read_block(size_t block_idx) {
-  if (block_idx >= meta_entries.size()) {
+std::shared_ptr<Block> SST::read_block(size_t block_idx, bool fill_cache) {
+  auto reader = get_reader();
+  if (block_idx >= reader->index.size()) {
     throw std::out_of_range("Block index out of range");
   }
 
@@ -108,57 +319,238 @@ std::shared_ptr<Block> SST::read_block(size_t block_idx) {
     throw std::runtime_error("Block cache not set");
   }
 
-  const auto &meta = meta_entries[block_idx];
-  size_t block_size;
+  auto [offset, block_size] = reader->block_range(block_idx);
 
-  // 计算block大小
-  if (block_idx == meta_entries.size() - 1) {
-    block_size = meta_block_offset - meta.offset;
+  // 读取block数据
+  std::shared_ptr<Block> block_res = read_secondary(block_idx, *reader);
+  if (block_res != nullptr) {
+    // 二级缓存命中, 不需要读取 sst 文件
+  } else if (reader->mapped != nullptr) {
+    // 直接引用映射区域, block 持有映射, sst 被关闭后映射仍然有效
+    if (offset + block_size > reader->mapped->size()) {
+      throw std::out_of_range("Read beyond file size");
+    }
+    block_res = Block::decode_view(reader->mapped->data_at(offset), block_size,
+                                   true, reader->mapped);
   } else {
-    block_size = meta_entries[block_idx + 1].offset - meta.offset;
+    // 读取出的缓冲区直接作为 block 的数据段
+    auto block_data = reader->file.read_to_slice(offset, block_size);
+    block_res = Block::decode(std::move(block_data), true);
   }
 
-  // 读取block数据
-  auto block_data = file.read_to_slice(meta.offset, block_size);
-  auto block_res = Block::decode(block_data, true);
-
   // 更新缓存
-  if (block_cache != nullptr) {
-    block_cache->put(this->sst_id, block_idx, block_res);
-  } else {
-    throw std::runtime_error("Block cache not set");
+  if (fill_cache) {
+    block_cache->put(this->sst_id, block_idx, block_res, reader->file_id);
   }
   return block_res;
 }
 
-size_t SST::find_block_idx(const std::string &key) {
-  // 先在布隆过滤器判断key是否存在
-  if (bloom_filter != nullptr && !bloom_filter->possibly_contains(key)) {
-    return -1;
+std::shared_ptr<Block> SST::read_secondary(size_t block_idx,
+                                           const SSTReader &reader) {
+  const auto &secondary = block_cache->secondary_cache();
+  if (secondary == nullptr) {
+    return nullptr;
+  }
+  // 二级缓存保存的是不带 hash 的编码
+  // 旧目录重新加载时 sst_id 可能被复用, 由 file_id 确认属于当前文件
+  size_t encoded_size = reader.block_range(block_idx).second - sizeof(uint32_t);
+  return secondary->lookup(sst_id, block_idx, reader.file_id, encoded_size);
+}
+
+std::vector<std::shared_ptr<Block>> SST::read_blocks(
+    const std::vector<std::pair<std::shared_ptr<SST>, size_t>> &blocks,
+    bool fill_cache) {
+  std::vector<std::shared_ptr<Block>> result(blocks.size());
+
+  // 需要从磁盘读取的 block, 同一个 block 只读取一次
+  struct Pending {
+    SST *sst;
+    size_t block_idx;
+    std::shared_ptr<SSTReader> reader; // 持有打开状态, 读取期间文件不会被关闭
+    std::vector<uint8_t> buf;
+    std::vector<size_t> positions; // 在 result 中的位置
+    AlignedBuffer aligned;         // O_DIRECT 读取时的对齐缓冲区
+  };
+  std::vector<Pending> pending;
+  std::unordered_map<std::pair<size_t, size_t>, size_t, pair_hash, pair_equal>
+      pending_idx;
+
+  for (size_t i = 0; i < blocks.size(); i++) {
+    auto &[sst, block_idx] = blocks[i];
+    auto key = std::make_pair(sst->sst_id, block_idx);
+    auto it = pending_idx.find(key);
+    if (it != pending_idx.end()) {
+      pending[it->second].positions.push_back(i);
+      continue;
+    }
+
+    auto reader = sst->get_reader();
+    if (block_idx >= reader->index.size()) {
+      throw std::out_of_range("Block index out of range");
+    }
+    if (sst->block_cache == nullptr) {
+      throw std::runtime_error("Block cache not set");
+    }
+    auto cache_ptr = sst->block_cache->get(sst->sst_id, block_idx);
+    if (cache_ptr != nullptr) {
+      result[i] = cache_ptr;
+      continue;
+    }
+    if (reader->mapped != nullptr) {
+      // mmap 模式下不需要发起读取
+      result[i] = sst->read_block(block_idx, fill_cache);
+      continue;
+    }
+    auto secondary_ptr = sst->read_secondary(block_idx, *reader);
+    if (secondary_ptr != nullptr) {
+      if (fill_cache) {
+        sst->block_cache->put(sst->sst_id, block_idx, secondary_ptr,
+                              reader->file_id);
+      }
+      result[i] = secondary_ptr;
+      continue;
+    }
+
+    auto [offset, block_size] = reader->block_range(block_idx);
+    pending_idx[key] = pending.size();
+    pending.push_back(Pending{sst.get(), block_idx, reader,
+                              std::vector<uint8_t>(block_size),
+                              std::vector<size_t>{i}, AlignedBuffer()});
+  }
+  if (pending.empty()) {
+    return result;
   }
 
-  // 二分查找
-  size_t left = 0;
-  size_t right = meta_entries.size();
+  std::vector<ReadRequest> requests(pending.size());
+  for (size_t i = 0; i < pending.size(); i++) {
+    auto &p = pending[i];
+    size_t offset = p.reader->block_range(p.block_idx).first;
+    requests[i].fd = p.reader->file.fd();
+    auto direct_pool = p.reader->file.direct_pool();
+    if (direct_pool == nullptr) {
+      requests[i].offset = offset;
+      requests[i].length = p.buf.size();
+      requests[i].buf = p.buf.data();
+      continue;
+    }
+    // O_DIRECT 需要读取覆盖该 block 的对齐区间
+    size_t aligned_offset = AlignedBufferPool::align_down(offset);
+    size_t aligned_end = AlignedBufferPool::align_up(offset + p.buf.size());
+    p.aligned = direct_pool->acquire(aligned_end - aligned_offset);
+    requests[i].offset = aligned_offset;
+    requests[i].length = aligned_end - aligned_offset;
+    requests[i].buf = p.aligned.data();
+    requests[i].required = offset + p.buf.size() - aligned_offset;
+  }
+  local_io_uring().read_batch(requests);
 
-  while (left < right) {
-    size_t mid = (left + right) / 2;
-    const auto &meta = meta_entries[mid];
+  for (size_t i = 0; i < pending.size(); i++) {
+    auto &p = pending[i];
+    if (!requests[i].ok) {
+      throw std::runtime_error("Failed to read block from sst " +
+                               std::to_string(p.sst->sst_id));
+    }
+    if (p.aligned.data() != nullptr) {
+      size_t skip = requests[i].required - p.buf.size();
+      memcpy(p.buf.data(), p.aligned.data() + skip, p.buf.size());
+      p.aligned = AlignedBuffer();
+    }
+    auto block = Block::decode(std::move(p.buf), true);
+    if (fill_cache) {
+      p.sst->block_cache->put(p.sst->sst_id, p.block_idx, block,
+                              p.reader->file_id);
+    }
+    for (auto pos : p.positions) {
+      result[pos] = block;
+    }
+  }
+  return result;
+}
 
-    if (key < meta.first_key) {
-      right = mid;
-    } else if (key > meta.last_key) {
-      left = mid + 1;
-    } else {
-      return mid;
+size_t SST::prefetch_blocks(std::vector<size_t> block_idxs) {
+  if (block_cache == nullptr) {
+    throw std::runtime_error("Block cache not set");
+  }
+  auto reader = get_reader();
+  std::sort(block_idxs.begin(), block_idxs.end());
+  block_idxs.erase(std::unique(block_idxs.begin(), block_idxs.end()),
+                   block_idxs.end());
+  std::erase_if(block_idxs, [&](size_t idx) {
+    return idx >= reader->index.size() ||
+           block_cache->contains(sst_id, idx);
+  });
+  if (reader->mapped != nullptr) {
+    // mmap 模式下只需要把映射的页读入, 由内核负责预读
+    for (auto idx : block_idxs) {
+      read_block(idx);
     }
+    return block_idxs.size();
   }
 
-  if (left >= meta_entries.size()) {
-    // 如果没有找到完全匹配的块，返回-1
+  for (size_t i = 0; i < block_idxs.size();) {
+    auto [start, first_size] = reader->block_range(block_idxs[i]);
+    size_t end = start + first_size;
+    size_t j = i + 1;
+    for (; j < block_idxs.size(); j++) {
+      auto [offset, size] = reader->block_range(block_idxs[j]);
+      if (offset - end > kPrefetchMaxGap ||
+          offset + size - start > kPrefetchMaxBytes) {
+        break;
+      }
+      end = offset + size;
+    }
+
+    // 一次读取覆盖 block_idxs[i, j) 的连续区间
+    auto buf = reader->file.read_to_slice(start, end - start);
+    for (; i < j; i++) {
+      auto [offset, size] = reader->block_range(block_idxs[i]);
+      auto begin = buf.begin() + (offset - start);
+      auto block =
+          Block::decode(std::vector<uint8_t>(begin, begin + size), true);
+      block_cache->put(sst_id, block_idxs[i], block, reader->file_id);
+    }
+  }
+  return block_idxs.size();
+}
+
+size_t SST::find_block_idx(const std::string &key) {
+  auto reader = get_reader();
+  // 先在布隆过滤器判断key是否存在
+  if (reader->bloom_filter != nullptr &&
+      !reader->bloom_filter->possibly_contains(key)) {
     return -1;
   }
-  return left;
+
+  // 在分隔 key 中二分查找
+  size_t idx = reader->index.find(key);
+  if (idx >= reader->index.size()) {
+    // key 大于 sst 的 last_key
+    return -1;
+  }
+  return idx;
+}
+
+std::vector<size_t> SST::find_block_idxs(std::span<const std::string> keys) {
+  std::vector<size_t> result(keys.size(), -1);
+  auto reader = get_reader();
+  const auto &index = reader->index;
+  // key 有序, 之后的 key 只会落在相同或者更靠后的 block 中
+  size_t begin = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    const auto &key = keys[i];
+    if (key < first_key || key > last_key) {
+      continue;
+    }
+    if (reader->bloom_filter != nullptr &&
+        !reader->bloom_filter->possibly_contains(key)) {
+      continue;
+    }
+    begin = index.find(key, begin);
+    if (begin < index.size()) {
+      result[i] = begin;
+    }
+  }
+  return result;
 }
 
 SstIterator SST::get(const std::string &key, uint64_t tranc_id) {
@@ -167,30 +559,46 @@ SstIterator SST::get(const std::string &key, uint64_t tranc_id) {
   }
 
   // 在布隆过滤器判断key是否存在
-  if (bloom_filter != nullptr && !bloom_filter->possibly_contains(key)) {
+  auto reader = get_reader();
+  if (reader->bloom_filter != nullptr &&
+      !reader->bloom_filter->possibly_contains(key)) {
     return this->end();
   }
 
   return SstIterator(shared_from_this(), key, tranc_id);
 }
 
-size_t SST::num_blocks() const { return meta_entries.size(); }
+size_t SST::num_blocks() const { return get_reader()->index.size(); }
+
+std::shared_ptr<const BlockIndex> SST::get_block_index() const {
+  auto reader = get_reader();
+  return std::shared_ptr<const BlockIndex>(reader, &reader->index);
+}
+
+std::shared_ptr<const std::vector<BlockMeta>> SST::get_meta_entries() const {
+  auto reader = get_reader();
+  uint32_t meta_size = reader->bloom_offset - reader->meta_block_offset;
+  auto meta_bytes =
+      reader->file.read_to_slice(reader->meta_block_offset, meta_size);
+  return std::make_shared<const std::vector<BlockMeta>>(
+      BlockMeta::decode_meta_from_slice(meta_bytes));
+}
 
 std::string SST::get_first_key() const { return first_key; }
 
 std::string SST::get_last_key() const { return last_key; }
 
-size_t SST::sst_size() const { return file.size(); }
+size_t SST::sst_size() const { return file_size_; }
 
 size_t SST::get_sst_id() const { return sst_id; }
 
-SstIterator SST::begin(uint64_t tranc_id) {
-  return SstIterator(shared_from_this(), tranc_id);
+SstIterator SST::begin(uint64_t tranc_id, bool fill_cache) {
+  return SstIterator(shared_from_this(), tranc_id, fill_cache);
 }
 
 SstIterator SST::end() {
   SstIterator res(shared_from_this(), 0);
-  res.m_block_idx = meta_entries.size();
+  res.m_block_idx = num_blocks();
   res.m_block_it = nullptr;
   return res;
 }
@@ -199,6 +607,48 @@ std::pair<uint64_t, uint64_t> SST::get_tranc_id_range() const {
   return std::make_pair(min_tranc_id_, max_tranc_id_);
 }
 
+SSTFileMeta SST::get_file_meta() const {
+  SSTFileMeta meta;
+  meta.sst_id = sst_id;
+  meta.file_size = file_size_;
+  meta.first_key = first_key;
+  meta.last_key = last_key;
+  meta.min_tranc_id = min_tranc_id_;
+  meta.max_tranc_id = max_tranc_id_;
+  return meta;
+}
+
+// **************************************************
+// BlockReadahead
+// **************************************************
+
+std::shared_ptr<Block> BlockReadahead::read(const std::shared_ptr<SST> &sst,
+                                            size_t block_idx) {
+  // 调用方在使用窗口期间持有 sst, 地址不会被复用
+  if (sst.get() == sst_ && block_idx >= start_ &&
+      block_idx < start_ + blocks_.size()) {
+    return blocks_[block_idx - start_];
+  }
+
+  size_t num_blocks = sst->num_blocks();
+  size_t readahead =
+      std::max(1, TomlConfig::getInstance().getLsmReadaheadBlocks());
+  if (readahead <= 1 || block_idx + 1 >= num_blocks) {
+    return sst->read_block(block_idx, fill_cache_);
+  }
+
+  size_t count = std::min(readahead, num_blocks - block_idx);
+  std::vector<std::pair<std::shared_ptr<SST>, size_t>> wanted;
+  wanted.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    wanted.emplace_back(sst, block_idx + i);
+  }
+  blocks_ = SST::read_blocks(wanted, fill_cache_);
+  sst_ = sst.get();
+  start_ = block_idx;
+  return blocks_.front();
+}
+
 // **************************************************
 // SSTBuilder
 // **************************************************
@@ -248,7 +698,15 @@ void SSTBuilder::add(const std::string &key, const std::string &value,
   last_key = key; // 更新最后一个key
 }
 
-size_t SSTBuilder::estimated_size() const { return data.size(); }
+void SSTBuilder::set_direct_io(std::shared_ptr<AlignedBufferPool> pool) {
+  direct_io_pool_ = std::move(pool);
+}
+
+size_t SSTBuilder::estimated_size() const {
+  // 还未写入 data 的当前 block 也要计入, 否则只剩最后一个 block
+  // 的 builder 会被误判为空
+  return data.size() + (block.is_empty() ? 0 : block.cur_size());
+}
 
 void SSTBuilder::finish_block() {
   auto old_block = std::move(this->block);
@@ -261,9 +719,7 @@ void SSTBuilder::finish_block() {
       std::string_view(reinterpret_cast<const char *>(encoded_block.data()),
                        encoded_block.size())));
 
-  // 预分配空间并添加数据
-  data.reserve(data.size() + encoded_block.size() +
-               sizeof(uint32_t)); // 加上的是哈希值
+  // 添加数据, 不能按精确大小 reserve, 否则每个 block 都会触发一次整体拷贝
   data.insert(data.end(), encoded_block.begin(), encoded_block.end());
   data.resize(data.size() + sizeof(uint32_t));
   memcpy(data.data() + data.size() - sizeof(uint32_t), &block_hash,
@@ -325,19 +781,34 @@ SSTBuilder::build(size_t sst_id, const std::string &path,
          &max_tranc_id_, sizeof(uint64_t));
 
   // 创建文件
-  FileObj file = FileObj::create_and_write(path, file_content);
+  FileObj file =
+      FileObj::create_and_write(path, file_content, direct_io_pool_);
 
   // 返回SST对象
   auto res = std::make_shared<SST>();
 
   res->sst_id = sst_id;
-  res->file = std::move(file);
+  res->file_size_ = file.size();
+  res->path_ = path;
   res->first_key = meta_entries.front().first_key;
   res->last_key = meta_entries.back().last_key;
-  res->meta_block_offset = meta_offset;
-  res->bloom_filter = this->bloom_filter;
-  res->bloom_offset = bloom_offset;
-  res->meta_entries = std::move(meta_entries);
+
+  res->use_mmap_ = TomlConfig::getInstance().getLsmSstUseMmap();
+  res->direct_io_pool_ = file.direct_pool();
+
+  auto reader = std::make_shared<SSTReader>();
+  if (res->use_mmap_) {
+    reader->mapped = file.map_readonly();
+  }
+  reader->file = std::move(file);
+  reader->meta_block_offset = meta_offset;
+  reader->bloom_filter = this->bloom_filter;
+  reader->bloom_offset = bloom_offset;
+  reader->index = BlockIndex(meta_entries);
+  // 与重新打开时从文件中读取的元数据块相同, 得到的 file_id 一致
+  reader->file_id = file_identity(reader->file, meta_block);
+  res->reader_ = std::move(reader);
+
   res->block_cache = block_cache;
   res->max_tranc_id_ = max_tranc_id_;
   res->min_tranc_id_ = min_tranc_id_;
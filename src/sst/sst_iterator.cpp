@@ -1,5 +1,6 @@
 #include "../../include/sst/sst_iterator.h"
 #include "../../include/sst/sst.h"
+#include <algorithm>
 #include <cstddef>
 #include <optional>
 #include <stdexcept>
@@ -15,11 +16,13 @@ std::optional<std::pair<SstIterator, SstIterator>> sst_iters_monotony_predicate(
     std::function<int(const std::string &)> predicate) {
   std::optional<SstIterator> final_begin = std::nullopt;
   std::optional<SstIterator> final_end = std::nullopt;
-  for (int block_idx = 0; block_idx < sst->meta_entries.size(); block_idx++) {
+  auto index = sst->get_block_index();
+  for (int block_idx = 0; block_idx < index->size(); block_idx++) {
     auto block = sst->read_block(block_idx);
 
-    BlockMeta &meta_i = sst->meta_entries[block_idx];
-    if (predicate(meta_i.first_key) < 0 || predicate(meta_i.last_key) > 0) {
+    // 分隔 key 不小于 block 的 last_key
+    if (predicate(block->get_first_key()) < 0 ||
+        predicate(std::string(index->separator(block_idx))) > 0) {
       break;
     }
 
@@ -47,8 +50,10 @@ std::optional<std::pair<SstIterator, SstIterator>> sst_iters_monotony_predicate(
   return std::make_pair(final_begin.value(), final_end.value());
 }
 
-SstIterator::SstIterator(std::shared_ptr<SST> sst, uint64_t tranc_id)
-    : m_sst(sst), m_block_idx(0), m_block_it(nullptr), max_tranc_id_(tranc_id) {
+SstIterator::SstIterator(std::shared_ptr<SST> sst, uint64_t tranc_id,
+                         bool fill_cache)
+    : m_sst(sst), m_block_idx(0), m_block_it(nullptr), max_tranc_id_(tranc_id),
+      fill_cache_(fill_cache), readahead_(fill_cache) {
   if (m_sst) {
     seek_first();
   }
@@ -74,7 +79,7 @@ void SstIterator::seek_first() {
   }
 
   m_block_idx = 0;
-  auto block = m_sst->read_block(m_block_idx);
+  auto block = m_sst->read_block(m_block_idx, fill_cache_);
   m_block_it = std::make_shared<BlockIterator>(block, 0, max_tranc_id_);
 }
 
@@ -111,6 +116,27 @@ void SstIterator::seek(const std::string &key) {
   }
 }
 
+void SstIterator::seek_lower_bound(const std::string &key) {
+  if (!m_sst) {
+    m_block_it = nullptr;
+    return;
+  }
+
+  // 找到第一个分隔 key >= key 的 block, 不经过布隆过滤器
+  auto index = m_sst->get_block_index();
+  m_block_idx = index->find(key);
+  if (m_block_idx >= index->size()) {
+    m_block_it = nullptr;
+    return;
+  }
+  auto block = m_sst->read_block(m_block_idx);
+  m_block_it = std::make_shared<BlockIterator>(block, 0, max_tranc_id_);
+  // key 位于 last_key 和分隔 key 之间时, 会移动到下一个 block 的第一个 key
+  while (is_valid() && (*m_block_it)->first < key) {
+    ++(*this);
+  }
+}
+
 std::string SstIterator::key() {
   if (!m_block_it) {
     throw std::runtime_error("Iterator is invalid");
@@ -133,8 +159,8 @@ BaseIterator &SstIterator::operator++() {
   if (m_block_it->is_end()) {
     m_block_idx++;
     if (m_block_idx < m_sst->num_blocks()) {
-      // 读取下一个block
-      auto next_block = m_sst->read_block(m_block_idx);
+      // 读取下一个block, 不在预读窗口中时批量读取之后的若干个 block
+      auto next_block = readahead_.read(m_sst, m_block_idx);
       BlockIterator new_blk_it(next_block, 0, max_tranc_id_);
       (*m_block_it) = new_blk_it;
     } else {
@@ -179,6 +205,12 @@ SstIterator::value_type SstIterator::operator*() const {
 IteratorType SstIterator::get_type() const { return IteratorType::SstIterator; }
 
 uint64_t SstIterator::get_tranc_id() const { return max_tranc_id_; }
+uint64_t SstIterator::get_cur_tranc_id() const {
+  if (!m_block_it) {
+    throw std::runtime_error("Iterator is invalid");
+  }
+  return m_block_it->get_cur_tranc_id();
+}
 bool SstIterator::is_end() const { return !m_block_it; }
 
 bool SstIterator::is_valid() const {
@@ -203,7 +235,9 @@ SstIterator::merge_sst_iterator(std::vector<SstIterator> iter_vec,
     return std::make_pair(HeapIterator(), HeapIterator());
   }
 
+  // compact 时删除标记必须保留, 否则更下层的旧版本会重新可见
   HeapIterator it_begin;
+  it_begin.skip_delete_ = false;
   for (auto &iter : iter_vec) {
     while (iter.is_valid() && !iter.is_end()) {
       it_begin.items.emplace(
@@ -0,0 +1,72 @@
+#include "../../include/sst/table_cache.h"
+#include "../../include/sst/sst.h"
+#include <vector>
+
+namespace toni_lsm {
+
+TableCache::TableCache(size_t max_open_files, size_t capacity)
+    : max_open_files_(max_open_files), capacity_(capacity) {}
+
+void TableCache::insert(size_t sst_id, std::weak_ptr<const SST> sst,
+                        size_t charge) {
+  // 被淘汰的 sst 在释放 mtx_ 之后再关闭, 关闭时需要获取 sst 自己的锁,
+  // 最后一个引用释放时 sst 的析构也会调用 erase
+  std::vector<std::shared_ptr<const SST>> victims;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(sst_id);
+    if (it != index_.end()) {
+      usage_ -= it->second->charge;
+      lru_.erase(it->second);
+    }
+    lru_.push_front(Entry{sst_id, std::move(sst), charge});
+    index_[sst_id] = lru_.begin();
+    usage_ += charge;
+
+    // 至少保留刚打开的 sst
+    while (lru_.size() > 1 &&
+           (lru_.size() > max_open_files_ || usage_ > capacity_)) {
+      auto &victim = lru_.back();
+      if (auto victim_sst = victim.sst.lock()) {
+        victims.push_back(std::move(victim_sst));
+      }
+      usage_ -= victim.charge;
+      index_.erase(victim.sst_id);
+      lru_.pop_back();
+    }
+  }
+
+  for (auto &victim : victims) {
+    victim->release_reader();
+  }
+}
+
+void TableCache::touch(size_t sst_id) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = index_.find(sst_id);
+  if (it != index_.end() && it->second != lru_.begin()) {
+    lru_.splice(lru_.begin(), lru_, it->second);
+  }
+}
+
+void TableCache::erase(size_t sst_id) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = index_.find(sst_id);
+  if (it == index_.end()) {
+    return;
+  }
+  usage_ -= it->second->charge;
+  lru_.erase(it->second);
+  index_.erase(it);
+}
+
+size_t TableCache::open_files() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return lru_.size();
+}
+
+size_t TableCache::usage() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return usage_;
+}
+} // namespace toni_lsm
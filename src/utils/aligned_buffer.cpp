@@ -0,0 +1,93 @@
+#include "../../include/utils/aligned_buffer.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <new>
+
+namespace toni_lsm {
+
+// **************************************************
+// AlignedBuffer
+// **************************************************
+
+AlignedBuffer::~AlignedBuffer() {
+  if (data_ != nullptr) {
+    pool_->release(data_, capacity_);
+  }
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other) noexcept
+    : data_(other.data_), capacity_(other.capacity_),
+      pool_(std::move(other.pool_)) {
+  other.data_ = nullptr;
+  other.capacity_ = 0;
+}
+
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other) noexcept {
+  if (this != &other) {
+    if (data_ != nullptr) {
+      pool_->release(data_, capacity_);
+    }
+    data_ = other.data_;
+    capacity_ = other.capacity_;
+    pool_ = std::move(other.pool_);
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+  }
+  return *this;
+}
+
+// **************************************************
+// AlignedBufferPool
+// **************************************************
+
+AlignedBufferPool::AlignedBufferPool(size_t max_cached_bytes)
+    : max_cached_bytes_(max_cached_bytes) {}
+
+AlignedBufferPool::~AlignedBufferPool() {
+  for (auto &[capacity, buffers] : free_lists_) {
+    for (auto *data : buffers) {
+      std::free(data);
+    }
+  }
+}
+
+AlignedBuffer AlignedBufferPool::acquire(size_t size) {
+  // 向上取整到 2 的幂, 大小相近的请求可以复用同一级的缓冲区
+  size_t capacity = std::bit_ceil(std::max(size, kAlignment));
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = free_lists_.find(capacity);
+    if (it != free_lists_.end() && !it->second.empty()) {
+      uint8_t *data = it->second.back();
+      it->second.pop_back();
+      cached_bytes_ -= capacity;
+      return AlignedBuffer(data, capacity, shared_from_this());
+    }
+  }
+
+  void *data = std::aligned_alloc(kAlignment, capacity);
+  if (data == nullptr) {
+    throw std::bad_alloc();
+  }
+  return AlignedBuffer(static_cast<uint8_t *>(data), capacity,
+                       shared_from_this());
+}
+
+size_t AlignedBufferPool::cached_bytes() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return cached_bytes_;
+}
+
+void AlignedBufferPool::release(uint8_t *data, size_t capacity) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (cached_bytes_ + capacity <= max_cached_bytes_) {
+      free_lists_[capacity].push_back(data);
+      cached_bytes_ += capacity;
+      return;
+    }
+  }
+  std::free(data);
+}
+} // namespace toni_lsm
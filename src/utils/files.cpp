@@ -1,9 +1,11 @@
 #include "../../include/utils/files.h"
 #include <cstring>
+#include <fcntl.h>
 #include <stdexcept>
+#include <unistd.h>
 
 namespace toni_lsm {
-FileObj::FileObj() : m_file(std::make_unique<StdFile>()) {}
+FileObj::FileObj() : m_file(std::make_unique<PosixFile>()) {}
 
 FileObj::~FileObj() = default;
 
@@ -26,11 +28,22 @@ size_t FileObj::size() const { return m_file->size(); }
 
 void FileObj::set_size(size_t size) { m_size = size; }
 
+std::string FileObj::path() const { return m_file->filename(); }
+
+int FileObj::fd() const { return m_file->fd(); }
+
+std::shared_ptr<AlignedBufferPool> FileObj::direct_pool() const {
+  return m_file->direct_pool();
+}
+
 void FileObj::del_file() { m_file->remove(); }
-FileObj FileObj::create_and_write(const std::string &path,
-                                  std::vector<uint8_t> buf) {
+
+void FileObj::rename(const std::string &new_path) { m_file->rename(new_path); }
+FileObj
+FileObj::create_and_write(const std::string &path, std::vector<uint8_t> buf,
+                          std::shared_ptr<AlignedBufferPool> direct_pool) {
   FileObj file_obj;
-  if (!file_obj.m_file->create(path, buf)) {
+  if (!file_obj.m_file->create(path, buf, std::move(direct_pool))) {
     throw std::runtime_error("Failed to create or write file: " + path);
   }
 
@@ -40,17 +53,36 @@ FileObj FileObj::create_and_write(const std::string &path,
   return std::move(file_obj);
 }
 
-FileObj FileObj::open(const std::string &path, bool create) {
+bool FileObj::sync_dir(const std::string &dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+FileObj FileObj::open(const std::string &path, bool create,
+                      std::shared_ptr<AlignedBufferPool> direct_pool) {
   FileObj file_obj;
 
   // 打开文件
-  if (!file_obj.m_file->open(path, create)) {
+  if (!file_obj.m_file->open(path, create, std::move(direct_pool))) {
     throw std::runtime_error("Failed to open file: " + path);
   }
 
   return std::move(file_obj);
 }
 
+std::shared_ptr<MmapFile> FileObj::map_readonly() const {
+  auto mapped = std::make_shared<MmapFile>();
+  if (!mapped->map_readonly(m_file->fd(), m_file->size())) {
+    throw std::runtime_error("Failed to mmap file");
+  }
+  return mapped;
+}
+
 std::vector<uint8_t> FileObj::read_to_slice(size_t offset, size_t length) {
   // 检查边界
   if (offset + length > m_file->size()) {
@@ -69,11 +101,10 @@ uint8_t FileObj::read_uint8(size_t offset) {
     throw std::out_of_range("Read beyond file size");
   }
 
-  // 从w文件复制数据
-  auto result = m_file->read(offset, sizeof(uint8_t));
-
-  // 将数据转换为uint8_t
-  return result[0];
+  // 直接读取到栈上, 不分配临时缓冲区
+  uint8_t result;
+  m_file->read(offset, sizeof(uint8_t), &result);
+  return result;
 }
 
 uint16_t FileObj::read_uint16(size_t offset) {
@@ -81,8 +112,9 @@ uint16_t FileObj::read_uint16(size_t offset) {
   if (offset + sizeof(uint16_t) > m_file->size()) {
     throw std::out_of_range("Read beyond file size");
   }
-  auto result = m_file->read(offset, sizeof(uint16_t));
-  return *(uint16_t *)result.data();
+  uint16_t result;
+  m_file->read(offset, sizeof(uint16_t), &result);
+  return result;
 }
 
 uint32_t FileObj::read_uint32(size_t offset) {
@@ -90,12 +122,9 @@ uint32_t FileObj::read_uint32(size_t offset) {
   if (offset + sizeof(uint32_t) > m_file->size()) {
     throw std::out_of_range("Read beyond file size");
   }
-
-  // 从w文件复制数据
-  auto result = m_file->read(offset, sizeof(uint32_t));
-
-  // 将数据转换为uint32_t
-  return *(uint32_t *)result.data();
+  uint32_t result;
+  m_file->read(offset, sizeof(uint32_t), &result);
+  return result;
 }
 
 uint64_t FileObj::read_uint64(size_t offset) {
@@ -103,12 +132,9 @@ uint64_t FileObj::read_uint64(size_t offset) {
   if (offset + sizeof(uint64_t) > m_file->size()) {
     throw std::out_of_range("Read beyond file size");
   }
-
-  // 从w文件复制数据
-  auto result = m_file->read(offset, sizeof(uint64_t));
-
-  // 将数据转换为uint64_t
-  return *(uint64_t *)result.data();
+  uint64_t result;
+  m_file->read(offset, sizeof(uint64_t), &result);
+  return result;
 }
 
 // 写入到文件
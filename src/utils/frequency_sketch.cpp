@@ -0,0 +1,59 @@
+#include "../../include/utils/frequency_sketch.h"
+#include <algorithm>
+#include <bit>
+
+namespace toni_lsm {
+
+FrequencySketch::FrequencySketch(size_t expected_entries) {
+  // 每个预期元素分配一个 uint64_t, 即 16 个计数器, 降低不同 key 之间的冲突
+  expected_entries = std::max<size_t>(expected_entries, 64);
+  size_t num_words = std::bit_ceil(expected_entries);
+  table_.assign(num_words, 0);
+  counter_mask_ = num_words * kCountersPerWord - 1;
+  sample_size_ = 10 * expected_entries;
+}
+
+size_t FrequencySketch::index_of(uint64_t hash, int i) const {
+  // 每一行使用不同的种子重新混合, 各行之间的位置互不相关
+  uint64_t h = hash + (i + 1) * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 32;
+  h *= 0xd6e8feb86659fd93ULL;
+  h ^= h >> 32;
+  return h & counter_mask_;
+}
+
+uint32_t FrequencySketch::counter_at(size_t idx) const {
+  size_t shift = (idx % kCountersPerWord) * 4;
+  return (table_[idx / kCountersPerWord] >> shift) & 0xf;
+}
+
+void FrequencySketch::increment(uint64_t hash) {
+  bool added = false;
+  for (int i = 0; i < kDepth; i++) {
+    size_t idx = index_of(hash, i);
+    if (counter_at(idx) < kMaxCount) {
+      table_[idx / kCountersPerWord] += 1ULL << ((idx % kCountersPerWord) * 4);
+      added = true;
+    }
+  }
+  if (added && ++additions_ >= sample_size_) {
+    reset();
+  }
+}
+
+uint32_t FrequencySketch::estimate(uint64_t hash) const {
+  uint32_t count = kMaxCount;
+  for (int i = 0; i < kDepth; i++) {
+    count = std::min(count, counter_at(index_of(hash, i)));
+  }
+  return count;
+}
+
+void FrequencySketch::reset() {
+  // 每个 4 位计数器右移一位, 清除从相邻计数器移入的最高位
+  for (auto &word : table_) {
+    word = (word >> 1) & 0x7777777777777777ULL;
+  }
+  additions_ /= 2;
+}
+} // namespace toni_lsm
@@ -0,0 +1,220 @@
+#include "../../include/utils/io_uring.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace toni_lsm {
+
+namespace {
+int sys_io_uring_setup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+unsigned *ring_field(void *ring, uint32_t offset) {
+  return reinterpret_cast<unsigned *>(static_cast<uint8_t *>(ring) + offset);
+}
+
+// 从 req 已经读到的位置继续用 pread 读完
+void finish_with_pread(ReadRequest &req, size_t done) {
+  size_t need = req.required != 0 ? req.required : req.length;
+  while (done < need) {
+    ssize_t n = ::pread(req.fd, req.buf + done, req.length - done,
+                        req.offset + done);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      req.ok = false;
+      return;
+    }
+    done += n;
+  }
+  req.ok = true;
+}
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+  if (entries == 0) {
+    return;
+  }
+
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = sys_io_uring_setup(entries, &params);
+  if (ring_fd_ < 0) {
+    // 内核过旧或者被 seccomp 禁用
+    spdlog::warn("IoUring--"
+                 "io_uring_setup failed: {}, fall back to pread",
+                 strerror(errno));
+    ring_fd_ = -1;
+    return;
+  }
+  sq_entries_ = params.sq_entries;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+
+  sq_ptr_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ptr_ == MAP_FAILED) {
+    sq_ptr_ = nullptr;
+    close();
+    return;
+  }
+  if (single_mmap) {
+    cq_ptr_ = sq_ptr_;
+  } else {
+    cq_ptr_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+      cq_ptr_ = nullptr;
+      close();
+      return;
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    sqes_ = nullptr;
+    close();
+    return;
+  }
+
+  sq_head_ = ring_field(sq_ptr_, params.sq_off.head);
+  sq_tail_ = ring_field(sq_ptr_, params.sq_off.tail);
+  sq_mask_ = ring_field(sq_ptr_, params.sq_off.ring_mask);
+  sq_array_ = ring_field(sq_ptr_, params.sq_off.array);
+  cq_head_ = ring_field(cq_ptr_, params.cq_off.head);
+  cq_tail_ = ring_field(cq_ptr_, params.cq_off.tail);
+  cq_mask_ = ring_field(cq_ptr_, params.cq_off.ring_mask);
+  cqes_ = static_cast<uint8_t *>(cq_ptr_) + params.cq_off.cqes;
+}
+
+IoUring::~IoUring() { close(); }
+
+void IoUring::close() {
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+    munmap(cq_ptr_, cq_ring_size_);
+  }
+  cq_ptr_ = nullptr;
+  if (sq_ptr_ != nullptr) {
+    munmap(sq_ptr_, sq_ring_size_);
+    sq_ptr_ = nullptr;
+  }
+  if (ring_fd_ != -1) {
+    ::close(ring_fd_);
+    ring_fd_ = -1;
+  }
+}
+
+void IoUring::read_batch(std::vector<ReadRequest> &reqs) {
+  if (!available()) {
+    for (auto &req : reqs) {
+      finish_with_pread(req, 0);
+    }
+    return;
+  }
+  for (size_t start = 0; start < reqs.size(); start += sq_entries_) {
+    size_t count = std::min<size_t>(sq_entries_, reqs.size() - start);
+    submit_and_wait(reqs.data() + start, count);
+  }
+}
+
+void IoUring::submit_and_wait(ReadRequest *reqs, size_t count) {
+  // 只有当前线程写入提交队列的 tail
+  auto *sqes = static_cast<io_uring_sqe *>(sqes_);
+  unsigned tail = *sq_tail_;
+  unsigned mask = *sq_mask_;
+  for (size_t i = 0; i < count; i++) {
+    unsigned idx = tail & mask;
+    io_uring_sqe *sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = reqs[i].fd;
+    sqe->addr = reinterpret_cast<uint64_t>(reqs[i].buf);
+    sqe->len = static_cast<uint32_t>(reqs[i].length);
+    sqe->off = reqs[i].offset;
+    sqe->user_data = i;
+    sq_array_[idx] = idx;
+    tail++;
+  }
+  // 内核在看到新的 tail 之前必须能看到写好的 sqe
+  __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+  size_t to_submit = count;
+  while (to_submit > 0) {
+    int ret = sys_io_uring_enter(ring_fd_, to_submit, 0, 0);
+    if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      // 无法继续提交, 撤回还没有被内核取走的请求, 之后全部用 pread 读取
+      spdlog::error("IoUring--"
+                    "io_uring_enter failed: {}",
+                    strerror(errno));
+      break;
+    }
+    to_submit -= ret;
+  }
+  if (to_submit > 0) {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+  }
+  size_t submitted = count - to_submit;
+
+  // 收割完成事件, 短读和失败的请求用 pread 补齐
+  std::vector<bool> completed(count, false);
+  auto *cqes = static_cast<io_uring_cqe *>(cqes_);
+  size_t done = 0;
+  while (done < submitted) {
+    unsigned head = *cq_head_;
+    unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == cq_tail) {
+      int ret = sys_io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+      if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        // 已经提交的请求仍然会完成, 只能继续等待, 避免内核写入已释放的缓冲区
+        spdlog::error("IoUring--"
+                      "io_uring_enter wait failed: {}",
+                      strerror(errno));
+      }
+      continue;
+    }
+    while (head != cq_tail) {
+      io_uring_cqe *cqe = &cqes[head & *cq_mask_];
+      auto &req = reqs[cqe->user_data];
+      completed[cqe->user_data] = true;
+      finish_with_pread(req, cqe->res > 0 ? cqe->res : 0);
+      head++;
+      done++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (!completed[i]) {
+      finish_with_pread(reqs[i], 0);
+    }
+  }
+}
+} // namespace toni_lsm
@@ -43,6 +43,20 @@ bool MmapFile::open(const std::string &filename, bool create) {
   return true;
 }
 
+bool MmapFile::map_readonly(int fd, size_t size) {
+  close();
+  if (size == 0) {
+    return true;
+  }
+  mapped_data_ = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped_data_ == MAP_FAILED) {
+    mapped_data_ = nullptr;
+    return false;
+  }
+  file_size_ = size;
+  return true;
+}
+
 bool MmapFile::create(const std::string &filename, std::vector<uint8_t> &buf) {
   // 创建文件，设置大小并映射到内存
   if (!create_and_map(filename, buf.size())) {
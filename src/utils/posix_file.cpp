@@ -0,0 +1,212 @@
+#include "../../include/utils/posix_file.h"
+#include "spdlog/spdlog.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace toni_lsm {
+
+bool PosixFile::open(const std::string &filename, bool create,
+                     std::shared_ptr<AlignedBufferPool> direct_pool) {
+  close();
+  {
+    std::lock_guard<std::mutex> lock(filename_mtx_);
+    filename_ = filename;
+  }
+
+  int flags = O_RDWR | O_CLOEXEC;
+  if (create) {
+    flags |= O_CREAT | O_TRUNC;
+  }
+  if (direct_pool != nullptr) {
+    fd_ = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ != -1) {
+      direct_pool_ = std::move(direct_pool);
+    } else if (errno == EINVAL) {
+      // 文件系统不支持 O_DIRECT, 例如 tmpfs
+      spdlog::warn("PosixFile--"
+                   "O_DIRECT is not supported for {}, use buffered io",
+                   filename);
+    }
+  }
+  if (fd_ == -1) {
+    fd_ = ::open(filename.c_str(), flags, 0644);
+  }
+  if (fd_ == -1) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd_, &st) == -1) {
+    close();
+    return false;
+  }
+  size_ = st.st_size;
+  return true;
+}
+
+bool PosixFile::create(const std::string &filename, std::vector<uint8_t> &buf,
+                       std::shared_ptr<AlignedBufferPool> direct_pool) {
+  if (!this->open(filename, true, std::move(direct_pool))) {
+    throw std::runtime_error("Failed to open file for writing");
+  }
+  if (!buf.empty()) {
+    return write(0, buf.data(), buf.size());
+  }
+  return true;
+}
+
+void PosixFile::close() {
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  size_ = 0;
+  direct_pool_ = nullptr;
+}
+
+size_t PosixFile::size() { return size_.load(std::memory_order_acquire); }
+
+std::string PosixFile::filename() {
+  std::lock_guard<std::mutex> lock(filename_mtx_);
+  return filename_;
+}
+
+bool PosixFile::write(size_t offset, const void *data, size_t size) {
+  if (direct_pool_ != nullptr) {
+    return direct_write(offset, data, size);
+  }
+  auto ptr = static_cast<const uint8_t *>(data);
+  size_t written = 0;
+  while (written < size) {
+    ssize_t n = ::pwrite(fd_, ptr + written, size - written, offset + written);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += n;
+  }
+
+  // 只会增大, 并发写入不同区域时取最大值
+  size_t end = offset + size;
+  size_t cur = size_.load(std::memory_order_relaxed);
+  while (end > cur && !size_.compare_exchange_weak(cur, end,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+  }
+  return true;
+}
+
+std::vector<uint8_t> PosixFile::read(size_t offset, size_t length) {
+  std::vector<uint8_t> buf(length);
+  read(offset, length, buf.data());
+  return buf;
+}
+
+void PosixFile::read(size_t offset, size_t length, void *buf) {
+  if (direct_pool_ != nullptr) {
+    direct_read(offset, length, buf);
+    return;
+  }
+  auto ptr = static_cast<uint8_t *>(buf);
+  size_t done = 0;
+  while (done < length) {
+    ssize_t n = ::pread(fd_, ptr + done, length - done, offset + done);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw std::runtime_error("Failed to read from file");
+    }
+    done += n;
+  }
+}
+
+void PosixFile::direct_read(size_t offset, size_t length, void *buf) {
+  if (length == 0) {
+    return;
+  }
+  // 读取覆盖 [offset, offset + length) 的对齐区间, 再复制需要的部分
+  size_t aligned_offset = AlignedBufferPool::align_down(offset);
+  size_t aligned_length =
+      AlignedBufferPool::align_up(offset + length) - aligned_offset;
+  size_t need = offset + length - aligned_offset;
+  auto bounce = direct_pool_->acquire(aligned_length);
+
+  size_t done = 0;
+  while (done < need) {
+    // 只有读到文件末尾时才会短读, 因此 done 总是对齐的
+    ssize_t n = ::pread(fd_, bounce.data() + done, aligned_length - done,
+                        aligned_offset + done);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw std::runtime_error("Failed to read from file");
+    }
+    done += n;
+  }
+  memcpy(buf, bounce.data() + (offset - aligned_offset), length);
+}
+
+bool PosixFile::direct_write(size_t offset, const void *data, size_t size) {
+  size_t aligned_size = AlignedBufferPool::align_up(size);
+  // 补齐的零不能覆盖已有的数据, 因此未对齐的写入只能位于文件末尾
+  if (offset != AlignedBufferPool::align_down(offset) ||
+      (aligned_size != size && offset + size < this->size())) {
+    return false;
+  }
+  auto bounce = direct_pool_->acquire(aligned_size);
+  memcpy(bounce.data(), data, size);
+  memset(bounce.data() + size, 0, aligned_size - size);
+
+  size_t written = 0;
+  while (written < aligned_size) {
+    ssize_t n = ::pwrite(fd_, bounce.data() + written, aligned_size - written,
+                         offset + written);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += n;
+  }
+  // 去掉补齐用的零
+  size_t end = offset + size;
+  if (aligned_size != size && ::ftruncate(fd_, end) == -1) {
+    return false;
+  }
+
+  size_t cur = size_.load(std::memory_order_relaxed);
+  while (end > cur && !size_.compare_exchange_weak(cur, end,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+  }
+  return true;
+}
+
+bool PosixFile::sync() {
+  if (fd_ == -1) {
+    return false;
+  }
+  return ::fdatasync(fd_) == 0;
+}
+
+bool PosixFile::remove() {
+  std::lock_guard<std::mutex> lock(filename_mtx_);
+  return ::unlink(filename_.c_str()) == 0;
+}
+
+void PosixFile::rename(const std::string &new_filename) {
+  std::lock_guard<std::mutex> lock(filename_mtx_);
+  std::filesystem::rename(filename_, new_filename);
+  filename_ = new_filename;
+}
+} // namespace toni_lsm
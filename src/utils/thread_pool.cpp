@@ -0,0 +1,51 @@
+#include "../../include/utils/thread_pool.h"
+
+namespace toni_lsm {
+
+ThreadPool::ThreadPool(size_t thread_num) {
+  if (thread_num == 0) {
+    thread_num = 1;
+  }
+  workers_.reserve(thread_num);
+  for (size_t i = 0; i < thread_num; i++) {
+    workers_.emplace_back(&ThreadPool::worker_loop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() { shutdown(); }
+
+void ThreadPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (stop_) {
+      return;
+    }
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+size_t ThreadPool::thread_num() const { return workers_.size(); }
+
+void ThreadPool::worker_loop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      // 停止后仍然要把队列中剩余的任务执行完
+      if (stop_ && tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+} // namespace toni_lsm
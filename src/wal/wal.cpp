@@ -1,8 +1,10 @@
 // src/wal/wal.cpp
 
 #include "../../include/wal/wal.h"
+#include "spdlog/spdlog.h"
 #include <algorithm>
 #include <cstdint>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -130,7 +132,12 @@ void WAL::cleaner() {
       if (stop_cleaner_) {
         break;
       }
-      cleanWALFile();
+      try {
+        cleanWALFile();
+      } catch (const std::exception &e) {
+        // 清理失败不影响正常写入, 下一轮再尝试
+        spdlog::error("WAL--cleaner: cleanWALFile failed: {}", e.what());
+      }
     }
   }
 }
@@ -173,7 +180,8 @@ void WAL::cleanWALFile() {
 
   // 判断是否可以删除
   std::vector<FileObj> del_paths;
-  for (int idx = 0; idx < wal_paths.size() - 1; idx++) {
+  // 最后一个文件正在写入, 不能删除
+  for (size_t idx = 0; idx + 1 < wal_paths.size(); idx++) {
     auto cur_path = wal_paths[idx].second;
     auto cur_file = FileObj::open(cur_path, false);
     // 遍历文件记录, 读取所有的tranc_id,
@@ -187,6 +195,10 @@ void WAL::cleanWALFile() {
         has_unfinished = true;
         break;
       }
+      if (record_size == 0) {
+        break;
+      }
+      offset += record_size;
     }
     if (!has_unfinished) {
       del_paths.push_back(std::move(cur_file));
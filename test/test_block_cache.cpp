@@ -1,8 +1,12 @@
 #include "../include/block/block.h"
 #include "../include/block/block_cache.h"
+#include "../include/block/secondary_cache.h"
 #include "../include/logger/logger.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <filesystem>
 #include <memory>
+#include <thread>
 #include <vector>
 
 using namespace ::toni_lsm;
@@ -10,8 +14,9 @@ using namespace ::toni_lsm;
 class BlockCacheTest : public ::testing::Test {
 protected:
   void SetUp() override {
-    // 初始化缓存池，容量为3，K值为2
-    cache = std::make_unique<BlockCache>(3, 2);
+    // 初始化缓存池，容量为3个空 block，K值为2
+    cache = std::make_unique<BlockCache>(
+        3 * BlockCache::entry_charge(std::make_shared<Block>()), 2);
   }
 
   std::unique_ptr<BlockCache> cache;
@@ -95,6 +100,241 @@ TEST_F(BlockCacheTest, HitRate) {
   EXPECT_EQ(cache->hit_rate(), 2.0 / 3.0);
 }
 
+TEST_F(BlockCacheTest, HotKeys) {
+  cache->put(1, 1, std::make_shared<Block>());
+  cache->put(1, 2, std::make_shared<Block>());
+  cache->put(1, 3, std::make_shared<Block>());
+  // 访问次数达到 K 的缓存项排在前面, contains 不计入访问次数
+  cache->get(1, 2);
+  EXPECT_TRUE(cache->contains(1, 3));
+  EXPECT_FALSE(cache->contains(1, 4));
+
+  auto keys = cache->hot_keys(2);
+  ASSERT_EQ(keys.size(), 2);
+  EXPECT_EQ(keys[0], std::make_pair(1, 2));
+  EXPECT_EQ(cache->hot_keys(10).size(), 3);
+  EXPECT_EQ(cache->hit_rate(), 1.0);
+}
+
+TEST(ShardedBlockCacheTest, ConcurrentGetAndPut) {
+  // 容量太小时减少分片数
+  EXPECT_EQ(BlockCache(3, 2, 4).num_shards(), 1);
+  EXPECT_EQ(BlockCache(4 * BlockCache::kMinShardCapacity, 2, 4).num_shards(),
+            4);
+
+  BlockCache sharded(16 * BlockCache::kMinShardCapacity, 2, 4);
+  EXPECT_EQ(sharded.num_shards(), 16);
+
+  std::vector<std::shared_ptr<Block>> blocks;
+  for (int i = 0; i < 512; i++) {
+    blocks.push_back(std::make_shared<Block>());
+    sharded.put(i % 8, i / 8, blocks.back());
+  }
+
+  // 多个线程同时读取命中的 block, 同时有线程写入新的 block,
+  // 所有 block 都能放进各自的分片, 读取不会失败
+  std::vector<std::thread> readers;
+  std::atomic<int> misses{0};
+  for (int t = 0; t < 8; t++) {
+    readers.emplace_back([&, t]() {
+      for (int round = 0; round < 100; round++) {
+        for (int i = t; i < 512; i += 8) {
+          if (sharded.get(i % 8, i / 8) != blocks[i]) {
+            misses++;
+          }
+        }
+      }
+    });
+  }
+  std::thread writer([&]() {
+    for (int i = 0; i < 128; i++) {
+      sharded.put(100, i, std::make_shared<Block>());
+    }
+  });
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  writer.join();
+  EXPECT_EQ(misses, 0);
+}
+
+// 按字节计算容量, 大 block 占用更多容量
+TEST(ByteCapacityBlockCacheTest, EvictByBytes) {
+  auto big = std::make_shared<Block>(64 * 1024);
+  while (big->add_entry("key" + std::to_string(big->size()),
+                        std::string(1000, 'v'), 0, false)) {
+  }
+  auto small = std::make_shared<Block>();
+  size_t big_charge = BlockCache::entry_charge(big);
+  size_t small_charge = BlockCache::entry_charge(small);
+  EXPECT_GT(big_charge, 64 * 1024);
+
+  BlockCache cache(3 * big_charge, 2);
+  EXPECT_EQ(cache.capacity(), 3 * big_charge);
+  cache.put(1, 0, small);
+  cache.put(1, 1, big);
+  EXPECT_EQ(cache.usage(), big_charge + small_charge);
+
+  // 再放入 3 个大 block 之后超出容量, 淘汰最久未访问的小 block 和第一个大 block
+  for (int i = 2; i <= 4; i++) {
+    cache.put(1, i, big);
+  }
+  EXPECT_EQ(cache.get(1, 0), nullptr);
+  EXPECT_EQ(cache.get(1, 1), nullptr);
+  EXPECT_EQ(cache.get(1, 4), big);
+  EXPECT_EQ(cache.usage(), 3 * big_charge);
+
+  // 超过整个缓存容量的 block 不会被缓存
+  BlockCache tiny(big_charge / 2, 2);
+  tiny.put(1, 0, big);
+  EXPECT_EQ(tiny.get(1, 0), nullptr);
+  EXPECT_EQ(tiny.usage(), 0);
+
+  // 分片之后占用仍然不超过总容量
+  BlockCache sharded(16 * BlockCache::kMinShardCapacity, 2, 4);
+  for (int i = 0; i < 4096; i++) {
+    sharded.put(200, i, big);
+  }
+  EXPECT_LE(sharded.usage(), sharded.capacity());
+  EXPECT_GT(sharded.usage(), sharded.capacity() / 2);
+}
+
+// 模拟一次性扫描: 热点 block 反复访问之后, 大量只访问一次的 block 读入缓存
+static int hot_blocks_after_scan(BlockCache &cache) {
+  auto read = [&cache](int sst_id, int block_id) {
+    if (cache.get(sst_id, block_id) == nullptr) {
+      cache.put(sst_id, block_id, std::make_shared<Block>());
+    }
+  };
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < 8; i++) {
+      read(1, i);
+    }
+  }
+  for (int i = 0; i < 200; i++) {
+    read(2, i);
+  }
+  int hot = 0;
+  for (int i = 0; i < 8; i++) {
+    hot += cache.get(1, i) != nullptr;
+  }
+  return hot;
+}
+
+TEST(TinyLfuBlockCacheTest, ScanResistance) {
+  size_t capacity = 16 * BlockCache::entry_charge(std::make_shared<Block>());
+  // 只用 LRU-K 时扫描的 block 不断挤占 cache_list_less_k,
+  // 扫描足够长时热点 block 也会被淘汰
+  BlockCache lru(capacity, 8);
+  EXPECT_LT(hot_blocks_after_scan(lru), 8);
+
+  BlockCache tiny_lfu(capacity, 8, 0, true);
+  EXPECT_EQ(hot_blocks_after_scan(tiny_lfu), 8);
+
+  // 新的热点 block 被多次访问之后仍然可以进入缓存
+  for (int round = 0; round < 10; round++) {
+    if (tiny_lfu.get(3, 0) == nullptr) {
+      tiny_lfu.put(3, 0, std::make_shared<Block>());
+    }
+  }
+  EXPECT_NE(tiny_lfu.get(3, 0), nullptr);
+}
+
+static std::shared_ptr<Block> make_block(int i) {
+  auto block = std::make_shared<Block>(4096);
+  block->add_entry("key" + std::to_string(i), std::string(100, 'v'), 0,
+                   false);
+  return block;
+}
+
+constexpr uint64_t kFileId = 42;
+
+TEST(SecondaryCacheTest, WrapAroundAndRecover) {
+  std::string path = "secondary_cache_test";
+  std::filesystem::remove(path);
+  // 每条记录占用一个对齐单元, 文件只能容纳 8 条
+  size_t capacity = 8 * SecondaryCache::kAlignment;
+  {
+    SecondaryCache cache(path, capacity);
+    for (int i = 0; i < 20; i++) {
+      cache.insert(1, i, kFileId, make_block(i));
+    }
+    cache.wait_for_pending();
+    EXPECT_EQ(cache.entries(), 8);
+    EXPECT_EQ(cache.usage(), capacity);
+    // 最旧的记录已经被覆盖
+    EXPECT_EQ(cache.lookup(1, 0, kFileId), nullptr);
+    for (int i = 12; i < 20; i++) {
+      auto block = cache.lookup(1, i, kFileId);
+      ASSERT_NE(block, nullptr);
+      EXPECT_EQ(block->get_first_key(), "key" + std::to_string(i));
+    }
+    EXPECT_DOUBLE_EQ(cache.hit_rate(), 8.0 / 9);
+  }
+  {
+    // 重启之后从文件中恢复索引, 新记录接在序号最大的记录之后写入
+    SecondaryCache cache(path, capacity);
+    EXPECT_EQ(cache.entries(), 8);
+    cache.insert(1, 20, kFileId, make_block(20));
+    cache.wait_for_pending();
+    EXPECT_EQ(cache.lookup(1, 12, kFileId), nullptr);
+    EXPECT_NE(cache.lookup(1, 13, kFileId), nullptr);
+    EXPECT_EQ(cache.lookup(1, 20, kFileId)->get_first_key(), "key20");
+
+    cache.clear();
+    EXPECT_EQ(cache.entries(), 0);
+    EXPECT_EQ(cache.lookup(1, 20, kFileId), nullptr);
+  }
+  {
+    SecondaryCache cache(path, capacity);
+    EXPECT_EQ(cache.entries(), 0);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(SecondaryCacheTest, SpillEvictedBlocks) {
+  std::string path = "secondary_cache_spill";
+  std::filesystem::remove(path);
+  auto secondary = std::make_shared<SecondaryCache>(path, 1 << 20);
+  BlockCache cache(2 * BlockCache::entry_charge(make_block(0)), 2);
+  cache.set_secondary_cache(secondary);
+
+  for (int i = 0; i < 5; i++) {
+    cache.put(1, i, make_block(i), kFileId);
+  }
+  // 没有文件身份的 block 无法校验, 被淘汰时不写入二级缓存
+  for (int i = 0; i < 4; i++) {
+    cache.put(2, i, make_block(i));
+  }
+  // 只有被淘汰的 block 由后台线程写入二级缓存
+  EXPECT_EQ(cache.get(1, 0), nullptr);
+  secondary->wait_for_pending();
+  EXPECT_EQ(secondary->entries(), 5);
+  EXPECT_EQ(secondary->lookup(1, 0, kFileId)->get_first_key(), "key0");
+  EXPECT_NE(secondary->lookup(1, 4, kFileId), nullptr);
+  EXPECT_EQ(secondary->lookup(2, 0, kFileId), nullptr);
+  std::filesystem::remove(path);
+}
+
+TEST(SecondaryCacheTest, RejectOtherFile) {
+  std::string path = "secondary_cache_file_id";
+  std::filesystem::remove(path);
+  {
+    SecondaryCache cache(path, 1 << 20);
+    cache.insert(1, 0, kFileId, make_block(0));
+    cache.wait_for_pending();
+  }
+  {
+    // 重启之后 sst_id 被另一个文件复用, 旧文件的 block 不能被读到
+    SecondaryCache cache(path, 1 << 20);
+    EXPECT_EQ(cache.entries(), 1);
+    EXPECT_EQ(cache.lookup(1, 0, kFileId + 1), nullptr);
+    EXPECT_EQ(cache.entries(), 0);
+    EXPECT_EQ(cache.lookup(1, 0, kFileId), nullptr);
+  }
+  std::filesystem::remove(path);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();
@@ -1,3 +1,4 @@
+#include "../include/block/block_index.h"
 #include "../include/block/blockmeta.h"
 #include "../include/logger/logger.h"
 #include <gtest/gtest.h>
@@ -166,6 +167,52 @@ TEST_F(BlockMetaTest, OrderTest) {
   }
 }
 
+TEST_F(BlockMetaTest, BlockIndexFind) {
+  BlockIndex index(createTestMetas());
+  ASSERT_EQ(index.size(), 3);
+  EXPECT_EQ(index.first_key(), "a100");
+  EXPECT_EQ(index.last_key(), "a399");
+  EXPECT_EQ(index.offset(1), 100);
+
+  // 返回唯一可能包含 key 的 block
+  EXPECT_EQ(index.find("a"), 0);
+  EXPECT_EQ(index.find("a150"), 0);
+  EXPECT_EQ(index.find("a199"), 0);
+  EXPECT_EQ(index.find("a1999"), 1);
+  EXPECT_EQ(index.find("a399"), 2);
+  EXPECT_EQ(index.find("a4"), 3);
+  EXPECT_TRUE(BlockIndex().empty());
+}
+
+TEST_F(BlockMetaTest, BlockIndexSeparator) {
+  EXPECT_EQ(BlockIndex::shortest_separator("abc", "abx"), "abd");
+  EXPECT_EQ(BlockIndex::shortest_separator("abc123", "abx"), "abd");
+  // 无法缩短时保留 last_key
+  EXPECT_EQ(BlockIndex::shortest_separator("key0999", "key1000"), "key0999");
+  EXPECT_EQ(BlockIndex::shortest_separator("ab", "abc"), "ab");
+  std::string high = "a\xff";
+  EXPECT_EQ(BlockIndex::shortest_separator(high + "1", high + "9"), high + "2");
+  EXPECT_EQ(BlockIndex::shortest_separator(high, "b"), high);
+
+  // 相邻 block 的 key 相差较大时, 分隔 key 只需要一个字节
+  std::vector<BlockMeta> metas;
+  size_t key_bytes = 0;
+  for (int i = 0; i < 13; i++) {
+    std::string prefix(1, static_cast<char>('a' + 2 * i));
+    metas.emplace_back(i * 4096, prefix + std::string(64, '0'),
+                       prefix + std::string(64, '9'));
+    key_bytes += metas.back().first_key.size() + metas.back().last_key.size();
+  }
+  BlockIndex index(metas);
+  for (size_t i = 0; i + 1 < metas.size(); i++) {
+    EXPECT_EQ(index.separator(i), std::string(1, 'b' + 2 * i));
+    EXPECT_EQ(index.find(metas[i].first_key), i);
+    EXPECT_EQ(index.find(metas[i].last_key), i);
+  }
+  EXPECT_EQ(index.last_key(), metas.back().last_key);
+  EXPECT_LT(index.memory_usage(), key_bytes);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();
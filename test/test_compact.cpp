@@ -1,3 +1,4 @@
+#include "../include/config/config.h"
 #include "../include/consts.h"
 #include "../include/logger/logger.h"
 #include "../include/lsm/engine.h"
@@ -5,6 +6,10 @@
 #include <filesystem>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <numeric>
+#include <random>
+#include <set>
+#include <thread>
 
 using namespace ::toni_lsm;
 
@@ -78,6 +83,368 @@ TEST_F(CompactTest, Persistence) {
   EXPECT_FALSE(lsm.get("nonexistent").has_value());
 }
 
+TEST_F(CompactTest, BackgroundCompaction) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  int num = 100000;
+  std::atomic<int> written = 0;
+  std::atomic<bool> done = false;
+  std::atomic<int> read_errors = 0;
+
+  // 写入与后台的刷盘/compact 并发时, 已写入的数据一直可见
+  std::thread reader([&] {
+    while (!done) {
+      int n = written.load();
+      for (int i = 0; i < n; i += 997) {
+        auto res = engine.get("key" + std::to_string(i), 0);
+        if (!res.has_value() || res->first != value + std::to_string(i)) {
+          read_errors++;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  });
+
+  for (int i = 0; i < num; i++) {
+    engine.put("key" + std::to_string(i), value + std::to_string(i), 1);
+    written = i + 1;
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+  done = true;
+  reader.join();
+  EXPECT_EQ(read_errors.load(), 0);
+
+  {
+    std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+    // l0 已经被后台线程 compact 到下层
+    EXPECT_LT(engine.level_sst_ids[0].size(),
+              TomlConfig::getInstance().getLsmSstLevelRatio());
+    EXPECT_GE(engine.cur_max_level, 1);
+  }
+
+  for (int i = 0; i < num; i += 7) {
+    auto res = engine.get("key" + std::to_string(i), 0);
+    ASSERT_TRUE(res.has_value()) << i;
+    EXPECT_EQ(res->first, value + std::to_string(i));
+  }
+}
+
+TEST_F(CompactTest, PartialCompaction) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  int num = 120000;
+  std::unordered_map<std::string, std::string> kvs;
+
+  // 乱序写入并覆盖/删除一部分 key, 让各层 sst 的 key 范围相互交错
+  std::mt19937 gen(42);
+  std::vector<int> order(num);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), gen);
+  for (int round = 0; round < 2; round++) {
+    for (int i : order) {
+      std::string key = "key" + std::to_string(i);
+      if (round == 1 && i % 3 == 0) {
+        engine.remove(key, 0);
+        kvs.erase(key);
+        continue;
+      }
+      if (round == 1 && i % 3 == 1) {
+        continue;
+      }
+      std::string val = value + std::to_string(round);
+      engine.put(key, val, 0);
+      kvs[key] = val;
+    }
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+
+  {
+    std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+    EXPECT_GE(engine.cur_max_level, 2);
+    // l0 以外的 level 按照 key 有序且互不重叠
+    for (auto &[level, sst_ids] : engine.level_sst_ids) {
+      if (level == 0) {
+        continue;
+      }
+      for (size_t i = 1; i < sst_ids.size(); i++) {
+        EXPECT_LT(engine.ssts[sst_ids[i - 1]]->get_last_key(),
+                  engine.ssts[sst_ids[i]]->get_first_key());
+      }
+    }
+  }
+
+  for (int i = 0; i < num; i += 7) {
+    std::string key = "key" + std::to_string(i);
+    auto res = engine.get(key, 0);
+    if (kvs.count(key)) {
+      ASSERT_TRUE(res.has_value()) << key;
+      EXPECT_EQ(res->first, kvs[key]);
+    } else {
+      EXPECT_FALSE(res.has_value()) << key;
+    }
+  }
+}
+
+TEST_F(CompactTest, SubCompaction) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  int num = 60000;
+  std::unordered_map<std::string, std::string> kvs;
+
+  // 乱序写入多轮, l1 与 l0 的 key 范围完全重叠, l0 的 compact 输入
+  // 超过多个 l1 sst 的大小, 会被切分为多个子区间并行执行
+  std::mt19937 gen(7);
+  std::vector<int> order(num);
+  std::iota(order.begin(), order.end(), 0);
+  for (int round = 0; round < 4; round++) {
+    std::shuffle(order.begin(), order.end(), gen);
+    for (int i : order) {
+      std::string key = "key" + std::to_string(i);
+      if (round == 3 && i % 5 == 0) {
+        engine.remove(key, 0);
+        kvs.erase(key);
+        continue;
+      }
+      std::string val = value + std::to_string(round);
+      engine.put(key, val, 0);
+      kvs[key] = val;
+    }
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+
+  {
+    std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+    // 各子区间的输出拼接后仍然按照 key 有序且互不重叠
+    for (auto &[level, sst_ids] : engine.level_sst_ids) {
+      if (level == 0) {
+        continue;
+      }
+      for (size_t i = 1; i < sst_ids.size(); i++) {
+        EXPECT_LT(engine.ssts[sst_ids[i - 1]]->get_last_key(),
+                  engine.ssts[sst_ids[i]]->get_first_key());
+      }
+    }
+  }
+
+  for (int i = 0; i < num; i += 3) {
+    std::string key = "key" + std::to_string(i);
+    auto res = engine.get(key, 0);
+    if (kvs.count(key)) {
+      ASSERT_TRUE(res.has_value()) << key;
+      EXPECT_EQ(res->first, kvs[key]);
+    } else {
+      EXPECT_FALSE(res.has_value()) << key;
+    }
+  }
+}
+
+TEST_F(CompactTest, TrivialMove) {
+  std::string value(1024, 'v');
+  int num = 120000;
+  {
+    LSMEngine engine(test_dir);
+    // 顺序写入, 各个 sst 的 key 范围互不重叠
+    for (int i = 0; i < num; i++) {
+      std::ostringstream oss_key;
+      oss_key << "key" << std::setw(6) << std::setfill('0') << i;
+      engine.put(oss_key.str(), value + std::to_string(i), 0);
+    }
+    while (engine.memtable.get_total_size() > 0) {
+      engine.flush();
+    }
+    engine.wait_for_compaction();
+
+    std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+    EXPECT_GE(engine.cur_max_level, 2);
+    // 所有 compact 都是 trivial move, 没有删除任何刷盘生成的 sst,
+    // 因此 sst id 是连续的
+    size_t min_id = SIZE_MAX, max_id = 0;
+    for (auto &[sst_id, sst] : engine.ssts) {
+      min_id = std::min(min_id, sst_id);
+      max_id = std::max(max_id, sst_id);
+    }
+    EXPECT_EQ(max_id - min_id + 1, engine.ssts.size());
+    for (auto &[level, sst_ids] : engine.level_sst_ids) {
+      for (auto &sst_id : sst_ids) {
+        EXPECT_TRUE(
+            std::filesystem::exists(engine.get_sst_path(sst_id, level)));
+      }
+    }
+  }
+
+  // 重启后按照文件名中的 level 加载
+  LSMEngine engine(test_dir);
+  for (int i = 0; i < num; i += 7) {
+    std::ostringstream oss_key;
+    oss_key << "key" << std::setw(6) << std::setfill('0') << i;
+    auto res = engine.get(oss_key.str(), 0);
+    ASSERT_TRUE(res.has_value()) << oss_key.str();
+    EXPECT_EQ(res->first, value + std::to_string(i));
+  }
+}
+
+TEST_F(CompactTest, CompactIteratorMergeOrder) {
+  auto block_cache = std::make_shared<BlockCache>(
+      TomlConfig::getInstance().getLsmBlockCacheCapacity(),
+      TomlConfig::getInstance().getLsmBlockCacheK());
+  size_t sst_id = 0;
+  auto build = [&](const std::vector<std::tuple<std::string, std::string,
+                                                uint64_t>> &entries) {
+    SSTBuilder builder(256, true);
+    for (auto &[key, value, tranc_id] : entries) {
+      builder.add(key, value, tranc_id);
+    }
+    sst_id++;
+    return builder.build(
+        sst_id, test_dir + "/sst_" + std::to_string(sst_id), block_cache);
+  };
+
+  // 新的 run 中有更新的版本、删除标记以及与旧 run 重复的版本
+  auto newer = build({{"a", "a3", 3}, {"b", "", 4}, {"c", "c-new", 1}});
+  std::vector<std::tuple<std::string, std::string, uint64_t>> old_entries;
+  for (int i = 0; i < 100; i++) {
+    old_entries.push_back({"k" + std::to_string(100 + i), "old", 1});
+  }
+  auto old1 = build({{"a", "a2", 2}, {"a", "a1", 1}, {"c", "c-old", 1}});
+  auto old2 = build(old_entries);
+
+  std::vector<std::tuple<std::string, std::string, uint64_t>> res;
+  for (CompactIterator it({{newer}, {old1, old2}}); it.is_valid(); ++it) {
+    res.push_back({it->key, it->value, it->tranc_id});
+  }
+  ASSERT_EQ(res.size(), 106);
+  EXPECT_EQ(res[0], std::make_tuple("a", "a3", 3));
+  EXPECT_EQ(res[1], std::make_tuple("a", "a2", 2));
+  EXPECT_EQ(res[2], std::make_tuple("a", "a1", 1));
+  EXPECT_EQ(res[3], std::make_tuple("b", "", 4));
+  // tranc_id 相同时新的 run 在前
+  EXPECT_EQ(res[4], std::make_tuple("c", "c-new", 1));
+  EXPECT_EQ(res[5], std::make_tuple("c", "c-old", 1));
+  EXPECT_EQ(std::get<0>(res[6]), "k100");
+
+  // 按照 [start_key, end_key) 截取
+  std::vector<std::string> keys;
+  for (CompactIterator it({{newer}, {old1, old2}}, "b", "k150"); it.is_valid();
+       ++it) {
+    keys.push_back(it->key);
+  }
+  ASSERT_EQ(keys.size(), 53);
+  EXPECT_EQ(keys.front(), "b");
+  EXPECT_EQ(keys.back(), "k149");
+}
+
+TEST_F(CompactTest, BottommostDropsTombstones) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  // 数据量只够 compact 到 l1, l1 就是最底层
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+
+  std::mt19937 gen(3);
+  std::vector<int> order(num);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), gen);
+  for (int i : order) {
+    engine.put("key" + std::to_string(i), value, 1);
+  }
+  for (int i = 0; i < num; i += 2) {
+    engine.remove("key" + std::to_string(i), 2);
+  }
+  // 删除之后的写入足以再触发 l0 的 compact, 删除标记一定会参与 compact
+  for (uint64_t tranc_id = 3; tranc_id <= 4; tranc_id++) {
+    for (int i : order) {
+      if (i % 2 == 1) {
+        engine.put("key" + std::to_string(i), value + "new", tranc_id);
+      }
+    }
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+
+  std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+  ASSERT_EQ(engine.cur_max_level, 1);
+  std::vector<std::shared_ptr<SST>> l1_ssts;
+  for (auto &sst_id : engine.level_sst_ids[1]) {
+    l1_ssts.push_back(engine.ssts[sst_id]);
+  }
+  ASSERT_FALSE(l1_ssts.empty());
+  // 最底层没有删除标记, 没有快照时每个 key 只保留一个版本
+  std::set<std::string> l1_keys;
+  for (CompactIterator it({l1_ssts}); it.is_valid(); ++it) {
+    EXPECT_FALSE(it->value.empty()) << it->key;
+    EXPECT_TRUE(l1_keys.insert(it->key).second) << it->key;
+  }
+
+  rlock.unlock();
+  for (int i = 0; i < num; i++) {
+    auto res = engine.get("key" + std::to_string(i), 0);
+    if (i % 2 == 0) {
+      EXPECT_FALSE(res.has_value()) << i;
+    } else {
+      ASSERT_TRUE(res.has_value()) << i;
+      EXPECT_EQ(res->first, value + "new");
+    }
+  }
+}
+
+TEST_F(CompactTest, SnapshotKeepsVisibleVersions) {
+  LSMEngine engine(test_dir);
+  // tranc_id 为 1 的快照一直活跃, 它能读到的版本不能被回收
+  engine.set_oldest_snapshot_provider([] { return 1; });
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+
+  std::mt19937 gen(5);
+  std::vector<int> order(num);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), gen);
+  for (int i : order) {
+    engine.put("key" + std::to_string(i), value + "1", 1);
+  }
+  for (int i = 0; i < num; i += 2) {
+    engine.remove("key" + std::to_string(i), 2);
+  }
+  for (uint64_t tranc_id = 3; tranc_id <= 4; tranc_id++) {
+    for (int i : order) {
+      if (i % 2 == 1) {
+        engine.put("key" + std::to_string(i), value + std::to_string(tranc_id),
+                   tranc_id);
+      }
+    }
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+
+  for (int i = 0; i < num; i++) {
+    std::string key = "key" + std::to_string(i);
+    auto snapshot_res = engine.get(key, 1);
+    ASSERT_TRUE(snapshot_res.has_value()) << key;
+    EXPECT_EQ(snapshot_res->first, value + "1");
+
+    auto res = engine.get(key, 0);
+    if (i % 2 == 0) {
+      EXPECT_FALSE(res.has_value()) << key;
+      EXPECT_FALSE(engine.get(key, 3).has_value()) << key;
+    } else {
+      ASSERT_TRUE(res.has_value()) << key;
+      EXPECT_EQ(res->first, value + "4");
+      EXPECT_EQ(engine.get(key, 3)->first, value + "3");
+    }
+  }
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();
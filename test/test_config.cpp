@@ -10,6 +10,7 @@ TEST(ConfigTest, BasicTest) {
   TomlConfig gConfig = TomlConfig::getInstance("../../../../config.toml");
 
   EXPECT_EQ(gConfig.getLsmBlockSize(), 32768);
+  EXPECT_EQ(gConfig.getLsmBlockCacheCapacity(), 32 * 1024 * 1024);
 }
 
 int main(int argc, char **argv) {
@@ -1,10 +1,15 @@
+#include "../include/config/config.h"
 #include "../include/logger/logger.h"
 #include "../include/lsm/engine.h"
+#include "../include/lsm/hot_blocks.h"
 #include "../include/lsm/level_iterator.h"
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
 #include <gtest/gtest.h>
+#include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 using namespace ::toni_lsm;
@@ -335,6 +340,580 @@ TEST_F(LSMTest, Recover) {
     }
   }
 }
+TEST_F(LSMTest, BackgroundFlush) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  // 写入超过 LSM_TOL_MEM_SIZE_LIMIT 的数据, 触发后台刷盘
+  int num = 80000;
+  for (int i = 0; i < num; i++) {
+    engine.put("key" + std::to_string(i), value + std::to_string(i), 1);
+  }
+
+  // 刷盘过程中数据一直可见
+  for (int i = 0; i < num; i++) {
+    auto res = engine.get("key" + std::to_string(i), 0);
+    ASSERT_TRUE(res.has_value()) << i;
+    EXPECT_EQ(res->first, value + std::to_string(i));
+  }
+
+  // 后台线程最终会把内存表降到阈值以下
+  auto limit = static_cast<size_t>(
+      TomlConfig::getInstance().getLsmTolMemSizeLimit());
+  for (int retry = 0; retry < 100; retry++) {
+    if (engine.memtable.get_total_size() < limit) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_LT(engine.memtable.get_total_size(), limit);
+  std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+  EXPECT_FALSE(engine.ssts.empty());
+}
+
+TEST_F(LSMTest, IteratorDoesNotBlockFlush) {
+  auto engine = std::make_shared<LSMEngine>(test_dir);
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+  for (int i = 0; i < num; i += 2) {
+    engine->put("key" + std::to_string(i), value, 0);
+  }
+  engine->flush();
+
+  // 迭代器存活期间刷盘和 compact 照常进行, 迭代器只看到创建时的数据
+  auto it = engine->begin(0);
+  auto old_version = engine->current_version();
+  for (int i = 1; i < num; i += 2) {
+    engine->put("key" + std::to_string(i), value, 0);
+  }
+  while (engine->memtable.get_total_size() > 0) {
+    engine->flush();
+  }
+  engine->wait_for_compaction();
+  EXPECT_NE(engine->current_version(), old_version);
+
+  int count = 0;
+  for (; it != engine->end(); ++it) {
+    EXPECT_EQ((*it).first.back() % 2, 0) << (*it).first;
+    count++;
+  }
+  EXPECT_EQ(count, (num + 1) / 2);
+  EXPECT_TRUE(engine->get("key1", 0).has_value());
+}
+
+TEST(WriteControllerTest, GraduatedSlowdownAndStop) {
+  // l0: 4 个开始限速, 8 个停止; 冻结表: 2 / 4; 待 compact: 100 / 200 字节
+  WriteController controller(4, 8, 2, 4, 100, 200, 1024 * 1024);
+  EXPECT_EQ(controller.get_state(), WriteStallState::Normal);
+  EXPECT_EQ(controller.get_delay_us(1024 * 1024), 0);
+
+  controller.update_lsm_condition(4, 0);
+  EXPECT_EQ(controller.get_state(), WriteStallState::Delayed);
+  uint64_t mild_rate = controller.get_stats().delayed_write_rate;
+  EXPECT_EQ(mild_rate, 1024 * 1024);
+  // 1MB/s 的限速下写入 1MB 大约需要等待 1 秒
+  uint64_t delay_us = controller.get_delay_us(1024 * 1024);
+  EXPECT_GT(delay_us, 900000);
+  EXPECT_LE(delay_us, 1000000);
+  // 令牌已经透支, 之后的写入需要排队
+  EXPECT_GT(controller.get_delay_us(1024), delay_us);
+
+  // 越接近 stop 阈值限速越严格
+  controller.update_lsm_condition(4, 150);
+  EXPECT_EQ(controller.get_state(), WriteStallState::Delayed);
+  EXPECT_LT(controller.get_stats().delayed_write_rate, mild_rate);
+
+  controller.update_immutable_memtables(4);
+  EXPECT_EQ(controller.get_state(), WriteStallState::Stopped);
+  EXPECT_EQ(controller.get_delay_us(1024), 0);
+
+  controller.update_immutable_memtables(0);
+  controller.update_lsm_condition(0, 0);
+  EXPECT_EQ(controller.get_state(), WriteStallState::Normal);
+
+  auto stats = controller.get_stats();
+  EXPECT_EQ(stats.num_delayed_writes, 2);
+  EXPECT_GT(stats.total_delay_us, delay_us);
+  EXPECT_EQ(to_string(stats.state), "normal");
+}
+
+TEST_F(LSMTest, WriteStallStats) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  for (int i = 0; i < 20000; i++) {
+    engine.put("key" + std::to_string(i), value, 0);
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+
+  // 刷盘和 compact 追上之后不再限速, 指标反映当前的 sst 布局
+  auto stats = engine.get_write_stall_stats();
+  EXPECT_EQ(stats.state, WriteStallState::Normal);
+  EXPECT_EQ(stats.immutable_memtables, 0);
+  std::shared_lock<std::shared_mutex> rlock(engine.ssts_mtx);
+  EXPECT_EQ(stats.l0_files, engine.level_sst_ids[0].size());
+}
+
+TEST_F(LSMTest, OldestSnapshot) {
+  auto manager = std::make_shared<TranManager>(test_dir);
+  uint64_t next = manager->get_oldest_snapshot();
+
+  auto tranc1 = manager->new_tranc(IsolationLevel::REPEATABLE_READ);
+  auto tranc2 = manager->new_tranc(IsolationLevel::REPEATABLE_READ);
+  auto snapshot = manager->acquire_snapshot();
+  EXPECT_EQ(tranc1->tranc_id_, next);
+  EXPECT_EQ(manager->get_oldest_snapshot(), tranc1->tranc_id_);
+
+  // 回滚的事务不再需要保留旧版本
+  tranc1->abort();
+  EXPECT_EQ(manager->get_oldest_snapshot(), tranc2->tranc_id_);
+  // 没有结束就被丢弃的事务同样
+  tranc2.reset();
+  EXPECT_EQ(manager->get_oldest_snapshot(), snapshot.tranc_id());
+
+  snapshot.release();
+  EXPECT_EQ(manager->get_oldest_snapshot(), snapshot.tranc_id() + 1);
+}
+
+TEST_F(LSMTest, SnapshotGuard) {
+  auto manager = std::make_shared<TranManager>(test_dir);
+
+  // 同时进行的读取多于槽位时退回加锁的集合, 可以按任意顺序释放
+  std::vector<SnapshotGuard> snapshots;
+  for (int i = 0; i < 100; i++) {
+    snapshots.push_back(manager->acquire_snapshot());
+  }
+  uint64_t first = snapshots.front().tranc_id();
+  EXPECT_EQ(manager->get_oldest_snapshot(), first);
+  snapshots.erase(snapshots.begin());
+  EXPECT_EQ(manager->get_oldest_snapshot(), first + 1);
+  snapshots.clear();
+  EXPECT_EQ(manager->get_oldest_snapshot(), first + 100);
+
+  // 读取抛出异常时快照同样被释放
+  try {
+    auto snapshot = manager->acquire_snapshot();
+    throw std::runtime_error("read failed");
+  } catch (const std::runtime_error &) {
+  }
+  EXPECT_EQ(manager->get_oldest_snapshot(), first + 101);
+
+  // 并发读取期间水位不会超过任何一个持有中的快照
+  std::atomic<bool> violated = false;
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&] {
+      for (int i = 0; i < 10000; i++) {
+        auto snapshot = manager->acquire_snapshot();
+        if (manager->get_oldest_snapshot() > snapshot.tranc_id()) {
+          violated = true;
+        }
+      }
+    });
+  }
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EXPECT_FALSE(violated);
+}
+
+TEST_F(LSMTest, RepeatableReadAcrossCompaction) {
+  LSM lsm(test_dir);
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+  for (int i = 0; i < num; i++) {
+    lsm.put("key" + std::to_string(i), value + "old");
+  }
+  auto tran_ctx = lsm.begin_tran(IsolationLevel::REPEATABLE_READ);
+
+  // 事务开始后的覆盖和删除经过多次 compact, 事务能读到的版本需要保留
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < num; i++) {
+      std::string key = "key" + std::to_string(i);
+      if (round == 2 && i % 4 == 0) {
+        lsm.remove(key);
+      } else {
+        lsm.put(key, value + std::to_string(round));
+      }
+    }
+  }
+  lsm.flush_all();
+  lsm.wait_for_compaction();
+
+  for (int i = 0; i < num; i++) {
+    std::string key = "key" + std::to_string(i);
+    auto res = tran_ctx->get(key);
+    ASSERT_TRUE(res.has_value()) << key;
+    EXPECT_EQ(res.value(), value + "old");
+
+    res = lsm.get(key);
+    if (i % 4 == 0) {
+      EXPECT_FALSE(res.has_value()) << key;
+    } else {
+      ASSERT_TRUE(res.has_value()) << key;
+      EXPECT_EQ(res.value(), value + "2");
+    }
+  }
+  EXPECT_TRUE(tran_ctx->commit());
+}
+
+TEST_F(LSMTest, ManifestRecovery) {
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+  {
+    LSM lsm(test_dir);
+    for (int round = 0; round < 2; round++) {
+      for (int i = 0; i < num; i++) {
+        lsm.put("key" + std::to_string(i), value + std::to_string(round));
+      }
+    }
+    lsm.flush_all();
+    lsm.wait_for_compaction();
+  }
+  EXPECT_TRUE(std::filesystem::exists(test_dir + "/MANIFEST"));
+
+  std::vector<std::filesystem::path> sst_files;
+  for (auto &entry : std::filesystem::directory_iterator(test_dir)) {
+    if (entry.path().filename().string().starts_with("sst_")) {
+      sst_files.push_back(entry.path());
+    }
+  }
+  std::sort(sst_files.begin(), sst_files.end());
+  ASSERT_FALSE(sst_files.empty());
+
+  // 模拟崩溃: 一个没有安装的 compact 输出, 一个重命名后没有记录的 trivial move
+  auto orphan = std::filesystem::path(test_dir) / "sst_99999.1";
+  std::filesystem::copy_file(sst_files.front(), orphan);
+  auto moved = sst_files.front();
+  moved.replace_extension(".9");
+  std::filesystem::rename(sst_files.front(), moved);
+
+  LSM lsm(test_dir);
+  EXPECT_FALSE(std::filesystem::exists(orphan));
+  EXPECT_FALSE(std::filesystem::exists(moved));
+  EXPECT_TRUE(std::filesystem::exists(sst_files.front()));
+  for (int i = 0; i < num; i++) {
+    std::string key = "key" + std::to_string(i);
+    auto res = lsm.get(key);
+    ASSERT_TRUE(res.has_value()) << key;
+    EXPECT_EQ(res.value(), value + "1");
+  }
+
+  // 重启后分配的 sst_id 不能与孤立文件重复
+  lsm.put("new_key", "new_value");
+  lsm.flush_all();
+  EXPECT_EQ(lsm.get("new_key").value(), "new_value");
+}
+
+TEST_F(LSMTest, LoadWithoutManifest) {
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+  {
+    LSM lsm(test_dir);
+    for (int i = 0; i < num; i++) {
+      lsm.put("key" + std::to_string(i), value + std::to_string(i));
+    }
+    lsm.flush_all();
+    lsm.wait_for_compaction();
+  }
+
+  // 没有 MANIFEST 的目录并行打开所有 sst, 之后重新生成 MANIFEST
+  std::filesystem::remove(test_dir + "/MANIFEST");
+  {
+    LSM lsm(test_dir);
+    EXPECT_TRUE(std::filesystem::exists(test_dir + "/MANIFEST"));
+    for (int i = 0; i < num; i++) {
+      std::string key = "key" + std::to_string(i);
+      auto res = lsm.get(key);
+      ASSERT_TRUE(res.has_value()) << key;
+      EXPECT_EQ(res.value(), value + std::to_string(i));
+    }
+  }
+
+  // 损坏的 sst 导致打开失败, 而不是静默地丢失数据
+  std::filesystem::remove(test_dir + "/MANIFEST");
+  for (auto &entry : std::filesystem::directory_iterator(test_dir)) {
+    if (entry.path().filename().string().starts_with("sst_")) {
+      std::filesystem::resize_file(entry.path(), 8);
+      break;
+    }
+  }
+  EXPECT_THROW(LSMEngine engine(test_dir), std::runtime_error);
+}
+
+TEST(RowCacheTest, FillInvalidateAndSnapshot) {
+  RowCache cache(1 << 20);
+  uint64_t token = 0;
+  EXPECT_FALSE(cache.get("key", 0, token).has_value());
+  cache.put("key", "value", 5, token);
+  EXPECT_EQ(cache.get("key", 0, token)->first, "value");
+  // 快照只能看到更早的版本时不能命中
+  EXPECT_TRUE(cache.get("key", 6, token).has_value());
+  EXPECT_FALSE(cache.get("key", 4, token).has_value());
+
+  // 查询期间发生过写入, 之前的令牌失效, 放入被忽略
+  cache.invalidate("key");
+  EXPECT_FALSE(cache.get("key", 0, token).has_value());
+  cache.invalidate("key");
+  cache.put("key", "stale", 5, token);
+  EXPECT_FALSE(cache.get("key", 0, token).has_value());
+  EXPECT_EQ(cache.usage(), 0);
+
+  // 超出容量时淘汰最久未访问的 key
+  RowCache small(1024);
+  for (int i = 0; i < 100; i++) {
+    std::string key = "key" + std::to_string(i);
+    small.get(key, 0, token);
+    small.put(key, std::string(100, 'v'), 1, token);
+  }
+  EXPECT_LE(small.usage(), small.capacity());
+  EXPECT_TRUE(small.get("key99", 0, token).has_value());
+  EXPECT_FALSE(small.get("key0", 0, token).has_value());
+}
+
+TEST_F(LSMTest, RowCache) {
+  LSMEngine engine(test_dir);
+  // 快照一直活跃, compact 之后仍然保留旧版本
+  engine.set_oldest_snapshot_provider([] { return 1; });
+  // 配置中默认不开启行缓存, 需要在写入之前开启
+  engine.enable_row_cache(1 << 20);
+  for (int i = 0; i < 100; i++) {
+    engine.put("key" + std::to_string(i), "old" + std::to_string(i), 1);
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+
+  // 从 sst 中读到的值放入行缓存, 再次读取时命中
+  EXPECT_EQ(engine.get("key1", 0)->first, "old1");
+  EXPECT_EQ(engine.get_batch({"key2", "key3"}, 0)[1].second->first, "old3");
+  EXPECT_GT(engine.row_cache->usage(), 0);
+  EXPECT_EQ(engine.get("key1", 0)->first, "old1");
+  EXPECT_EQ(engine.get("key3", 0)->first, "old3");
+  EXPECT_GT(engine.row_cache->hit_rate(), 0);
+
+  // 写入之后缓存失效, 刷盘之后也不会读到旧值
+  engine.put("key1", "new1", 2);
+  engine.remove("key3", 2);
+  EXPECT_EQ(engine.get("key1", 0)->first, "new1");
+  EXPECT_FALSE(engine.get("key3", 0).has_value());
+  // 快照读取不会读到之后的版本, 查到的旧版本也不会放入缓存
+  EXPECT_EQ(engine.get("key1", 1)->first, "old1");
+  EXPECT_EQ(engine.get("key1", 0)->first, "new1");
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  EXPECT_EQ(engine.get("key1", 0)->first, "new1");
+  EXPECT_EQ(engine.get("key1", 0)->first, "new1");
+  EXPECT_FALSE(engine.get("key3", 0).has_value());
+  // 缓存的是记录自身的事务 id, 快照读取不会命中之后的版本
+  EXPECT_EQ(engine.get("key1", 1)->first, "old1");
+  EXPECT_EQ(engine.get_batch({"key1"}, 1)[0].second->first, "old1");
+
+  engine.clear();
+  EXPECT_EQ(engine.row_cache->usage(), 0);
+  EXPECT_FALSE(engine.get("key2", 0).has_value());
+}
+
+TEST_F(LSMTest, RowCacheSnapshotReads) {
+  LSM lsm(test_dir);
+  lsm.enable_row_cache(1 << 20);
+  for (int i = 0; i < 100; i++) {
+    lsm.put("key" + std::to_string(i), "value" + std::to_string(i));
+  }
+  lsm.flush_all();
+
+  // LSM::get 总是带着快照读取, 快照覆盖了所有写入时同样放入行缓存
+  EXPECT_EQ(lsm.get("key1"), "value1");
+  EXPECT_EQ(lsm.get_row_cache_hit_rate(), 0);
+  EXPECT_EQ(lsm.get("key1"), "value1");
+  EXPECT_GT(lsm.get_row_cache_hit_rate(), 0);
+  EXPECT_EQ(lsm.get_batch({"key2"})[0].second, "value2");
+  double hit_rate = lsm.get_row_cache_hit_rate();
+  EXPECT_EQ(lsm.get_batch({"key2"})[0].second, "value2");
+  EXPECT_GT(lsm.get_row_cache_hit_rate(), hit_rate);
+
+  // 写入之后不会读到缓存中的旧值
+  lsm.put("key1", "new1");
+  lsm.remove("key2");
+  EXPECT_EQ(lsm.get("key1"), "new1");
+  EXPECT_FALSE(lsm.get("key2").has_value());
+  lsm.flush_all();
+  EXPECT_EQ(lsm.get("key1"), "new1");
+  EXPECT_EQ(lsm.get("key1"), "new1");
+  EXPECT_FALSE(lsm.get_batch({"key2"})[0].second.has_value());
+}
+
+TEST_F(LSMTest, MultiGet) {
+  LSMEngine engine(test_dir);
+  // 保留快照可见的旧版本
+  engine.set_oldest_snapshot_provider([] { return 1; });
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+  auto key_of = [](int i) { return "key" + std::to_string(i); };
+  for (int i = 0; i < num; i++) {
+    engine.put(key_of(i), value + "old", 1);
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+
+  // l0 中覆盖和删除一部分, memtable 中再覆盖和删除一部分
+  for (int i = 0; i < num; i += 4) {
+    engine.put(key_of(i), value + "l0", 2);
+    engine.remove(key_of(i + 1), 2);
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  for (int i = 0; i < num; i += 8) {
+    engine.put(key_of(i + 1), value + "mem", 3);
+    engine.remove(key_of(i + 2), 3);
+  }
+
+  // 乱序, 重复以及不存在的 key
+  std::vector<std::string> keys = {"missing", key_of(0)};
+  for (int i = num - 1; i >= 0; i--) {
+    keys.push_back(key_of(i));
+  }
+  keys.push_back(key_of(1));
+  auto results = engine.get_batch(keys, 0);
+  ASSERT_EQ(results.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    EXPECT_EQ(results[i].first, keys[i]);
+    auto expected = engine.get(keys[i], 0);
+    ASSERT_EQ(results[i].second.has_value(), expected.has_value()) << keys[i];
+    if (expected.has_value()) {
+      EXPECT_EQ(results[i].second->first, expected->first) << keys[i];
+    }
+  }
+  EXPECT_FALSE(results[0].second.has_value());
+  EXPECT_EQ(results[1].second->first, value + "l0");
+  // memtable 中的删除标记和 l0 中的删除标记都会遮住更旧的版本
+  EXPECT_FALSE(engine.get_batch({key_of(2)}, 0)[0].second.has_value());
+  EXPECT_FALSE(engine.get_batch({key_of(5)}, 0)[0].second.has_value());
+  EXPECT_EQ(engine.get_batch({key_of(9)}, 0)[0].second->first, value + "mem");
+  EXPECT_EQ(engine.get_batch({key_of(3)}, 0)[0].second->first, value + "old");
+  // 快照读取只能看到之前的版本
+  EXPECT_EQ(engine.get_batch({key_of(5)}, 1)[0].second->first, value + "old");
+}
+
+TEST_F(LSMTest, ParallelMultiGet) {
+  LSMEngine engine(test_dir);
+  std::string value(1024, 'v');
+  int num = LSMEngine::get_sst_size(0) * 4 / value.size();
+  auto key_of = [](int i) { return "key" + std::to_string(i); };
+  for (int i = 0; i < num; i++) {
+    engine.put(key_of(i), value + std::to_string(i), 1);
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+  engine.wait_for_compaction();
+  for (int i = 0; i < num; i += 3) {
+    engine.remove(key_of(i), 2);
+  }
+  while (engine.memtable.get_total_size() > 0) {
+    engine.flush();
+  }
+
+  // 多个线程同时发起大批量查询, 共享同一个读取线程池
+  std::vector<std::string> keys;
+  for (int i = 0; i < num; i += 2) {
+    keys.push_back(key_of(i));
+  }
+  keys.push_back("missing");
+  auto check = [&](const std::vector<std::pair<
+                       std::string, std::optional<std::pair<
+                                        std::string, uint64_t>>>> &results) {
+    ASSERT_EQ(results.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_EQ(results[i].first, keys[i]);
+      auto expected = engine.get(keys[i], 0);
+      ASSERT_EQ(results[i].second.has_value(), expected.has_value()) << keys[i];
+      if (expected.has_value()) {
+        ASSERT_EQ(results[i].second->first, expected->first) << keys[i];
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  std::vector<std::vector<std::pair<
+      std::string, std::optional<std::pair<std::string, uint64_t>>>>>
+      results(4);
+  for (size_t t = 0; t < results.size(); t++) {
+    threads.emplace_back(
+        [&, t] { results[t] = engine.get_batch(keys, 0); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &result : results) {
+    check(result);
+  }
+  EXPECT_FALSE(results[0].back().second.has_value());
+  EXPECT_FALSE(results[0][0].second.has_value());
+  EXPECT_EQ(results[0][1].second->first, value + "2");
+}
+
+TEST_F(LSMTest, WarmUpBlockCache) {
+  if (TomlConfig::getInstance().getLsmHotBlocksMaxEntries() == 0) {
+    GTEST_SKIP() << "hot block list is disabled";
+  }
+  std::vector<std::pair<int, int>> hot;
+  {
+    LSMEngine engine(test_dir);
+    for (int i = 0; i < 2000; i++) {
+      engine.put("key" + std::to_string(i), "value" + std::to_string(i), 0);
+    }
+    while (engine.memtable.get_total_size() > 0) {
+      engine.flush();
+    }
+    engine.wait_for_compaction();
+    for (int i = 0; i < 2000; i += 10) {
+      EXPECT_EQ(engine.get("key" + std::to_string(i), 0)->first,
+                "value" + std::to_string(i));
+    }
+    std::set<int> live;
+    for (auto &[level, ssts] : engine.current_version()->levels) {
+      for (auto &sst : ssts) {
+        live.insert(sst->get_sst_id());
+      }
+    }
+    for (auto &key : engine.block_cache->hot_keys(1 << 20)) {
+      if (live.contains(key.first)) {
+        hot.push_back(key);
+      }
+    }
+    ASSERT_FALSE(hot.empty());
+  }
+  // 关闭时保存热点 block 列表
+  EXPECT_FALSE(HotBlockList::load(test_dir + "/HOT_BLOCKS").empty());
+
+  // 重启后后台预读列表中的 block, 不需要任何查询
+  LSMEngine engine(test_dir);
+  engine.wait_for_warm_up();
+  for (auto &[sst_id, block_id] : hot) {
+    EXPECT_TRUE(engine.block_cache->contains(sst_id, block_id))
+        << sst_id << " " << block_id;
+  }
+  EXPECT_EQ(engine.get("key10", 0)->first, "value10");
+}
+
+TEST(HotBlockListTest, SaveAndLoad) {
+  std::string path = "test_hot_blocks";
+  std::vector<std::pair<int, int>> keys = {{3, 0}, {1, 7}, {3, 2}};
+  HotBlockList::save(path, keys);
+  EXPECT_EQ(HotBlockList::load(path), keys);
+
+  // 损坏或者不存在的列表视为空, 只是不做预热
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  EXPECT_TRUE(HotBlockList::load(path).empty());
+  std::filesystem::remove(path);
+  EXPECT_TRUE(HotBlockList::load(path).empty());
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();
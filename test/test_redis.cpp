@@ -1,5 +1,6 @@
 #include "../include/logger/logger.h"
 #include "../include/redis_wrapper/redis_wrapper.h"
+#include <filesystem>
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
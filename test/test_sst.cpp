@@ -1,8 +1,10 @@
+#include "../include/block/secondary_cache.h"
 #include "../include/config/config.h"
 #include "../include/consts.h"
 #include "../include/logger/logger.h"
 #include "../include/sst/sst.h"
 #include "../include/sst/sst_iterator.h"
+#include <chrono>
 #include <filesystem>
 #include <gtest/gtest.h>
 
@@ -111,6 +113,22 @@ TEST_F(SSTTest, KeySearch) {
   EXPECT_EQ(sst->find_block_idx("key999"), -1);
 }
 
+TEST_F(SSTTest, FindBlockIdxs) {
+  auto sst = create_test_sst(256, 100);
+  ASSERT_GT(sst->num_blocks(), 2);
+  // 有序的 key 批量定位, 结果与逐个查找一致
+  std::vector<std::string> keys = {"a",     "key0",  "key10", "key10",
+                                   "key50", "key55", "key99", "zzz"};
+  auto idxs = sst->find_block_idxs(keys);
+  ASSERT_EQ(idxs.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    EXPECT_EQ(idxs[i], sst->find_block_idx(keys[i])) << keys[i];
+  }
+  EXPECT_EQ(idxs.front(), -1);
+  EXPECT_EQ(idxs.back(), -1);
+  EXPECT_NE(idxs[4], -1);
+}
+
 // 测试元数据
 TEST_F(SSTTest, Metadata) {
   auto sst = create_test_sst(512, 10);
@@ -197,6 +215,43 @@ TEST_F(SSTTest, LargeSST) {
   }
 }
 
+TEST_F(SSTTest, SeekLowerBound) {
+  SSTBuilder builder(4096, true); // 4KB blocks
+  auto block_cache = std::make_shared<BlockCache>(
+      TomlConfig::getInstance().getLsmBlockCacheCapacity(),
+      TomlConfig::getInstance().getLsmBlockCacheK());
+
+  // 只写入偶数 key: key000, key002, ..., key998
+  for (int i = 0; i < 1000; i += 2) {
+    std::string key = "key" + std::string(3 - std::to_string(i).length(), '0') +
+                      std::to_string(i);
+    builder.add(key, "val" + key.substr(3), 0);
+  }
+  auto sst = builder.build(1, "test_data/lower_bound.sst", block_cache);
+  EXPECT_GT(sst->num_blocks(), 1);
+
+  auto it = sst->begin(0);
+  // key 存在时停在该 key
+  it.seek_lower_bound("key500");
+  ASSERT_TRUE(it.is_valid());
+  EXPECT_EQ(it.key(), "key500");
+
+  // key 不存在时停在下一个 key, 包括跨越 block 边界的情况
+  for (size_t i = 0; i + 1 < sst->num_blocks(); i++) {
+    auto meta_entries = sst->get_meta_entries();
+    it.seek_lower_bound((*meta_entries)[i].last_key + "0");
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.key(), (*meta_entries)[i + 1].first_key);
+  }
+
+  it.seek_lower_bound("a");
+  ASSERT_TRUE(it.is_valid());
+  EXPECT_EQ(it.key(), "key000");
+
+  it.seek_lower_bound("key999");
+  EXPECT_TRUE(it.is_end());
+}
+
 TEST_F(SSTTest, LargeSSTPredicate) {
   SSTBuilder builder(4096, true); // 4KB blocks
   auto block_cache = std::make_shared<BlockCache>(
@@ -242,6 +297,351 @@ TEST_F(SSTTest, LargeSSTPredicate) {
   EXPECT_EQ(iter_end.key(), "key501");
 }
 
+TEST_F(SSTTest, TableCacheEviction) {
+  auto block_cache = std::make_shared<BlockCache>(
+      TomlConfig::getInstance().getLsmBlockCacheCapacity(),
+      TomlConfig::getInstance().getLsmBlockCacheK());
+  auto table_cache = std::make_shared<TableCache>(2, SIZE_MAX);
+
+  std::vector<std::shared_ptr<SST>> ssts;
+  for (size_t id = 0; id < 3; id++) {
+    SSTBuilder builder(256, true);
+    for (int i = 0; i < 100; i++) {
+      std::string key = "key" + std::to_string(id) + std::to_string(i + 100);
+      builder.add(key, "value" + std::to_string(i), 0);
+    }
+    auto path = "test_data/cache" + std::to_string(id) + ".sst";
+    ssts.push_back(builder.build(id, path, block_cache));
+    ssts.back()->attach_table_cache(table_cache);
+  }
+  // 最久未访问的 sst 被关闭
+  EXPECT_EQ(table_cache->open_files(), 2);
+
+  // 持有 block 索引期间 sst 被关闭, 返回值仍然有效
+  auto meta_entries = ssts[1]->get_meta_entries();
+  ssts[0]->get_meta_entries();
+  EXPECT_EQ(table_cache->open_files(), 2);
+  EXPECT_GT(meta_entries->size(), 1);
+  EXPECT_EQ(meta_entries->front().first_key, "key1100");
+
+  // 被关闭的 sst 再次读取时重新打开
+  for (size_t id = 0; id < 3; id++) {
+    std::string key = "key" + std::to_string(id) + "150";
+    auto it = ssts[id]->get(key, 0);
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.key(), key);
+    EXPECT_LE(table_cache->open_files(), 2);
+  }
+
+  // 删除之后不再被关闭, 文件已经不存在也仍然可以读取
+  ssts[0]->del_sst();
+  EXPECT_FALSE(std::filesystem::exists("test_data/cache0.sst"));
+  ssts[1]->get_meta_entries();
+  ssts[2]->get_meta_entries();
+  auto it = ssts[0]->get("key0150", 0);
+  ASSERT_TRUE(it.is_valid());
+
+  // 按照常驻内存的字节数限制
+  auto small_cache = std::make_shared<TableCache>(100, 1);
+  for (auto &sst : ssts) {
+    sst->attach_table_cache(small_cache);
+  }
+  EXPECT_EQ(small_cache->open_files(), 1);
+  ssts.clear();
+  EXPECT_EQ(small_cache->open_files(), 0);
+}
+
+TEST_F(SSTTest, MmapRead) {
+  auto block_cache = std::make_shared<BlockCache>(
+      TomlConfig::getInstance().getLsmBlockCacheCapacity(),
+      TomlConfig::getInstance().getLsmBlockCacheK());
+  SSTBuilder builder(256, true);
+  for (int i = 0; i < 300; i++) {
+    builder.add("key" + std::to_string(i + 100), "value" + std::to_string(i),
+                0);
+  }
+  builder.build(1, "test_data/mmap.sst", block_cache);
+
+  // 重新打开的 sst 被关闭之后按原路径再次打开
+  auto sst = SST::open(1, FileObj::open("test_data/mmap.sst", false),
+                       std::make_shared<BlockCache>(1 << 20, 2));
+  sst->set_use_mmap(true);
+  for (int i = 0; i < 300; i++) {
+    std::string key = "key" + std::to_string(i + 100);
+    auto it = sst->get(key, 0);
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.key(), key);
+    EXPECT_EQ(it.value(), "value" + std::to_string(i));
+  }
+
+  // block 持有映射, sst 关闭之后仍然可以读取
+  auto block = sst->read_block(0);
+  sst->release_reader();
+  EXPECT_EQ(block->get_first_key(), "key100");
+  EXPECT_EQ(block->get_value_binary("key100", 0).value(), "value0");
+  EXPECT_THROW(block->add_entry("key", "value", 0, true), std::logic_error);
+  auto encoded = block->encode();
+  auto copied = Block::decode(encoded);
+  EXPECT_EQ(copied->get_value_binary("key100", 0).value(), "value0");
+
+  // 切换回 pread 读取
+  sst->set_use_mmap(false);
+  auto it = sst->get("key399", 0);
+  ASSERT_TRUE(it.is_valid());
+  EXPECT_EQ(it.value(), "value299");
+}
+
+TEST_F(SSTTest, ReadBlocksBatch) {
+  std::vector<std::shared_ptr<SST>> ssts;
+  for (size_t id = 0; id < 2; id++) {
+    SSTBuilder builder(256, true);
+    for (int i = 0; i < 200; i++) {
+      builder.add("key" + std::to_string(id) + std::to_string(i + 100),
+                  "value" + std::to_string(i), 0);
+    }
+    auto path = "test_data/batch" + std::to_string(id) + ".sst";
+    ssts.push_back(builder.build(id, path, nullptr));
+  }
+  // 重新打开, 使用空的缓存保证 block 需要从磁盘读取
+  for (size_t id = 0; id < 2; id++) {
+    auto path = "test_data/batch" + std::to_string(id) + ".sst";
+    ssts[id] = SST::open(id, FileObj::open(path, false),
+                         std::make_shared<BlockCache>(1 << 20, 2));
+  }
+
+  // 跨 sst 且有重复的 block
+  std::vector<std::pair<std::shared_ptr<SST>, size_t>> wanted;
+  for (size_t idx = 0; idx < ssts[0]->num_blocks(); idx += 2) {
+    wanted.emplace_back(ssts[0], idx);
+    wanted.emplace_back(ssts[1], idx);
+  }
+  wanted.emplace_back(ssts[0], 0);
+  auto blocks = SST::read_blocks(wanted);
+  ASSERT_EQ(blocks.size(), wanted.size());
+  for (size_t i = 0; i < wanted.size(); i++) {
+    auto &[sst, idx] = wanted[i];
+    EXPECT_EQ(blocks[i]->get_first_key(),
+              (*sst->get_meta_entries())[idx].first_key);
+    // 批量读取的 block 已经放入缓存
+    EXPECT_EQ(sst->read_block(idx), blocks[i]);
+  }
+  EXPECT_EQ(blocks.back(), blocks.front());
+  EXPECT_THROW(SST::read_blocks({{ssts[0], ssts[0]->num_blocks()}}),
+               std::out_of_range);
+
+  // 顺序遍历时批量预读之后的 block
+  int count = 0;
+  for (auto it = ssts[1]->begin(0); it != ssts[1]->end(); ++it) {
+    EXPECT_EQ(it.key(), "key1" + std::to_string(count + 100));
+    count++;
+  }
+  EXPECT_EQ(count, 200);
+}
+
+TEST_F(SSTTest, DirectIO) {
+  auto pool = std::make_shared<AlignedBufferPool>(1 << 20);
+  SSTBuilder builder(256, true);
+  builder.set_direct_io(pool);
+  for (int i = 0; i < 300; i++) {
+    builder.add("key" + std::to_string(i + 100), "value" + std::to_string(i),
+                0);
+  }
+  builder.build(1, "test_data/direct.sst", nullptr);
+
+  auto sst = SST::open(1, FileObj::open("test_data/direct.sst", false, pool),
+                       std::make_shared<BlockCache>(1 << 20, 2));
+  // 批量读取和逐个读取的 block 都不要求在文件中对齐
+  std::vector<std::pair<std::shared_ptr<SST>, size_t>> wanted;
+  for (size_t idx = 0; idx < sst->num_blocks(); idx += 3) {
+    wanted.emplace_back(sst, idx);
+  }
+  wanted.emplace_back(sst, sst->num_blocks() - 1);
+  auto blocks = SST::read_blocks(wanted);
+  for (size_t i = 0; i < wanted.size(); i++) {
+    EXPECT_EQ(blocks[i]->get_first_key(),
+              (*sst->get_meta_entries())[wanted[i].second].first_key);
+  }
+  for (int i = 0; i < 300; i++) {
+    std::string key = "key" + std::to_string(i + 100);
+    auto it = sst->get(key, 0);
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.value(), "value" + std::to_string(i));
+  }
+
+  // 被关闭之后仍然以 O_DIRECT 重新打开
+  sst->release_reader();
+  auto it = sst->get("key399", 0);
+  ASSERT_TRUE(it.is_valid());
+  EXPECT_EQ(it.value(), "value299");
+}
+
+// 扫描时不放入缓存, 已缓存的 block 仍然可以命中
+TEST_F(SSTTest, ScanWithoutFillCache) {
+  SSTBuilder builder(256, true);
+  for (int i = 0; i < 300; i++) {
+    builder.add("key" + std::to_string(i + 100), "value" + std::to_string(i),
+                0);
+  }
+  auto block_cache = std::make_shared<BlockCache>(1 << 20, 2);
+  auto sst = builder.build(1, "test_data/no_fill.sst", block_cache);
+  ASSERT_GT(sst->num_blocks(), 8);
+
+  auto cached = sst->read_block(0);
+  size_t usage = block_cache->usage();
+  int count = 0;
+  for (auto it = sst->begin(0, false); it.is_valid() && it != sst->end();
+       ++it) {
+    count++;
+  }
+  EXPECT_EQ(count, 300);
+  EXPECT_EQ(block_cache->usage(), usage);
+  EXPECT_EQ(block_cache->get(1, 0), cached);
+  EXPECT_EQ(block_cache->get(1, 5), nullptr);
+
+  auto blocks = SST::read_blocks({{sst, 5}, {sst, 6}}, false);
+  EXPECT_EQ(blocks.size(), 2);
+  EXPECT_EQ(block_cache->usage(), usage);
+
+  // 默认仍然放入缓存
+  for (auto it = sst->begin(0); it.is_valid() && it != sst->end(); ++it) {
+  }
+  EXPECT_NE(block_cache->get(1, 5), nullptr);
+}
+
+TEST_F(SSTTest, SecondaryCache) {
+  SSTBuilder builder(256, true);
+  for (int i = 0; i < 300; i++) {
+    builder.add("key" + std::to_string(i + 100), "value" + std::to_string(i),
+                0);
+  }
+  std::string cache_path = "test_data/secondary_cache";
+  // 一级缓存只能放下少量 block, 其余的被淘汰到二级缓存
+  auto block_cache = std::make_shared<BlockCache>(4096, 2);
+  block_cache->set_secondary_cache(
+      std::make_shared<SecondaryCache>(cache_path, 1 << 20));
+  auto sst = builder.build(1, "test_data/secondary.sst", block_cache);
+  size_t num_blocks = sst->num_blocks();
+  ASSERT_GT(num_blocks, 16);
+
+  std::vector<std::string> first_keys;
+  for (size_t i = 0; i < num_blocks; i++) {
+    first_keys.push_back(sst->read_block(i)->get_first_key());
+  }
+  auto secondary = block_cache->secondary_cache();
+  secondary->wait_for_pending();
+  EXPECT_GT(secondary->entries(), 0);
+  for (size_t i = 0; i < num_blocks; i++) {
+    EXPECT_EQ(sst->read_block(i)->get_first_key(), first_keys[i]);
+  }
+  EXPECT_GT(secondary->hit_rate(), 0.0);
+
+  // 重启之后二级缓存中的 block 仍然可以命中
+  size_t entries = secondary->entries();
+  secondary.reset();
+  sst.reset();
+  block_cache = std::make_shared<BlockCache>(4096, 2);
+  block_cache->set_secondary_cache(
+      std::make_shared<SecondaryCache>(cache_path, 1 << 20));
+  sst = SST::open(1, FileObj::open("test_data/secondary.sst", false),
+                  block_cache);
+  secondary = block_cache->secondary_cache();
+  EXPECT_EQ(secondary->entries(), entries);
+  EXPECT_EQ(sst->read_block(0)->get_first_key(), first_keys[0]);
+  auto blocks = SST::read_blocks({{sst, 1}, {sst, 2}});
+  EXPECT_EQ(blocks[0]->get_first_key(), first_keys[1]);
+  EXPECT_EQ(blocks[1]->get_first_key(), first_keys[2]);
+  EXPECT_DOUBLE_EQ(secondary->hit_rate(), 1.0);
+
+  // 删除之后以相同的 sst_id 重新生成, block 的大小和 key 范围都不变
+  secondary.reset();
+  sst.reset();
+  std::filesystem::remove("test_data/secondary.sst");
+  SSTBuilder rebuilt(256, true);
+  for (int i = 0; i < 300; i++) {
+    rebuilt.add("key" + std::to_string(i + 100), "VALUE" + std::to_string(i),
+                0);
+  }
+  rebuilt.build(1, "test_data/secondary.sst",
+                std::make_shared<BlockCache>(4096, 2));
+  // 文件时间戳的精度可能较粗, 显式推后修改时间模拟之后才生成的文件
+  auto mtime = std::filesystem::last_write_time("test_data/secondary.sst");
+  std::filesystem::last_write_time("test_data/secondary.sst",
+                                   mtime + std::chrono::seconds(1));
+  block_cache = std::make_shared<BlockCache>(4096, 2);
+  block_cache->set_secondary_cache(
+      std::make_shared<SecondaryCache>(cache_path, 1 << 20));
+  sst = SST::open(1, FileObj::open("test_data/secondary.sst", false),
+                  block_cache);
+  // 二级缓存中旧文件的 block 不会被读到
+  for (int i = 0; i < 300; i++) {
+    auto it = sst->get("key" + std::to_string(i + 100), 0);
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.value(), "VALUE" + std::to_string(i));
+  }
+}
+
+TEST_F(SSTTest, PinReader) {
+  auto block_cache = std::make_shared<BlockCache>(1 << 20, 2);
+  auto table_cache = std::make_shared<TableCache>(1, SIZE_MAX);
+  std::vector<std::shared_ptr<SST>> ssts;
+  for (size_t id = 0; id < 2; id++) {
+    SSTBuilder builder(256, true);
+    for (int i = 0; i < 100; i++) {
+      builder.add("key" + std::to_string(id) + std::to_string(i + 100),
+                  "value" + std::to_string(i), 0);
+    }
+    auto path = "test_data/pin" + std::to_string(id) + ".sst";
+    ssts.push_back(builder.build(id, path, block_cache));
+    ssts.back()->attach_table_cache(table_cache);
+  }
+  EXPECT_EQ(table_cache->open_files(), 1);
+
+  // 常驻的 sst 不占用 TableCache 的名额, 也不会被关闭
+  ssts[0]->set_pin_reader(true);
+  EXPECT_TRUE(ssts[0]->is_reader_pinned());
+  for (size_t id = 0; id < 2; id++) {
+    auto it = ssts[id]->get("key" + std::to_string(id) + "150", 0);
+    ASSERT_TRUE(it.is_valid());
+  }
+  EXPECT_EQ(table_cache->open_files(), 1);
+
+  // 取消之后重新登记, 再次受到 TableCache 的限制
+  ssts[0]->set_pin_reader(false);
+  EXPECT_EQ(table_cache->open_files(), 1);
+  EXPECT_TRUE(ssts[0]->get("key0150", 0).is_valid());
+  EXPECT_EQ(table_cache->open_files(), 1);
+}
+
+TEST_F(SSTTest, PrefetchBlocks) {
+  SSTBuilder builder(256, true);
+  for (int i = 0; i < 300; i++) {
+    builder.add("key" + std::to_string(i + 100), "value" + std::to_string(i),
+                0);
+  }
+  auto sst = builder.build(1, "test_data/prefetch.sst",
+                           std::make_shared<BlockCache>(1 << 20, 2));
+  size_t num_blocks = sst->num_blocks();
+  ASSERT_GT(num_blocks, 6);
+  std::vector<std::string> first_keys;
+  for (size_t i = 0; i < num_blocks; i++) {
+    first_keys.push_back(sst->read_block(i)->get_first_key());
+  }
+
+  auto block_cache = std::make_shared<BlockCache>(1 << 20, 2);
+  sst = SST::open(1, FileObj::open("test_data/prefetch.sst", false),
+                  block_cache);
+  // 乱序, 重复和越界的下标都被整理, 1 和 3 之间的间隙合并成一次读取
+  EXPECT_EQ(sst->prefetch_blocks({5, 1, 3, 3, num_blocks}), 3);
+  for (size_t i : {1, 3, 5}) {
+    EXPECT_TRUE(block_cache->contains(1, i));
+    EXPECT_EQ(block_cache->get(1, i)->get_first_key(), first_keys[i]);
+  }
+  EXPECT_FALSE(block_cache->contains(1, 0));
+  // 已经缓存的 block 不再读取
+  EXPECT_EQ(sst->prefetch_blocks({1, 5, 6}), 1);
+  EXPECT_EQ(block_cache->get(1, 6)->get_first_key(), first_keys[6]);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();
@@ -1,9 +1,18 @@
 #include "../include/logger/logger.h"
+#include "../include/utils/aligned_buffer.h"
 #include "../include/utils/bloom_filter.h"
 #include "../include/utils/files.h"
+#include "../include/utils/io_uring.h"
+#include "../include/utils/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <gtest/gtest.h>
 #include <random>
+#include <thread>
+#include <unistd.h>
 
 using namespace ::toni_lsm;
 
@@ -172,6 +181,168 @@ TEST(BloomFilterTest, ComprehensiveTest) {
 #endif
 }
 
+TEST(ThreadPoolTest, SubmitAndShutdown) {
+  std::atomic<int> counter = 0;
+  std::vector<std::future<int>> results;
+  {
+    ThreadPool pool(4);
+    for (int i = 0; i < 100; i++) {
+      results.push_back(pool.submit(
+          [&counter](int x) {
+            counter++;
+            return x * 2;
+          },
+          i));
+    }
+    for (int i = 0; i < 100; i++) {
+      EXPECT_EQ(results[i].get(), i * 2);
+    }
+
+    // shutdown 会执行完已经提交的任务
+    for (int i = 0; i < 100; i++) {
+      pool.submit([&counter] { counter++; });
+    }
+    pool.shutdown();
+    EXPECT_EQ(counter.load(), 200);
+
+    // 停止后不再接收任务
+    EXPECT_THROW(pool.submit([] {}), std::runtime_error);
+  }
+}
+
+// 多个线程同时读取同一个文件的不同位置
+TEST_F(FileTest, ConcurrentPositionalRead) {
+  const std::string path = "test_data/concurrent.dat";
+  auto data = generate_random_data(1 << 20);
+  {
+    auto file = FileObj::create_and_write(path, data);
+    EXPECT_EQ(file.size(), data.size());
+  }
+
+  auto file = FileObj::open(path, false);
+  ASSERT_EQ(file.size(), data.size());
+  std::atomic<int> mismatches = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<size_t> dis(0, data.size() - 4096);
+      for (int i = 0; i < 2000; i++) {
+        size_t offset = dis(gen);
+        size_t length = offset % 4096 + 1;
+        auto slice = file.read_to_slice(offset, length);
+        if (!std::equal(slice.begin(), slice.end(), data.begin() + offset)) {
+          mismatches++;
+        }
+        uint64_t value;
+        memcpy(&value, data.data() + offset, sizeof(uint64_t));
+        if (file.read_uint64(offset) != value) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(mismatches.load(), 0);
+
+  // 追加写入之后大小和内容都能立即读到
+  std::vector<uint8_t> tail = {1, 2, 3};
+  EXPECT_TRUE(file.append(tail));
+  EXPECT_EQ(file.size(), data.size() + tail.size());
+  EXPECT_EQ(file.read_to_slice(data.size(), tail.size()), tail);
+  EXPECT_THROW(file.read_to_slice(data.size(), tail.size() + 1),
+               std::out_of_range);
+}
+
+// 目录可以同步, 不存在的目录或普通文件返回 false
+TEST_F(FileTest, SyncDir) {
+  const std::string path = "test_data/sync_dir.dat";
+  FileObj::create_and_write(path, generate_random_data(16));
+  EXPECT_TRUE(FileObj::sync_dir("test_data"));
+  EXPECT_FALSE(FileObj::sync_dir(path));
+  EXPECT_FALSE(FileObj::sync_dir("test_data/missing"));
+}
+
+// 批量读取的结果与文件内容一致, io_uring 不可用时退化为 pread
+TEST_F(FileTest, IoUringReadBatch) {
+  const std::string path = "test_data/uring.dat";
+  auto data = generate_random_data(1 << 20);
+  auto file = FileObj::create_and_write(path, data);
+  int fd = ::open(path.c_str(), O_RDONLY);
+  ASSERT_NE(fd, -1);
+
+  for (unsigned entries : {0u, 8u, 64u}) {
+    IoUring ring(entries);
+    EXPECT_TRUE(entries > 0 || !ring.available());
+
+    // 请求数超过队列深度, 需要分多次提交
+    std::mt19937 gen(entries);
+    std::uniform_int_distribution<size_t> dis(0, data.size() - 8192);
+    std::vector<std::vector<uint8_t>> bufs(100);
+    std::vector<ReadRequest> reqs(bufs.size());
+    for (size_t i = 0; i < reqs.size(); i++) {
+      bufs[i].resize(i % 7 == 0 ? 8192 : 4096);
+      reqs[i].fd = fd;
+      reqs[i].offset = dis(gen);
+      reqs[i].length = bufs[i].size();
+      reqs[i].buf = bufs[i].data();
+    }
+    // 越过文件末尾的请求读取失败
+    std::vector<uint8_t> tail_buf(16);
+    reqs.push_back(ReadRequest{fd, data.size() - 8, 16, tail_buf.data()});
+
+    ring.read_batch(reqs);
+    for (size_t i = 0; i < bufs.size(); i++) {
+      ASSERT_TRUE(reqs[i].ok);
+      EXPECT_TRUE(std::equal(bufs[i].begin(), bufs[i].end(),
+                             data.begin() + reqs[i].offset));
+    }
+    EXPECT_FALSE(reqs.back().ok);
+  }
+  ::close(fd);
+}
+
+// O_DIRECT 读写未对齐的偏移量和长度, 缓冲区被复用
+TEST_F(FileTest, DirectIO) {
+  auto pool = std::make_shared<AlignedBufferPool>(1 << 20);
+  {
+    auto buffer = pool->acquire(5000);
+    EXPECT_EQ(buffer.capacity(), 8192);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.data()) %
+                  AlignedBufferPool::kAlignment,
+              0);
+  }
+  EXPECT_EQ(pool->cached_bytes(), 8192);
+  auto reused = pool->acquire(6000);
+  EXPECT_EQ(pool->cached_bytes(), 0);
+  reused = AlignedBuffer();
+
+  const std::string path = "test_data/direct.dat";
+  auto data = generate_random_data(3 * AlignedBufferPool::kAlignment + 123);
+  {
+    auto file = FileObj::create_and_write(path, data, pool);
+    EXPECT_EQ(file.size(), data.size());
+  }
+  // 补齐写入的零已经被截断
+  EXPECT_EQ(std::filesystem::file_size(path), data.size());
+
+  auto file = FileObj::open(path, false, pool);
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<size_t> dis(0, data.size() - 1);
+  for (int i = 0; i < 200; i++) {
+    size_t offset = dis(gen);
+    size_t length = std::min<size_t>(dis(gen) % 5000 + 1, data.size() - offset);
+    auto slice = file.read_to_slice(offset, length);
+    EXPECT_TRUE(std::equal(slice.begin(), slice.end(), data.begin() + offset));
+  }
+  uint64_t last;
+  memcpy(&last, data.data() + data.size() - sizeof(uint64_t), sizeof(last));
+  EXPECT_EQ(file.read_uint64(data.size() - sizeof(uint64_t)), last);
+  EXPECT_GT(pool->cached_bytes(), 0);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <set>
 
 using namespace testing;
 using namespace ::toni_lsm;
@@ -31,6 +32,14 @@ public:
   uint64_t get_max_finished_tranc_id() { return max_finished_tranc_id_; }
 };
 
+class CleanableWAL : public WAL {
+public:
+  CleanableWAL(const std::string &log_path, uint64_t max_finished_tranc_id)
+      : WAL(log_path, 1, max_finished_tranc_id, 1, 256) {}
+
+  using WAL::cleanWALFile;
+};
+
 class WALTest : public ::testing::Test {
 protected:
   void SetUp() override {
@@ -155,6 +164,40 @@ TEST_F(WALTest, RecoverTest) {
   }
 }
 
+TEST_F(WALTest, CleanWALFile) {
+  auto wal_files = [this] {
+    std::set<std::string> files;
+    for (const auto &entry : std::filesystem::directory_iterator(test_dir)) {
+      files.insert(entry.path().filename().string());
+    }
+    return files;
+  };
+
+  CleanableWAL wal(test_dir, 5);
+  // 每个事务的记录都超过文件大小上限, 各自写满一个文件
+  std::string value(300, 'v');
+  for (uint64_t tranc_id = 1; tranc_id <= 6; tranc_id++) {
+    std::vector<Record> records{Record::createRecord(tranc_id),
+                                Record::putRecord(tranc_id, "key", value)};
+    if (tranc_id <= 5) {
+      records.push_back(Record::commitRecord(tranc_id));
+    }
+    wal.log(records, true);
+  }
+  EXPECT_EQ(wal_files().size(), 7);
+
+  // 只保留含有未结束事务的文件和当前正在写入的文件
+  wal.cleanWALFile();
+  EXPECT_EQ(wal_files(), (std::set<std::string>{"wal.5", "wal.6"}));
+
+  // 目录中没有 wal 文件时不做任何事
+  for (const auto &file : wal_files()) {
+    std::filesystem::remove(test_dir + "/" + file);
+  }
+  EXPECT_NO_THROW(wal.cleanWALFile());
+  EXPECT_TRUE(wal_files().empty());
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   init_spdlog_file();